@@ -0,0 +1,257 @@
+#include "./async_writer_class.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+// File functions of the writer thread, POSIX or the io.h functions of Windows
+
+static int OpenOutputFile(const char *file_name)
+{
+#ifdef _WIN32
+    return _open(file_name, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+static int GetStdoutFile()
+{
+#ifdef _WIN32
+    // Without binary mode every 0x0A would become 0x0D 0x0A
+    _setmode(_fileno(stdout), _O_BINARY);
+    return _fileno(stdout);
+#else
+    return STDOUT_FILENO;
+#endif
+}
+
+static bool ResizeOutputFile(int fd, uint64_t size)
+{
+#ifdef _WIN32
+    return _chsize_s(fd, static_cast<__int64>(size)) == 0;
+#else
+    return ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+/// @brief  Write at the file position (offset = ASYNC_WRITER_APPEND) or at an offset without moving the file position
+/// @return  Number of written bytes, -1 on error
+static int64_t WriteFileData(int fd, const uint8_t *data, size_t size, uint64_t offset)
+{
+#ifdef _WIN32
+    unsigned int part = static_cast<unsigned int>(std::min<size_t>(size, INT_MAX));
+    if(offset == ASYNC_WRITER_APPEND)
+        return _write(fd, data, part);
+
+    // No pwrite, the positioned write seeks and restores the file position (only the writer thread uses it)
+    __int64 position = _telli64(fd);
+    if(position < 0 || _lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+        return -1;
+    int written = _write(fd, data, part);
+    if(_lseeki64(fd, position, SEEK_SET) < 0)
+        return -1;
+    return written;
+#else
+    size_t part = std::min<size_t>(size, SSIZE_MAX);
+    if(offset == ASYNC_WRITER_APPEND)
+        return write(fd, data, part);
+    return pwrite(fd, data, part, static_cast<off_t>(offset));
+#endif
+}
+
+static int CloseOutputFile(int fd)
+{
+#ifdef _WIN32
+    return _close(fd);
+#else
+    return close(fd);
+#endif
+}
+
+AsyncWriterClass::AsyncWriterClass()
+{
+    fd = -1;
+    close_fd = false;
+    closing = false;
+    error = false;
+}
+
+AsyncWriterClass::~AsyncWriterClass()
+{
+    Close();
+}
+
+/// @brief  Open (create or truncate) the file and start the writer thread
+/// @param file_name  Path to the file, "-" writes to stdout (sequential writes only)
+/// @return  True if the file is open
+bool AsyncWriterClass::Open(const char *file_name)
+{
+    Close();
+
+    if(strcmp(file_name, "-") == 0)
+    {
+        // Messages which are still in the buffer of stdout come first
+        fflush(stdout);
+        fd = GetStdoutFile();
+        close_fd = false;
+    }
+    else
+    {
+        fd = OpenOutputFile(file_name);
+        close_fd = true;
+    }
+
+    if(fd < 0)
+        return false;
+
+    free_buffers.clear();
+    for(int i = 0; i < ASYNC_WRITER_BUFFERS; i++)
+        free_buffers.push_back(i);
+    jobs.clear();
+    closing = false;
+    error = false;
+
+    writer = std::thread(&AsyncWriterClass::WriterThread, this);
+    return true;
+}
+
+/// @brief  Set the size of the file before the positioned writes (ftruncate, _chsize_s on Windows), the rest is filled with zeros
+/// @param size  Size in bytes
+bool AsyncWriterClass::SetFileSize(uint64_t size)
+{
+    return fd >= 0 && ResizeOutputFile(fd, size);
+}
+
+/// @brief  Get a free buffer of the ring, waits until the writer thread has written one
+/// @return  Buffer, the content and size are from the last use
+std::vector<uint8_t> &AsyncWriterClass::GetBuffer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    buffer_free.wait(lock, [this]() { return !free_buffers.empty(); });
+
+    int buffer = free_buffers.back();
+    free_buffers.pop_back();
+    return buffers[buffer];
+}
+
+/// @brief  Give a filled buffer to the writer thread
+/// @param buffer  Buffer from GetBuffer, it must not be used any more
+/// @param size  Number of bytes to write from the start of the buffer
+/// @param offset  Position in the file, ASYNC_WRITER_APPEND writes behind the last sequential write
+void AsyncWriterClass::Submit(std::vector<uint8_t> &buffer, size_t size, uint64_t offset)
+{
+    WRITE_JOB job;
+    job.buffer = static_cast<int>(&buffer - buffers);
+    job.size = std::min(size, buffer.size());
+    job.offset = offset;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+    job_ready.notify_one();
+}
+
+/// @brief  Copy data into the buffers and write it
+/// @param data  Data, it can be changed after the call
+/// @param size  Size in bytes
+/// @param offset  Position in the file, ASYNC_WRITER_APPEND writes behind the last sequential write
+void AsyncWriterClass::Write(const uint8_t *data, size_t size, uint64_t offset)
+{
+    while(size > 0)
+    {
+        size_t part = std::min<size_t>(size, ASYNC_WRITER_BUFFER_SIZE);
+        std::vector<uint8_t> &buffer = GetBuffer();
+        buffer.assign(data, data + part);
+        Submit(buffer, part, offset);
+
+        data += part;
+        size -= part;
+        if(offset != ASYNC_WRITER_APPEND)
+            offset += part;
+    }
+}
+
+/// @brief  Wait until all buffers are written and close the file
+/// @return  True if all buffers could be written
+bool AsyncWriterClass::Close()
+{
+    if(writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+            job_ready.notify_one();
+        }
+        writer.join();
+    }
+
+    if(fd >= 0 && close_fd && CloseOutputFile(fd) != 0)
+        error = true;
+    fd = -1;
+
+    return !error;
+}
+
+/// @brief  True if a write has failed, the producers can stop early
+bool AsyncWriterClass::HasError()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return error;
+}
+
+void AsyncWriterClass::WriterThread()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(true)
+    {
+        job_ready.wait(lock, [this]() { return !jobs.empty() || closing; });
+        if(jobs.empty())
+            break;
+
+        WRITE_JOB job = jobs.front();
+        jobs.pop_front();
+
+        // The file is written without the lock, the producers fill the other buffers
+        lock.unlock();
+        bool ok = WriteJob(job);
+        lock.lock();
+
+        if(!ok)
+            error = true;
+        free_buffers.push_back(job.buffer);
+        buffer_free.notify_one();
+    }
+}
+
+bool AsyncWriterClass::WriteJob(const WRITE_JOB &job)
+{
+    const uint8_t *data = buffers[job.buffer].data();
+    size_t size = job.size;
+    uint64_t offset = job.offset;
+
+    while(size > 0)
+    {
+        int64_t written = WriteFileData(fd, data, size, offset);
+
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        if(offset != ASYNC_WRITER_APPEND)
+            offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
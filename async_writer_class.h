@@ -0,0 +1,65 @@
+#ifndef ASYNC_WRITER_CLASS_H
+#define ASYNC_WRITER_CLASS_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <inttypes.h>
+#include <cstddef>
+
+// Number of buffers in the ring, the producers wait when all of them are in the queue
+#define ASYNC_WRITER_BUFFERS 8
+
+// Size of the buffers of Write (copied data)
+#define ASYNC_WRITER_BUFFER_SIZE (1024 * 1024)
+
+// Offset of a sequential write (behind the last sequential write)
+#define ASYNC_WRITER_APPEND UINT64_MAX
+
+/// @brief  Output file with a writer thread and a ring of buffers
+/// @note   A producer takes a free buffer with GetBuffer, fills it and gives it
+///         back with Submit, the writer thread writes the buffers in the order
+///         of Submit while the producer fills the next buffer. A buffer is
+///         written at its offset (pwrite, on Windows seek and write) or behind
+///         the last sequential write, so several threads can fill parts of one
+///         file. The buffers are recycled, their capacity stays for the next use.
+class AsyncWriterClass
+{
+public:
+    AsyncWriterClass();
+    ~AsyncWriterClass();
+    bool Open(const char *file_name);
+    bool SetFileSize(uint64_t size);
+    std::vector<uint8_t> &GetBuffer();
+    void Submit(std::vector<uint8_t> &buffer, size_t size, uint64_t offset = ASYNC_WRITER_APPEND);
+    void Write(const uint8_t *data, size_t size, uint64_t offset = ASYNC_WRITER_APPEND);
+    bool Close();
+    bool HasError();
+
+private:
+    struct WRITE_JOB
+    {
+        int buffer;             // Index of the buffer
+        size_t size;
+        uint64_t offset;        // ASYNC_WRITER_APPEND = sequential
+    };
+
+    void WriterThread();
+    bool WriteJob(const WRITE_JOB &job);
+
+    int fd;
+    bool close_fd;                                      // False for stdout
+    std::vector<uint8_t> buffers[ASYNC_WRITER_BUFFERS];
+    std::vector<int> free_buffers;
+    std::deque<WRITE_JOB> jobs;
+    std::mutex mutex;
+    std::condition_variable buffer_free;
+    std::condition_variable job_ready;
+    bool closing;
+    bool error;
+    std::thread writer;
+};
+
+#endif // ASYNC_WRITER_CLASS_H
@@ -0,0 +1,408 @@
+// C64 TAP Tool Benchmarks
+// Micro benchmarks of the kernels (pulse feed, kernal byte decoder, TAP and
+// WAV rendering) and end-to-end runs of the c64_tap_tool binary on a synthetic
+// tape corpus. The results are given in pulses/s and MB/s.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include "command_line_class.h"
+#include "tap_pulse_feed_class.h"
+#include "kernal_decoder.h"
+#include "tape_program_class.h"
+#include "wav_wave_table_class.h"
+#include "synthetic_tape_class.h"
+
+// Path of the tool for the end-to-end runs (set by CMake)
+#ifndef C64_TAP_TOOL_PATH
+#define C64_TAP_TOOL_PATH "c64_tap_tool"
+#endif
+
+// Min. duration of a micro benchmark, the kernel is repeated until it is reached
+#define BENCHMARK_MIN_SECONDS 0.5
+
+// Size of the pulse buffer of ReadPulses
+#define BENCHMARK_PULSE_BUFFER_SIZE 4096
+
+// Size of the sample buffer of the WAV rendering
+#define BENCHMARK_WAV_BUFFER_SAMPLES (1024 * 1024)
+
+using namespace std;
+
+// Defineren aller Kommandozeilen Parameter
+enum CMD_COMMAND {CMD_HELP, CMD_TAP_VERSION, CMD_PROGRAMS, CMD_PROGRAM_SIZE, CMD_NOISE, CMD_SEED, CMD_MICRO, CMD_MACRO, CMD_TOOL};
+static const CMD_STRUCT command_list[]{
+    {CMD_TAP_VERSION, "", "tap-version", "Version of the synthetic TAP file (0 or 1, default 1).", 1},
+    {CMD_PROGRAMS, "", "programs", "Number of PRG files on the synthetic tape (default 2).", 1},
+    {CMD_PROGRAM_SIZE, "", "program-size", "Size of a PRG file in bytes (default 4096).", 1},
+    {CMD_NOISE, "", "noise", "Max. deviation of a pulse in cycles (default 0 = clean tape).", 1},
+    {CMD_SEED, "", "seed", "Start value of the random generator (default 1).", 1},
+    {CMD_MICRO, "", "micro", "Run only the micro benchmarks.", 0},
+    {CMD_MACRO, "", "macro", "Run only the end-to-end benchmarks.", 0},
+    {CMD_TOOL, "", "tool", "Path of the c64_tap_tool binary for the end-to-end benchmarks.", 1},
+    {CMD_HELP, "?", "help", "This text.", 0}
+};
+
+#define command_list_count sizeof(command_list) / sizeof(command_list[0])
+
+/// @brief  Result of a benchmark
+struct BENCHMARK_RESULT
+{
+    bool valid;
+    double seconds;         // Time of all runs
+    uint64_t runs;
+    uint64_t pulses;        // Pulses of one run
+    uint64_t bytes;         // TAP or WAV data of one run
+};
+
+// Results of the kernels, so the calls are not removed by the compiler
+volatile uint64_t benchmark_sink;
+
+/// @brief  Run a kernel until BENCHMARK_MIN_SECONDS are reached
+/// @param function  Kernel, function(pulses, bytes) sets the processed pulses and bytes of one run
+template<typename FUNCTION>
+BENCHMARK_RESULT RunMicroBenchmark(FUNCTION function)
+{
+    BENCHMARK_RESULT result = {true, 0.0, 0, 0, 0};
+    auto start = chrono::steady_clock::now();
+
+    do
+    {
+        function(result.pulses, result.bytes);
+        result.runs++;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    while(result.seconds < BENCHMARK_MIN_SECONDS);
+
+    return result;
+}
+
+void PrintResultHeader(const char *title)
+{
+    printf("\n%s\n", title);
+    printf("%-32s %8s %12s %14s %10s\n", "Benchmark", "Runs", "ms/run", "Mpulses/s", "MB/s");
+}
+
+void PrintResult(const char *name, const BENCHMARK_RESULT &result)
+{
+    if(!result.valid || result.runs == 0 || result.seconds <= 0.0)
+    {
+        printf("%-32s %8s\n", name, "failed");
+        return;
+    }
+
+    double seconds_per_run = result.seconds / static_cast<double>(result.runs);
+    printf("%-32s %8" PRIu64 " %12.2f %14.3f %10.2f\n", name, result.runs, seconds_per_run * 1000.0,
+           static_cast<double>(result.pulses) / seconds_per_run / 1e6,
+           static_cast<double>(result.bytes) / seconds_per_run / 1e6);
+}
+
+/// @brief  Render a tape program into a sample buffer (the samples are overwritten)
+/// @return  Number of rendered samples
+uint64_t RenderWAVProgram(WAVWaveTableClass &wave_table, const TapeProgramClass &program, vector<uint8_t> &buffer)
+{
+    const uint32_t buffer_samples = static_cast<uint32_t>(buffer.size() / wave_table.GetSampleSize());
+    const uint32_t byte_samples = wave_table.GetMaxPulseSamples(PAL_TIMING::long_pulse_length) * TAP_PULSES_PER_BYTE;
+    uint64_t samples = 0;
+
+    wave_table.ResetPhase();
+
+    for(const TAPE_SEGMENT &segment : program.GetSegments())
+    {
+        const uint8_t *bytes = program.GetBytes() + segment.byte_offset;
+
+        if(segment.type == TAPE_SEGMENT_PULSES)
+        {
+            uint32_t step = max<uint32_t>(1, buffer_samples / wave_table.GetMaxPulseSamples(segment.pulse_length));
+            for(uint32_t first=0; first<segment.count; first+=step)
+                samples += wave_table.WritePulses(segment.pulse_length, min(step, segment.count - first), buffer.data());
+        }
+        else if(segment.type == TAPE_SEGMENT_KERNAL_BYTES)
+        {
+            uint32_t step = buffer_samples / byte_samples;
+            for(uint32_t first=0; first<segment.count; first+=step)
+                samples += wave_table.WriteKernalBytes(bytes + first, min(step, segment.count - first), buffer.data());
+        }
+    }
+
+    return samples;
+}
+
+void RunMicroBenchmarks(const SyntheticTapeClass &tape)
+{
+    const vector<uint8_t> &tap_image = tape.GetTAPImage();
+    const TapeProgramClass &program = tape.GetProgram();
+    const uint8_t version = tape.GetSettings().tap_version;
+
+    // The decoders read the pulses of the TAP file with the pulse feed
+    TAPPulseFeedClass feed;
+    feed.Open(tap_image.data(), static_cast<uint32_t>(tap_image.size()));
+    const uint64_t size = tap_image.size() - TAP_DATA_START;
+
+    tap_version = version;
+    decoder_messages = false;
+
+    PrintResultHeader("Micro benchmarks");
+
+    PrintResult("GetNextPulse", RunMicroBenchmark([&](uint64_t &pulses, uint64_t &bytes)
+    {
+        uint64_t pulse_types[4] = {};
+        pulses = 0;
+        feed.Rewind();
+        while(!feed.IsEnd())
+        {
+            pulse_types[GetNextPulse<PAL_TIMING>(feed)]++;
+            pulses++;
+        }
+        benchmark_sink = pulse_types[SHORT_PULSE] + pulse_types[MEDIUM_PULSE] + pulse_types[LONG_PULSE];
+        bytes = size;
+    }));
+
+    vector<uint32_t> pulse_buffer(BENCHMARK_PULSE_BUFFER_SIZE);
+    PrintResult("TAPPulseFeedClass::ReadPulses", RunMicroBenchmark([&](uint64_t &pulses, uint64_t &bytes)
+    {
+        uint64_t cycles = 0;
+        uint32_t count;
+        pulses = 0;
+        feed.Rewind();
+        while((count = feed.ReadPulses(pulse_buffer.data(), BENCHMARK_PULSE_BUFFER_SIZE)) > 0)
+        {
+            for(uint32_t i=0; i<count; i++)
+                cycles += pulse_buffer[i];
+            pulses += count;
+        }
+        benchmark_sink = cycles;
+        bytes = size;
+    }));
+
+    PrintResult("GetNextKernalByte", RunMicroBenchmark([&](uint64_t &pulses, uint64_t &bytes)
+    {
+        uint64_t checksum = 0;
+        bool error, start_new_block;
+        feed.Rewind();
+        while(!feed.IsEnd())
+            checksum += GetNextKernalByte<PAL_TIMING>(feed, error, start_new_block);
+        benchmark_sink = checksum;
+        pulses = tape.GetPulseCount();
+        bytes = size;
+    }));
+
+    // RenderTAP copies the 20 pulses of a kernal byte from the table of the timing profile (former WriteTAPByte)
+    vector<uint8_t> tap_data;
+    PrintResult("TapeProgramClass::RenderTAP", RunMicroBenchmark([&](uint64_t &pulses, uint64_t &bytes)
+    {
+        tap_data.clear();
+        program.RenderTAP(tap_data, version);
+        pulses = program.GetPulseCount();
+        bytes = tap_data.size();
+    }));
+
+    // WriteKernalBytes and WritePulses copy the waveforms from the wave table (former WriteWAVByte)
+    WAVWaveTableClass wave_table;
+    wave_table.Create(WAV_DEFAULT_SAMPLE_RATE, PAL_TIMING::cycles_per_second, PAL_TIMING::short_pulse_length, PAL_TIMING::medium_pulse_length, PAL_TIMING::long_pulse_length);
+    vector<uint8_t> wav_buffer(BENCHMARK_WAV_BUFFER_SAMPLES * wave_table.GetSampleSize());
+    PrintResult("WAVWaveTableClass (float)", RunMicroBenchmark([&](uint64_t &pulses, uint64_t &bytes)
+    {
+        pulses = program.GetPulseCount();
+        bytes = RenderWAVProgram(wave_table, program, wav_buffer) * wave_table.GetSampleSize();
+    }));
+}
+
+/// @brief  Get the size of a file in bytes (0 if it does not exist)
+uint64_t GetFileSize(const char *file_name)
+{
+    struct stat file_stat;
+    if(stat(file_name, &file_stat) != 0)
+        return 0;
+    return static_cast<uint64_t>(file_stat.st_size);
+}
+
+bool WriteBenchmarkFile(const char *file_name, const vector<uint8_t> &data)
+{
+    ofstream file(file_name, ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<streamsize>(data.size()));
+    return file.good();
+}
+
+/// @brief  Run the tool until BENCHMARK_MIN_SECONDS are reached, the output goes to /dev/null
+/// @param tool  Path of the c64_tap_tool binary
+/// @param arguments  Command line of the tool
+/// @param pulses  Pulses of the tape
+/// @param bytes_file  File for the MB/s (read or written TAP or WAV file), the size is taken after the runs
+/// @note   A failed run stops the benchmark, the result is not valid.
+BENCHMARK_RESULT RunToolBenchmark(const char *tool, const string &arguments, uint64_t pulses, const char *bytes_file)
+{
+    BENCHMARK_RESULT result = {true, 0.0, 0, pulses, 0};
+    string command = string("\"") + tool + "\" " + arguments + " > /dev/null 2>&1";
+    auto start = chrono::steady_clock::now();
+
+    do
+    {
+        if(system(command.c_str()) != 0)
+        {
+            result.valid = false;
+            break;
+        }
+        result.runs++;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    while(result.seconds < BENCHMARK_MIN_SECONDS);
+
+    result.bytes = GetFileSize(bytes_file);
+    return result;
+}
+
+/// @brief  Remove all files of the work directory and the directory
+void RemoveWorkDirectory(const string &work_dir)
+{
+    DIR *dir = opendir(work_dir.c_str());
+    if(dir != nullptr)
+    {
+        struct dirent *entry;
+        while((entry = readdir(dir)) != nullptr)
+        {
+            if(strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                unlink((work_dir + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(work_dir.c_str());
+}
+
+/// @brief  End-to-end runs of the tool on the synthetic tape in a temporary directory
+bool RunMacroBenchmarks(const SyntheticTapeClass &tape, const char *tool)
+{
+    char work_dir_template[] = "/tmp/c64_tap_benchmark_XXXXXX";
+    if(mkdtemp(work_dir_template) == nullptr)
+    {
+        printf("Error creating the work directory\n");
+        return false;
+    }
+    string work_dir = work_dir_template;
+
+    char old_dir[4096];
+    if(getcwd(old_dir, sizeof(old_dir)) == nullptr || chdir(work_dir.c_str()) != 0)
+    {
+        printf("Error changing to the work directory: %s\n", work_dir.c_str());
+        RemoveWorkDirectory(work_dir);
+        return false;
+    }
+
+    bool ret = WriteBenchmarkFile("bench.tap", tape.GetTAPImage()) && WriteBenchmarkFile("bench.prg", tape.GetPRG(0));
+    if(!ret)
+        printf("Error writing the synthetic tape into: %s\n", work_dir.c_str());
+    else
+    {
+        const uint64_t tape_pulses = tape.GetPulseCount();
+        const uint64_t prg_pulses = tape.GetPRGPulseCount(0);
+
+        PrintResultHeader("End-to-end benchmarks (c64_tap_tool)");
+        PrintResult("--analyze", RunToolBenchmark(tool, "--analyze bench.tap", tape_pulses, "bench.tap"));
+        PrintResult("--export", RunToolBenchmark(tool, "--export bench.tap", tape_pulses, "bench.tap"));
+        PrintResult("--conv2tap", RunToolBenchmark(tool, "--conv2tap bench.prg conv.tap", prg_pulses, "conv.tap"));
+        PrintResult("--conv2wav", RunToolBenchmark(tool, "--conv2wav bench.prg conv.wav", prg_pulses, "conv.wav"));
+        PrintResult("--tap2wav", RunToolBenchmark(tool, "--tap2wav bench.tap bench.wav", tape_pulses, "bench.wav"));
+        PrintResult("--wav2tap", RunToolBenchmark(tool, "--wav2tap bench.wav wav.tap", tape_pulses, "bench.wav"));
+    }
+
+    if(chdir(old_dir) != 0)
+        printf("Error changing to the directory: %s\n", old_dir);
+    RemoveWorkDirectory(work_dir);
+    return ret;
+}
+
+/// @brief  Read a numeric option
+/// @return  False if the value is not a number in the range
+bool GetOptionValue(CommandLineClass &cmd, int number, int min_value, int max_value, uint32_t &value)
+{
+    bool err;
+    int arg_value = cmd.GetArgInt(number, &err);
+    if(err || arg_value < min_value || arg_value > max_value)
+    {
+        printf("Invalid value for --%s (%d - %d): %s\n", cmd.GetCommandLongString(cmd.GetCommand(number - 1)), min_value, max_value, cmd.GetArg(number));
+        return false;
+    }
+    value = static_cast<uint32_t>(arg_value);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    CommandLineClass cmd(argc, argv, "c64_tap_benchmark", command_list, command_list_count);
+
+    if(cmd.GetCommandCount() < 0)
+    {
+        printf("\"c64_tap_benchmark --help\" provides more information.\n");
+        return(-1);
+    }
+
+    if(cmd.FoundCommand(CMD_HELP))
+    {
+        cmd.ShowHelp();
+        return(0x0);
+    }
+
+    uint32_t version = 1;
+    SYNTHETIC_TAPE_SETTINGS settings = {1, 2, 4096, 0, 1};
+    const char *tool = C64_TAP_TOOL_PATH;
+
+    for(int i=0; i<cmd.GetCommandCount(); i++)
+    {
+        bool ok = true;
+        switch(cmd.GetCommand(i))
+        {
+        case CMD_TAP_VERSION:
+            ok = GetOptionValue(cmd, i+1, 0, 1, version);
+            break;
+        case CMD_PROGRAMS:
+            ok = GetOptionValue(cmd, i+1, 1, 256, settings.program_count);
+            break;
+        case CMD_PROGRAM_SIZE:
+            ok = GetOptionValue(cmd, i+1, 1, 0xFFFF - SYNTHETIC_PRG_START_ADDRESS, settings.program_size);
+            break;
+        case CMD_NOISE:
+            ok = GetOptionValue(cmd, i+1, 0, 255, settings.noise);
+            break;
+        case CMD_SEED:
+            ok = GetOptionValue(cmd, i+1, 0, 0x7FFFFFFF, settings.seed);
+            break;
+        case CMD_TOOL:
+            tool = cmd.GetArg(i+1);
+            break;
+        }
+        if(!ok)
+            return(-1);
+    }
+    settings.tap_version = static_cast<uint8_t>(version);
+
+    SyntheticTapeClass tape;
+    tape.Create(settings);
+
+    printf("Synthetic tape: TAP version %d, %u programs of %u bytes, noise +-%u cycles, seed %u\n",
+           settings.tap_version, settings.program_count, settings.program_size, settings.noise, settings.seed);
+    printf("TAP file: %zu bytes, %" PRIu64 " pulses\n", tape.GetTAPImage().size(), tape.GetPulseCount());
+
+#ifndef __OPTIMIZE__
+    printf("Warning: the benchmark is built without optimization (CMAKE_BUILD_TYPE=Release)\n");
+#endif
+
+    bool run_micro = !cmd.FoundCommand(CMD_MACRO) || cmd.FoundCommand(CMD_MICRO);
+    bool run_macro = !cmd.FoundCommand(CMD_MICRO) || cmd.FoundCommand(CMD_MACRO);
+
+    if(run_micro)
+        RunMicroBenchmarks(tape);
+
+    if(run_macro && !RunMacroBenchmarks(tape, tool))
+        return(-1);
+
+    return 0;
+}
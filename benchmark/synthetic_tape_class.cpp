@@ -0,0 +1,194 @@
+#include "./synthetic_tape_class.h"
+#include <stdio.h>
+
+SyntheticTapeClass::SyntheticTapeClass()
+{
+    settings.tap_version = 1;
+    settings.program_count = 0;
+    settings.program_size = 0;
+    settings.noise = 0;
+    settings.seed = 0;
+}
+
+/// @brief  Create the PRG files and the TAP file
+/// @param new_settings  Version, size, number of files and noise of the tape
+void SyntheticTapeClass::Create(const SYNTHETIC_TAPE_SETTINGS &new_settings)
+{
+    settings = new_settings;
+    random.seed(settings.seed);
+
+    prg_list.clear();
+    prg_pulse_count.clear();
+    program.Clear();
+    program.SetTimingProfile(TIMING_PAL);
+
+    for(uint32_t i=0; i<settings.program_count; i++)
+    {
+        if(i > 0)
+            AddGap();
+
+        CreatePRG();
+
+        TapeProgramClass file_program;
+        AddKernalFile(i, file_program);
+        prg_pulse_count.push_back(file_program.GetPulseCount());
+        program.Append(file_program);
+    }
+
+    uint32_t tap_data_size = program.GetTAPDataSize(settings.tap_version);
+
+    tap_image.clear();
+    tap_image.reserve(TAP_DATA_START + tap_data_size);
+
+    const char tap_signature[] = "C64-TAPE-RAW";
+    tap_image.insert(tap_image.end(), tap_signature, tap_signature + 12);
+    tap_image.push_back(settings.tap_version);
+    tap_image.push_back(0x00);                  // Platform (C64)
+    tap_image.push_back(TAP_VIDEO_PAL);
+    tap_image.push_back(0x00);
+    for(int i=0; i<4; i++)
+        tap_image.push_back(static_cast<uint8_t>(tap_data_size >> (i * 8)));
+
+    std::vector<uint8_t> tap_data;
+    program.RenderTAP(tap_data, settings.tap_version);
+    AddNoise(tap_data);
+    tap_image.insert(tap_image.end(), tap_data.begin(), tap_data.end());
+}
+
+const SYNTHETIC_TAPE_SETTINGS &SyntheticTapeClass::GetSettings() const
+{
+    return settings;
+}
+
+/// @brief  Get the complete TAP file (header and data)
+const std::vector<uint8_t> &SyntheticTapeClass::GetTAPImage() const
+{
+    return tap_image;
+}
+
+/// @brief  Get the clean tape program of the TAP file (without noise)
+const TapeProgramClass &SyntheticTapeClass::GetProgram() const
+{
+    return program;
+}
+
+uint32_t SyntheticTapeClass::GetPRGCount() const
+{
+    return static_cast<uint32_t>(prg_list.size());
+}
+
+/// @brief  Get the content of a PRG file (with start address)
+const std::vector<uint8_t> &SyntheticTapeClass::GetPRG(uint32_t number) const
+{
+    return prg_list[number];
+}
+
+/// @brief  Get the number of pulses of a PRG file in kernal format
+uint64_t SyntheticTapeClass::GetPRGPulseCount(uint32_t number) const
+{
+    return prg_pulse_count[number];
+}
+
+/// @brief  Get the number of pulses of the whole tape (a pause is one pulse in version 1)
+uint64_t SyntheticTapeClass::GetPulseCount() const
+{
+    return program.GetPulseCount();
+}
+
+/// @brief  Create a PRG file with random content
+void SyntheticTapeClass::CreatePRG()
+{
+    std::vector<uint8_t> prg;
+    prg.reserve(settings.program_size + 2);
+    prg.push_back(SYNTHETIC_PRG_START_ADDRESS & 0xFF);
+    prg.push_back(SYNTHETIC_PRG_START_ADDRESS >> 8);
+
+    for(uint32_t i=0; i<settings.program_size; i++)
+        prg.push_back(static_cast<uint8_t>(random() >> 24));
+
+    prg_list.push_back(prg);
+}
+
+/// @brief  Encode a PRG file in kernal format (header, data and backup copies)
+void SyntheticTapeClass::AddKernalFile(uint32_t number, TapeProgramClass &file_program)
+{
+    const std::vector<uint8_t> &prg = prg_list[number];
+    const uint8_t *prg_bytes = prg.data() + 2;
+    uint32_t prg_size = static_cast<uint32_t>(prg.size() - 2);
+    uint32_t end_address = (SYNTHETIC_PRG_START_ADDRESS + prg_size) & 0xFFFF;
+
+    // Kernal header block: type, start and end address, displayed and not displayed filename
+    uint8_t header[192];
+    for(size_t i=0; i<sizeof(header); i++)
+        header[i] = 0x20;
+    header[0] = 0x01;
+    header[1] = SYNTHETIC_PRG_START_ADDRESS & 0xFF;
+    header[2] = SYNTHETIC_PRG_START_ADDRESS >> 8;
+    header[3] = static_cast<uint8_t>(end_address);
+    header[4] = static_cast<uint8_t>(end_address >> 8);
+
+    char filename[17];
+    int filename_length = snprintf(filename, sizeof(filename), "BENCH%u", number + 1);
+    for(int i=0; i<filename_length && i<16; i++)
+        header[5 + i] = static_cast<uint8_t>(filename[i]);
+
+    const uint8_t *blocks[2] = {header, prg_bytes};
+    const uint32_t block_sizes[2] = {sizeof(header), prg_size};
+    const uint32_t leaders[2] = {SYNTHETIC_HEADER_LEADER_PULSES, SYNTHETIC_DATA_LEADER_PULSES};
+
+    for(int block=0; block<2; block++)
+    {
+        uint8_t crc = 0;
+        for(uint32_t i=0; i<block_sizes[block]; i++)
+            crc ^= blocks[block][i];
+
+        // Block with countdown 0x89 - 0x81 and EndOfData Marker, backup with countdown 0x09 - 0x01
+        file_program.AddPulses(PAL_TIMING::short_pulse_length, leaders[block]);
+        for(uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+            file_program.AddKernalByte(countdown);
+        file_program.AddKernalBytes(blocks[block], block_sizes[block]);
+        file_program.AddKernalByte(crc);
+        file_program.AddPulses(PAL_TIMING::long_pulse_length, 1);
+        file_program.AddPulses(PAL_TIMING::short_pulse_length, 1);
+
+        file_program.AddPulses(PAL_TIMING::short_pulse_length, SYNTHETIC_REPEAT_LEADER_PULSES);
+        for(uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+            file_program.AddKernalByte(countdown);
+        file_program.AddKernalBytes(blocks[block], block_sizes[block]);
+        file_program.AddKernalByte(crc);
+    }
+}
+
+/// @brief  Add the pause between two files
+/// @note   Version 1 stores the pause as one pulse (0x00 + 24 bit), version 0 as 0x00 bytes of 2048 cycles
+void SyntheticTapeClass::AddGap()
+{
+    uint32_t gap_cycles = PAL_TIMING::cycles_per_second * SYNTHETIC_GAP_SECONDS;
+
+    if(settings.tap_version == 1)
+        program.AddPulses(gap_cycles, 1);
+    else
+        program.AddPulses(256 * 8, gap_cycles / (256 * 8));
+}
+
+/// @brief  Move every pulse of the TAP data by up to +-noise cycles, pauses (0x00) are not changed
+void SyntheticTapeClass::AddNoise(std::vector<uint8_t> &tap_data)
+{
+    if(settings.noise == 0)
+        return;
+
+    for(size_t pos=0; pos<tap_data.size(); pos++)
+    {
+        if(tap_data[pos] == 0x00)
+        {
+            if(settings.tap_version == 1)
+                pos += 3;
+            continue;
+        }
+
+        int64_t deviation = static_cast<int64_t>(random() % (2 * settings.noise + 1)) - settings.noise;
+        int64_t cycles = tap_data[pos] * 8 + deviation;
+        int64_t tap_byte = (cycles + 4) / 8;
+        tap_data[pos] = static_cast<uint8_t>(tap_byte < 1 ? 1 : tap_byte > 255 ? 255 : tap_byte);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef SYNTHETIC_TAPE_CLASS_H
+#define SYNTHETIC_TAPE_CLASS_H
+
+#include <vector>
+#include <random>
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+#include "timing_profile.h"
+#include "tape_program_class.h"
+
+// Kernal tape layout (number of short pulses before the blocks), the same as the encoder of the tool
+#define SYNTHETIC_HEADER_LEADER_PULSES 27135
+#define SYNTHETIC_DATA_LEADER_PULSES 5671
+#define SYNTHETIC_REPEAT_LEADER_PULSES 79
+
+// Pause between two programs
+#define SYNTHETIC_GAP_SECONDS 2
+
+// Start address of the generated PRG files
+#define SYNTHETIC_PRG_START_ADDRESS 0x0801
+
+struct SYNTHETIC_TAPE_SETTINGS
+{
+    uint8_t tap_version;        // 0 or 1
+    uint32_t program_count;     // Number of kernal files on the tape
+    uint32_t program_size;      // Size of a PRG file without start address
+    uint32_t noise;             // Max. deviation of a pulse in cycles (0 = clean tape)
+    uint32_t seed;              // Start value of the random generator
+};
+
+/// @brief  Generator of synthetic TAP files for the benchmarks
+/// @note   The tape contains program_count PRG files with random content in
+///         kernal format (leader, countdown, header and data block with their
+///         backup copies) and a pause between the files. The pulses of the
+///         file data are moved by up to +-noise cycles. The random generator is
+///         a std::mt19937 and only its raw output is used, so the same settings
+///         create the same tape on every platform.
+class SyntheticTapeClass
+{
+public:
+    SyntheticTapeClass();
+    void Create(const SYNTHETIC_TAPE_SETTINGS &new_settings);
+    const SYNTHETIC_TAPE_SETTINGS &GetSettings() const;
+    const std::vector<uint8_t> &GetTAPImage() const;
+    const TapeProgramClass &GetProgram() const;
+    uint32_t GetPRGCount() const;
+    const std::vector<uint8_t> &GetPRG(uint32_t number) const;
+    uint64_t GetPRGPulseCount(uint32_t number) const;
+    uint64_t GetPulseCount() const;
+
+private:
+    void CreatePRG();
+    void AddKernalFile(uint32_t number, TapeProgramClass &file_program);
+    void AddGap();
+    void AddNoise(std::vector<uint8_t> &tap_data);
+
+    SYNTHETIC_TAPE_SETTINGS settings;
+    std::mt19937 random;
+    std::vector<std::vector<uint8_t>> prg_list;
+    std::vector<uint64_t> prg_pulse_count;   // Pulses of every file without the pause
+    TapeProgramClass program;               // Clean pulses of the whole tape
+    std::vector<uint8_t> tap_image;         // TAP file with header and noise
+};
+
+#endif // SYNTHETIC_TAPE_CLASS_H
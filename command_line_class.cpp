@@ -69,7 +69,13 @@ CommandLineClass::CommandLineClass(int argc, char *argv[], const char *applicati
                 }
             }
 
-            if(arg_count != GetCommandArgCount(this->command_list[i]))
+            bool wrong_arg_count;
+            if(GetCommandArgCount(this->command_list[i]) == CMD_VARIABLE_ARG_COUNT)
+                wrong_arg_count = (arg_count == 0);
+            else
+                wrong_arg_count = (arg_count != GetCommandArgCount(this->command_list[i]));
+
+            if(wrong_arg_count)
             {
                // printf("%s: Ungültige Option -- %s\n",app_name,command);
 
@@ -130,6 +136,19 @@ bool CommandLineClass::CheckArg(int number)
     else return false;
 }
 
+int CommandLineClass::GetArgCount(int number)
+{
+    // Anzahl der Argumente hinter dem Kommando an Position number
+    int arg_count = 0;
+    for(int i=number+1; i<command_count; i++)
+    {
+        if(!CheckArg(i))
+            break;
+        arg_count++;
+    }
+    return arg_count;
+}
+
 char *CommandLineClass::GetArg(int number)
 {
     if(number < command_count)
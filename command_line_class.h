@@ -7,6 +7,7 @@
 
 #define MAX_COMMAND_NUM 512
 #define CMD_ARG 0xFFFF
+#define CMD_VARIABLE_ARG_COUNT 0xFFFF   // arg_count: beliebig viele Argumente (mindestens eins)
 
 struct CMD_STRUCT
 {
@@ -27,6 +28,7 @@ public:
     const char *GetCommandLongString(int command);
     int GetCommandArgCount(int command);
     bool CheckArg(int number);
+    int GetArgCount(int number);
     char* GetArg(int number);
     int GetArgInt(int number, bool *err);
     bool FoundCommand(int command);
@@ -0,0 +1,281 @@
+#include "./csw_file.h"
+#include "./tap_pulse.h"
+#include <string.h>
+#include <cstdio>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static const char csw_signature[] = "Compressed Square Wave\x1A";
+#define CSW_SIGNATURE_LENGTH 23
+#define CSW1_HEADER_SIZE 0x20
+#define CSW2_HEADER_SIZE 0x34
+
+static uint32_t ReadLE32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24);
+}
+
+static void WriteLE32(std::vector<uint8_t> &data, uint32_t value)
+{
+    for(int i=0; i<4; i++)
+        data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+/// @brief  Add the length of a half wave to RLE data
+static void AddRLEHalfWave(std::vector<uint8_t> &rle_data, uint32_t samples)
+{
+    if(samples > 0 && samples < 256)
+    {
+        rle_data.push_back(static_cast<uint8_t>(samples));
+    }
+    else
+    {
+        rle_data.push_back(0x00);
+        WriteLE32(rle_data, samples);
+    }
+}
+
+/// @brief  Check if the given data is a CSW file
+/// @param data  Pointer to the file data
+/// @param size  Size of the file data
+/// @return  True if the data starts with the CSW signature
+bool IsCSWFile(const uint8_t *data, size_t size)
+{
+    return size >= CSW1_HEADER_SIZE && memcmp(data, csw_signature, CSW_SIGNATURE_LENGTH) == 0;
+}
+
+/// @brief  Convert a CSW file (version 1 or 2) to a TAP version 1 image
+/// @param csw_data  Pointer to the CSW file data
+/// @param csw_size  Size of the CSW file data
+/// @param tap_image  Complete TAP file (header and pulses)
+/// @param cycles_per_second  Clock of the machine (timing profile)
+/// @return  True if the CSW file could be converted
+/// @note   The half waves are read directly from the RLE data and two of them
+///         (from falling edge to falling edge) are stored as one TAP pulse.
+bool ConvertCSWToTAP(const uint8_t *csw_data, size_t csw_size, std::vector<uint8_t> &tap_image, uint32_t cycles_per_second)
+{
+    if(!IsCSWFile(csw_data, csw_size))
+        return false;
+
+    uint8_t major_version = csw_data[0x17];
+    uint32_t sample_rate;
+    uint8_t compression;
+    uint8_t flags;
+    size_t data_start;
+
+    if(major_version == 1)
+    {
+        sample_rate = static_cast<uint32_t>(csw_data[0x19] | csw_data[0x1A] << 8);
+        compression = csw_data[0x1B];
+        flags = csw_data[0x1C];
+        data_start = CSW1_HEADER_SIZE;
+    }
+    else if(major_version == 2 && csw_size >= CSW2_HEADER_SIZE)
+    {
+        sample_rate = ReadLE32(&csw_data[0x19]);
+        compression = csw_data[0x21];
+        flags = csw_data[0x22];
+        data_start = CSW2_HEADER_SIZE + csw_data[0x23];
+    }
+    else
+    {
+        printf("CSW version %d is not supported.\n", major_version);
+        return false;
+    }
+
+    if(sample_rate == 0 || data_start > csw_size)
+        return false;
+
+    // RLE data (decompressed if needed)
+    const uint8_t *rle_data = csw_data + data_start;
+    size_t rle_size = csw_size - data_start;
+    std::vector<uint8_t> decompressed_data;
+
+    if(compression == CSW_COMPRESSION_Z_RLE)
+    {
+#ifdef HAVE_ZLIB
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if(inflateInit(&stream) != Z_OK)
+            return false;
+
+        stream.next_in = const_cast<Bytef*>(rle_data);
+        stream.avail_in = static_cast<uInt>(rle_size);
+
+        int ret = Z_OK;
+        while(ret == Z_OK)
+        {
+            size_t old_size = decompressed_data.size();
+            decompressed_data.resize(old_size + (1 << 20));
+            stream.next_out = decompressed_data.data() + old_size;
+            stream.avail_out = 1 << 20;
+            ret = inflate(&stream, Z_NO_FLUSH);
+            decompressed_data.resize(old_size + (1 << 20) - stream.avail_out);
+        }
+        inflateEnd(&stream);
+
+        if(ret != Z_STREAM_END)
+        {
+            printf("Error decompressing the CSW data.\n");
+            return false;
+        }
+
+        rle_data = decompressed_data.data();
+        rle_size = decompressed_data.size();
+#else
+        printf("Compressed CSW files (Z-RLE) are not supported in this build.\n");
+        return false;
+#endif
+    }
+    else if(compression != CSW_COMPRESSION_RLE)
+    {
+        printf("CSW compression type %d is not supported.\n", compression);
+        return false;
+    }
+
+    // TAP header (version 1), the data size is set at the end
+    tap_image.clear();
+    tap_image.reserve(TAP_DATA_START + rle_size / 2);
+    tap_image.insert(tap_image.end(), "C64-TAPE-RAW", "C64-TAPE-RAW" + 12);
+    tap_image.push_back(1);
+    tap_image.insert(tap_image.end(), 7, 0x00);
+
+    // With a high initial polarity the first half wave ends at a falling edge
+    bool skip_half_wave = (flags & 0x01) != 0;
+    bool second_half_wave = false;
+
+    // Samples are converted to cycles with the accumulated position, so there is no drift
+    uint64_t sample_pos = 0;
+    uint64_t cycle_pos = 0;
+
+    size_t pos = 0;
+    while(pos < rle_size)
+    {
+        uint32_t samples = rle_data[pos++];
+        if(samples == 0)
+        {
+            if(pos + 4 > rle_size)
+                break;
+            samples = ReadLE32(&rle_data[pos]);
+            pos += 4;
+        }
+
+        sample_pos += samples;
+
+        if(skip_half_wave)
+        {
+            skip_half_wave = false;
+            cycle_pos = sample_pos * cycles_per_second / sample_rate;
+            continue;
+        }
+
+        if(second_half_wave)
+        {
+            uint64_t new_cycle_pos = sample_pos * cycles_per_second / sample_rate;
+            AddTAPPulse(tap_image, new_cycle_pos - cycle_pos);
+            cycle_pos = new_cycle_pos;
+        }
+        second_half_wave = !second_half_wave;
+    }
+
+    uint32_t tap_data_size = static_cast<uint32_t>(tap_image.size() - TAP_DATA_START);
+    for(int i=0; i<4; i++)
+        tap_image[16 + i] = static_cast<uint8_t>(tap_data_size >> (i * 8));
+
+    return true;
+}
+
+/// @brief  Convert a TAP image (version 0 or 1) to a CSW file
+/// @param tap_image  Pointer to the TAP file data
+/// @param tap_size  Size of the TAP file data
+/// @param csw_version  CSW version (1 = RLE, 2 = Z-RLE if zlib is available, otherwise RLE)
+/// @param sample_rate  Sample rate of the CSW file
+/// @param csw_data  Complete CSW file
+/// @param cycles_per_second  Clock of the machine (timing profile)
+/// @return  True if the TAP image could be converted
+/// @note   Every pulse is written as a low and a high half wave, the sample
+///         positions are calculated from the accumulated cycles (no drift).
+bool ConvertTAPToCSW(const uint8_t *tap_image, size_t tap_size, int csw_version, uint32_t sample_rate, std::vector<uint8_t> &csw_data, uint32_t cycles_per_second)
+{
+    if(tap_size < TAP_DATA_START || memcmp(tap_image, "C64-TAPE-RAW", 12) != 0 || sample_rate == 0)
+        return false;
+
+    uint8_t tap_version = tap_image[12];
+    std::vector<uint8_t> rle_data;
+    rle_data.reserve(tap_size * 2);
+
+    uint64_t cycle_pos = 0;
+    uint64_t sample_pos = 0;
+    uint32_t half_wave_count = 0;
+
+    uint32_t pos = TAP_DATA_START;
+    while(pos < tap_size)
+    {
+        if(tap_image[pos] == 0 && tap_version == 1 && pos + 3 >= tap_size)
+            break;
+
+        uint32_t pulse_length = GetTAPPulseLength(tap_image, pos, tap_version);
+        pos++;
+
+        // Low half wave up to the middle of the pulse, high half wave up to the end
+        uint64_t middle_sample = ((cycle_pos + pulse_length / 2) * sample_rate + cycles_per_second / 2) / cycles_per_second;
+        cycle_pos += pulse_length;
+        uint64_t end_sample = (cycle_pos * sample_rate + cycles_per_second / 2) / cycles_per_second;
+
+        // A half wave needs at least one sample
+        if(middle_sample <= sample_pos)
+            middle_sample = sample_pos + 1;
+        if(end_sample <= middle_sample)
+            end_sample = middle_sample + 1;
+
+        AddRLEHalfWave(rle_data, static_cast<uint32_t>(middle_sample - sample_pos));
+        AddRLEHalfWave(rle_data, static_cast<uint32_t>(end_sample - middle_sample));
+        sample_pos = end_sample;
+        half_wave_count += 2;
+    }
+
+    csw_data.assign(csw_signature, csw_signature + CSW_SIGNATURE_LENGTH);
+
+    if(csw_version == 1)
+    {
+        if(sample_rate > 0xFFFF)
+            return false;
+
+        csw_data.push_back(1);                                      // Major version
+        csw_data.push_back(1);                                      // Minor version
+        csw_data.push_back(static_cast<uint8_t>(sample_rate));      // Sample rate
+        csw_data.push_back(static_cast<uint8_t>(sample_rate >> 8));
+        csw_data.push_back(CSW_COMPRESSION_RLE);                    // Compression type
+        csw_data.push_back(0x00);                                   // Flags (initial polarity low)
+        csw_data.insert(csw_data.end(), 3, 0x00);                   // Reserved
+        csw_data.insert(csw_data.end(), rle_data.begin(), rle_data.end());
+        return true;
+    }
+
+    uint8_t compression = CSW_COMPRESSION_RLE;
+#ifdef HAVE_ZLIB
+    std::vector<uint8_t> compressed_data(compressBound(static_cast<uLong>(rle_data.size())));
+    uLongf compressed_size = static_cast<uLongf>(compressed_data.size());
+    if(compress2(compressed_data.data(), &compressed_size, rle_data.data(), static_cast<uLong>(rle_data.size()), Z_BEST_COMPRESSION) == Z_OK)
+    {
+        compressed_data.resize(compressed_size);
+        rle_data.swap(compressed_data);
+        compression = CSW_COMPRESSION_Z_RLE;
+    }
+#endif
+
+    csw_data.push_back(2);                                          // Major version
+    csw_data.push_back(0);                                          // Minor version
+    WriteLE32(csw_data, sample_rate);                               // Sample rate
+    WriteLE32(csw_data, half_wave_count);                           // Total number of pulses
+    csw_data.push_back(compression);                                // Compression type
+    csw_data.push_back(0x00);                                       // Flags (initial polarity low)
+    csw_data.push_back(0x00);                                       // Header extension length
+    char application[16] = "c64_tap_tool";                          // Encoding application
+    csw_data.insert(csw_data.end(), application, application + sizeof(application));
+    csw_data.insert(csw_data.end(), rle_data.begin(), rle_data.end());
+
+    return true;
+}
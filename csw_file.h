@@ -0,0 +1,22 @@
+#ifndef CSW_FILE_H
+#define CSW_FILE_H
+
+#include <vector>
+#include <inttypes.h>
+#include <cstddef>
+
+#include "tap_pulse.h"
+
+// CSW (Compressed Square Wave)
+// A CSW file stores the length of every half wave (in samples), run length
+// encoded (RLE) and in version 2 optionally compressed with zlib (Z-RLE).
+// One TAP pulse (from falling edge to falling edge) is two half waves.
+#define CSW_DEFAULT_SAMPLE_RATE 44100
+#define CSW_COMPRESSION_RLE 1
+#define CSW_COMPRESSION_Z_RLE 2
+
+bool IsCSWFile(const uint8_t *data, size_t size);
+bool ConvertCSWToTAP(const uint8_t *csw_data, size_t csw_size, std::vector<uint8_t> &tap_image, uint32_t cycles_per_second = TAP_CYCLES_PER_SECOND);
+bool ConvertTAPToCSW(const uint8_t *tap_image, size_t tap_size, int csw_version, uint32_t sample_rate, std::vector<uint8_t> &csw_data, uint32_t cycles_per_second = TAP_CYCLES_PER_SECOND);
+
+#endif // CSW_FILE_H
@@ -0,0 +1,437 @@
+#include "./d64_image_class.h"
+#include <string.h>
+#include <algorithm>
+
+D64ImageClass::D64ImageClass()
+{
+    track_count = 0;
+}
+
+/// @brief  Load a D64 image and read its directory
+/// @param image_data  Pointer to the D64 file data
+/// @param image_size  Size of the D64 file data (35 or 40 tracks, with or without error bytes)
+/// @return  True if the image has a valid size and the directory could be read
+bool D64ImageClass::Load(const uint8_t *image_data, size_t image_size)
+{
+    image.clear();
+    files.clear();
+    disk_name.clear();
+    track_count = 0;
+
+    if(image_size == D64_SECTOR_COUNT * D64_SECTOR_SIZE || image_size == D64_SECTOR_COUNT * (D64_SECTOR_SIZE + 1))
+        track_count = D64_TRACK_COUNT;
+    else if(image_size == D64_EXTENDED_SECTOR_COUNT * D64_SECTOR_SIZE || image_size == D64_EXTENDED_SECTOR_COUNT * (D64_SECTOR_SIZE + 1))
+        track_count = D64_EXTENDED_TRACK_COUNT;
+    else
+        return false;
+
+    image.assign(image_data, image_data + image_size);
+    return ReadDirectory();
+}
+
+/// @brief  Get the name of the disk from the BAM
+std::string D64ImageClass::GetDiskName()
+{
+    return disk_name;
+}
+
+/// @brief  Get all files of the directory (all types, without the scratched entries)
+const std::vector<D64_FILE_ENTRY> &D64ImageClass::GetFiles()
+{
+    return files;
+}
+
+/// @brief  Read the content of a file
+/// @param file  Directory entry of the file
+/// @param file_data  Content of the file (for PRG files with start address)
+/// @return  True if the sector chain of the file is valid
+bool D64ImageClass::ReadFile(const D64_FILE_ENTRY &file, std::vector<uint8_t> &file_data)
+{
+    return ReadChain(file.track, file.sector, file_data);
+}
+
+/// @brief  Get the number of sectors of a track
+/// @param track  Track (1-40)
+int D64ImageClass::GetSectorCount(int track)
+{
+    if(track <= 17)
+        return 21;
+    if(track <= 24)
+        return 19;
+    if(track <= 30)
+        return 18;
+    return 17;
+}
+
+/// @brief  Get a sector of the image
+/// @param track  Track (1-35 or 1-40)
+/// @param sector  Sector of the track
+/// @return  Pointer to the 256 bytes of the sector, nullptr if the sector does not exist
+uint8_t *D64ImageClass::GetSector(int track, int sector)
+{
+    if(track < 1 || track > track_count || sector < 0 || sector >= GetSectorCount(track))
+        return nullptr;
+
+    size_t offset = 0;
+    for(int i=1; i<track; i++)
+        offset += static_cast<size_t>(GetSectorCount(i));
+    offset += static_cast<size_t>(sector);
+
+    return image.data() + offset * D64_SECTOR_SIZE;
+}
+
+/// @brief  Read the data of a sector chain
+/// @param track  First track of the chain
+/// @param sector  First sector of the chain
+/// @param chain_data  Data bytes of all sectors (without the track/sector links)
+/// @return  True if the chain ends correctly
+/// @note   Byte 0 and 1 of a sector link to the next sector, in the last sector
+///         (track 0) byte 1 is the position of the last used byte.
+bool D64ImageClass::ReadChain(int track, int sector, std::vector<uint8_t> &chain_data)
+{
+    chain_data.clear();
+    std::vector<bool> visited(D64_EXTENDED_SECTOR_COUNT, false);
+
+    while(true)
+    {
+        const uint8_t *sector_data = GetSector(track, sector);
+        if(sector_data == nullptr)
+            return false;
+
+        size_t sector_number = static_cast<size_t>(sector_data - image.data()) / D64_SECTOR_SIZE;
+        if(visited[sector_number])
+            return false;
+        visited[sector_number] = true;
+
+        if(sector_data[0] == 0)
+        {
+            // Last sector, byte 1 is the last used byte
+            if(sector_data[1] >= 2)
+                chain_data.insert(chain_data.end(), sector_data + 2, sector_data + sector_data[1] + 1);
+            return true;
+        }
+
+        chain_data.insert(chain_data.end(), sector_data + 2, sector_data + D64_SECTOR_SIZE);
+        track = sector_data[0];
+        sector = sector_data[1];
+    }
+}
+
+/// @brief  Read the disk name from the BAM and all directory entries
+/// @return  True if the directory chain is valid
+bool D64ImageClass::ReadDirectory()
+{
+    const uint8_t *bam = GetSector(D64_DIRECTORY_TRACK, D64_BAM_SECTOR);
+
+    // Disk name at $90 in the BAM, padded with $A0
+    const uint8_t *name = bam + 0x90;
+    int name_length = D64_FILENAME_LENGTH;
+    while(name_length > 0 && name[name_length - 1] == D64_FILENAME_PADDING)
+        name_length--;
+    disk_name.assign(reinterpret_cast<const char*>(name), static_cast<size_t>(name_length));
+
+    // The directory starts at the track/sector in the first bytes of the BAM (normally 18/1)
+    std::vector<uint8_t> directory;
+    if(!ReadChain(bam[0], bam[1], directory))
+    {
+        // Read the entries up to the damaged sector
+        if(directory.empty())
+            return false;
+    }
+
+    // The links of the sectors are removed (254 bytes per sector), an entry
+    // starts with the file type every 32 bytes and has 30 bytes
+    const size_t chain_sector_size = D64_SECTOR_SIZE - 2;
+    const size_t entry_size = D64_DIRECTORY_ENTRY_SIZE - 2;
+
+    for(size_t sector_pos = 0; sector_pos < directory.size(); sector_pos += chain_sector_size)
+    {
+        for(size_t pos = sector_pos; pos < sector_pos + chain_sector_size && pos + entry_size <= directory.size(); pos += D64_DIRECTORY_ENTRY_SIZE)
+        {
+            const uint8_t *entry = directory.data() + pos;
+            if(entry[0] == D64_FILE_TYPE_DEL)
+                continue;
+
+            D64_FILE_ENTRY file;
+            file.file_type = entry[0];
+            file.track = entry[1];
+            file.sector = entry[2];
+
+            int filename_length = D64_FILENAME_LENGTH;
+            while(filename_length > 0 && entry[3 + filename_length - 1] == D64_FILENAME_PADDING)
+                filename_length--;
+            file.filename.assign(reinterpret_cast<const char*>(entry + 3), static_cast<size_t>(filename_length));
+
+            file.blocks = static_cast<uint16_t>(entry[28] | entry[29] << 8);
+            files.push_back(file);
+        }
+    }
+
+    return true;
+}
+
+/// @brief  Create an empty image (35 tracks) with BAM and directory
+/// @param new_disk_name  Name of the disk (max. 16 characters)
+/// @param disk_id  ID of the disk (2 characters)
+void D64ImageClass::Format(const std::string &new_disk_name, const std::string &disk_id)
+{
+    image.assign(D64_SECTOR_COUNT * D64_SECTOR_SIZE, 0x00);
+    track_count = D64_TRACK_COUNT;
+    files.clear();
+    disk_name = new_disk_name.substr(0, D64_FILENAME_LENGTH);
+
+    uint8_t *bam = GetSector(D64_DIRECTORY_TRACK, D64_BAM_SECTOR);
+    bam[0] = D64_DIRECTORY_TRACK;   // First directory sector
+    bam[1] = 1;
+    bam[2] = 0x41;                  // DOS version 'A'
+
+    // All sectors free (bit set = free)
+    for(int track=1; track<=D64_TRACK_COUNT; track++)
+    {
+        uint8_t *bam_entry = GetBAMEntry(track);
+        bam_entry[0] = static_cast<uint8_t>(GetSectorCount(track));
+        for(int sector=0; sector<GetSectorCount(track); sector++)
+            bam_entry[1 + sector / 8] |= static_cast<uint8_t>(1 << (sector % 8));
+    }
+
+    // Disk name, ID and DOS type "2A", padded with $A0
+    memset(bam + 0x90, D64_FILENAME_PADDING, 0x1B);
+    memcpy(bam + 0x90, disk_name.data(), disk_name.size());
+    bam[0xA2] = disk_id.size() > 0 ? static_cast<uint8_t>(disk_id[0]) : 0x30;
+    bam[0xA3] = disk_id.size() > 1 ? static_cast<uint8_t>(disk_id[1]) : 0x30;
+    bam[0xA5] = '2';
+    bam[0xA6] = 'A';
+
+    uint8_t *directory = GetSector(D64_DIRECTORY_TRACK, 1);
+    directory[0] = 0x00;
+    directory[1] = 0xFF;
+
+    AllocateSector(D64_DIRECTORY_TRACK, D64_BAM_SECTOR);
+    AllocateSector(D64_DIRECTORY_TRACK, 1);
+}
+
+/// @brief  Write a file to the image
+/// @param filename  Filename (max. 16 characters, PETSCII)
+/// @param file_data  Content of the file (for PRG files with start address)
+/// @param file_type  File type with the flags of the directory entry
+/// @return  False if there is no image, the disk is full or the directory has no free entry
+/// @note   The sectors are allocated like the 1541 DOS does it, starting next to
+///         the directory track with an interleave of 10 sectors.
+bool D64ImageClass::AddFile(const std::string &filename, const std::vector<uint8_t> &file_data, uint8_t file_type)
+{
+    if(track_count == 0)
+        return false;
+
+    const size_t chain_sector_size = D64_SECTOR_SIZE - 2;
+    size_t blocks = file_data.empty() ? 1 : (file_data.size() + chain_sector_size - 1) / chain_sector_size;
+    if(blocks > static_cast<size_t>(GetFreeBlocks()))
+        return false;
+
+    uint8_t *entry;
+    if(!AddDirectoryEntry(entry))
+        return false;
+
+    D64_FILE_ENTRY file;
+    file.file_type = file_type;
+    file.filename = filename.substr(0, D64_FILENAME_LENGTH);
+    file.blocks = static_cast<uint16_t>(blocks);
+
+    int track = 0;
+    int sector = 0;
+    uint8_t *last_sector = nullptr;
+
+    for(size_t pos = 0; pos == 0 || pos < file_data.size(); pos += chain_sector_size)
+    {
+        AllocateNextSector(track, sector);
+        AllocateSector(track, sector);
+
+        if(last_sector == nullptr)
+        {
+            file.track = static_cast<uint8_t>(track);
+            file.sector = static_cast<uint8_t>(sector);
+        }
+        else
+        {
+            last_sector[0] = static_cast<uint8_t>(track);
+            last_sector[1] = static_cast<uint8_t>(sector);
+        }
+
+        size_t count = std::min(chain_sector_size, file_data.size() - std::min(pos, file_data.size()));
+        last_sector = GetSector(track, sector);
+        memset(last_sector, 0x00, D64_SECTOR_SIZE);
+        if(count > 0)
+            memcpy(last_sector + 2, file_data.data() + pos, count);
+
+        // Last sector: track 0 and the position of the last used byte
+        last_sector[0] = 0x00;
+        last_sector[1] = static_cast<uint8_t>(count + 1);
+    }
+
+    // Directory entry (starts with the file type)
+    memset(entry, 0x00, D64_DIRECTORY_ENTRY_SIZE - 2);
+    entry[0] = file.file_type;
+    entry[1] = file.track;
+    entry[2] = file.sector;
+    memset(entry + 3, D64_FILENAME_PADDING, D64_FILENAME_LENGTH);
+    memcpy(entry + 3, file.filename.data(), file.filename.size());
+    entry[28] = static_cast<uint8_t>(file.blocks);
+    entry[29] = static_cast<uint8_t>(file.blocks >> 8);
+
+    files.push_back(file);
+    return true;
+}
+
+/// @brief  Get the number of free blocks from the BAM (without the directory track)
+int D64ImageClass::GetFreeBlocks()
+{
+    int free_blocks = 0;
+    for(int track=1; track<=D64_TRACK_COUNT; track++)
+    {
+        uint8_t *bam_entry = GetBAMEntry(track);
+        if(track != D64_DIRECTORY_TRACK && bam_entry != nullptr)
+            free_blocks += bam_entry[0];
+    }
+    return free_blocks;
+}
+
+/// @brief  Get the complete image (to write it to a file)
+const std::vector<uint8_t> &D64ImageClass::GetImage()
+{
+    return image;
+}
+
+/// @brief  Get the BAM entry of a track (free sectors and bitmap)
+/// @param track  Track (1-35)
+/// @return  Pointer to the 4 bytes of the track, nullptr without image or for the tracks 36-40
+uint8_t *D64ImageClass::GetBAMEntry(int track)
+{
+    uint8_t *bam = GetSector(D64_DIRECTORY_TRACK, D64_BAM_SECTOR);
+    if(bam == nullptr || track < 1 || track > D64_TRACK_COUNT)
+        return nullptr;
+    return bam + 4 * track;
+}
+
+bool D64ImageClass::IsSectorFree(int track, int sector)
+{
+    uint8_t *bam_entry = GetBAMEntry(track);
+    if(bam_entry == nullptr || sector < 0 || sector >= GetSectorCount(track))
+        return false;
+    return (bam_entry[1 + sector / 8] & (1 << (sector % 8))) != 0;
+}
+
+void D64ImageClass::AllocateSector(int track, int sector)
+{
+    if(!IsSectorFree(track, sector))
+        return;
+
+    uint8_t *bam_entry = GetBAMEntry(track);
+    bam_entry[1 + sector / 8] &= static_cast<uint8_t>(~(1 << (sector % 8)));
+    bam_entry[0]--;
+}
+
+/// @brief  Find a free sector on a track
+/// @param track  Track
+/// @param start_sector  Last used sector
+/// @param interleave  Distance to the last used sector
+/// @param sector  Found sector
+/// @return  False if the track is full
+bool D64ImageClass::FindFreeSector(int track, int start_sector, int interleave, int &sector)
+{
+    uint8_t *bam_entry = GetBAMEntry(track);
+    if(bam_entry == nullptr || bam_entry[0] == 0)
+        return false;
+
+    int sector_count = GetSectorCount(track);
+    for(int i=0; i<sector_count; i++)
+    {
+        sector = (start_sector + interleave + i) % sector_count;
+        if(IsSectorFree(track, sector))
+            return true;
+    }
+    return false;
+}
+
+/// @brief  Find the next free sector of a file
+/// @param track  Track of the last sector (0 for the first sector of a file), the found track
+/// @param sector  Last sector, the found sector
+/// @return  False if the disk is full
+/// @note   A file stays on its track, then moves away from the directory track,
+///         at last the tracks are searched by their distance to the directory track.
+bool D64ImageClass::AllocateNextSector(int &track, int &sector)
+{
+    if(track != 0)
+    {
+        if(FindFreeSector(track, sector, D64_SECTOR_INTERLEAVE, sector))
+            return true;
+
+        int direction = track < D64_DIRECTORY_TRACK ? -1 : 1;
+        for(int next_track = track + direction; next_track >= 1 && next_track <= D64_TRACK_COUNT; next_track += direction)
+        {
+            if(FindFreeSector(next_track, 0, 0, sector))
+            {
+                track = next_track;
+                return true;
+            }
+        }
+    }
+
+    for(int distance=1; distance<D64_DIRECTORY_TRACK; distance++)
+    {
+        const int next_tracks[2] = {D64_DIRECTORY_TRACK - distance, D64_DIRECTORY_TRACK + distance};
+        for(int next_track : next_tracks)
+        {
+            if(FindFreeSector(next_track, 0, 0, sector))
+            {
+                track = next_track;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/// @brief  Find a free directory entry, a new directory sector is added if all are used
+/// @param entry  Pointer to the entry (from the file type byte on, 30 bytes)
+/// @return  False if the directory track is full
+bool D64ImageClass::AddDirectoryEntry(uint8_t *&entry)
+{
+    uint8_t *bam = GetSector(D64_DIRECTORY_TRACK, D64_BAM_SECTOR);
+    int sector = bam[1];
+    std::vector<bool> visited(static_cast<size_t>(GetSectorCount(D64_DIRECTORY_TRACK)), false);
+
+    while(true)
+    {
+        uint8_t *directory = GetSector(D64_DIRECTORY_TRACK, sector);
+        if(directory == nullptr || visited[static_cast<size_t>(sector)])
+            return false;
+        visited[static_cast<size_t>(sector)] = true;
+
+        for(int i=0; i<D64_SECTOR_SIZE; i+=D64_DIRECTORY_ENTRY_SIZE)
+        {
+            if(directory[i + 2] == D64_FILE_TYPE_DEL)
+            {
+                entry = directory + i + 2;
+                return true;
+            }
+        }
+
+        if(directory[0] != D64_DIRECTORY_TRACK)
+        {
+            // Last directory sector, link a new one
+            int new_sector;
+            if(!FindFreeSector(D64_DIRECTORY_TRACK, sector, D64_DIRECTORY_INTERLEAVE, new_sector))
+                return false;
+            AllocateSector(D64_DIRECTORY_TRACK, new_sector);
+
+            directory[0] = D64_DIRECTORY_TRACK;
+            directory[1] = static_cast<uint8_t>(new_sector);
+
+            uint8_t *new_directory = GetSector(D64_DIRECTORY_TRACK, new_sector);
+            memset(new_directory, 0x00, D64_SECTOR_SIZE);
+            new_directory[1] = 0xFF;
+        }
+
+        sector = directory[1];
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef D64_IMAGE_CLASS_H
+#define D64_IMAGE_CLASS_H
+
+#include <vector>
+#include <string>
+#include <inttypes.h>
+#include <cstddef>
+
+// D64 disk image (1541)
+// 35 tracks (optional 40), 17-21 sectors per track with 256 bytes, optional
+// with one error byte per sector behind the sectors.
+#define D64_SECTOR_SIZE 256
+#define D64_TRACK_COUNT 35
+#define D64_EXTENDED_TRACK_COUNT 40
+#define D64_SECTOR_COUNT 683
+#define D64_EXTENDED_SECTOR_COUNT 768
+#define D64_DIRECTORY_TRACK 18
+#define D64_BAM_SECTOR 0
+#define D64_DIRECTORY_ENTRY_SIZE 32
+#define D64_FILENAME_LENGTH 16
+#define D64_FILENAME_PADDING 0xA0
+#define D64_SECTOR_INTERLEAVE 10            // Interleave of the file sectors (like the 1541 DOS)
+#define D64_DIRECTORY_INTERLEAVE 3          // Interleave of the directory sectors
+
+// File types in the directory
+#define D64_FILE_TYPE_DEL 0x00
+#define D64_FILE_TYPE_SEQ 0x01
+#define D64_FILE_TYPE_PRG 0x02
+#define D64_FILE_TYPE_USR 0x03
+#define D64_FILE_TYPE_REL 0x04
+#define D64_FILE_TYPE_MASK 0x07
+#define D64_FILE_CLOSED 0x80
+
+struct D64_FILE_ENTRY
+{
+    uint8_t file_type;          // File type with the flags (closed, locked)
+    uint8_t track;              // First track of the file
+    uint8_t sector;             // First sector of the file
+    std::string filename;       // Filename (PETSCII, without the padding bytes)
+    uint16_t blocks;            // Size in blocks from the directory
+};
+
+/// @brief  D64 disk image
+/// @note   The image is copied and read in memory, the BAM gives the disk
+///         name and the directory track/sector, the directory and the files
+///         are read by following their sector chains (every sector is
+///         visited at most once, so a damaged chain cannot loop).
+///         A new image is created with Format and AddFile in memory and
+///         written at once with GetImage.
+class D64ImageClass
+{
+public:
+    D64ImageClass();
+    bool Load(const uint8_t *image_data, size_t image_size);
+    std::string GetDiskName();
+    const std::vector<D64_FILE_ENTRY> &GetFiles();
+    bool ReadFile(const D64_FILE_ENTRY &file, std::vector<uint8_t> &file_data);
+
+    void Format(const std::string &new_disk_name, const std::string &disk_id);
+    bool AddFile(const std::string &filename, const std::vector<uint8_t> &file_data, uint8_t file_type = D64_FILE_TYPE_PRG | D64_FILE_CLOSED);
+    int GetFreeBlocks();
+    const std::vector<uint8_t> &GetImage();
+
+private:
+    int GetSectorCount(int track);
+    uint8_t *GetSector(int track, int sector);
+    bool ReadChain(int track, int sector, std::vector<uint8_t> &chain_data);
+    bool ReadDirectory();
+    uint8_t *GetBAMEntry(int track);
+    bool IsSectorFree(int track, int sector);
+    void AllocateSector(int track, int sector);
+    bool FindFreeSector(int track, int start_sector, int interleave, int &sector);
+    bool AllocateNextSector(int &track, int &sector);
+    bool AddDirectoryEntry(uint8_t *&entry);
+
+    std::vector<uint8_t> image;
+    int track_count;
+    std::string disk_name;
+    std::vector<D64_FILE_ENTRY> files;
+};
+
+#endif // D64_IMAGE_CLASS_H
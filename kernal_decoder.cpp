@@ -0,0 +1,20 @@
+#include "./kernal_decoder.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+thread_local uint8_t tap_version;
+thread_local bool decoder_messages = true;
+
+/// @brief  Print a message of the kernal decoder
+/// @param format  printf format string
+/// @note   Nothing is printed if decoder_messages is false in this thread.
+void DecoderPrint(const char *format, ...)
+{
+    if(!decoder_messages)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
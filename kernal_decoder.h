@@ -0,0 +1,219 @@
+#ifndef KERNAL_DECODER_H
+#define KERNAL_DECODER_H
+
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+#include "timing_profile.h"
+#include "tap_pulse_feed_class.h"
+
+// Kernal byte decoder of the TAP files
+// The pulses are classified with the windows of a timing profile (template
+// parameter TIMING), a byte is a ByteMarker (Long + Medium) followed by 8 data
+// bits and the parity bit (Short + Medium = 0, Medium + Short = 1).
+// The pulses of a TAP file are read with the pulse feed (TAPPulseFeedClass).
+
+extern thread_local uint8_t tap_version;            // Version of the TAP file which is decoded in this thread
+extern thread_local bool decoder_messages;          // false: the kernal decoder prints no messages (used by decoder threads)
+
+void DecoderPrint(const char *format, ...);
+
+/// @brief  Get the next pulse from the TAP file
+/// @param feed  Pulse feed of the TAP file
+/// @return  Type of the pulse (Short, Medium, Long, Unknown) with the windows of the timing profile
+template<class TIMING>
+inline uint8_t GetNextPulse(TAPPulseFeedClass &feed)
+{
+    return TIMING::GetPulseType(feed.GetNextPulse());
+}
+
+/// @brief  State of the kernal byte decoder
+/// @note   GetNextKernalByte starts every byte with a new state, a live
+///         stream pushes its pulses one by one into DecodeKernalPulse.
+struct KERNAL_DECODER_STATE
+{
+    uint32_t sync_start;
+    uint32_t sync_end;
+    uint32_t sync_pulse_count;
+    bool found_sync;
+    uint8_t last_pulse;         // 0 = Short, 1 = Medium, 2 = Long
+    uint8_t pulse_counter;
+    bool byte_reading;
+    uint8_t parity_bit;
+    uint8_t data_byte;
+    bool start_new_block;       // A sync was found before the byte
+};
+
+enum KERNAL_DECODE_RESULT {KERNAL_DECODE_NO_BYTE, KERNAL_DECODE_BYTE, KERNAL_DECODE_PARITY_ERROR};
+
+/// @brief  Start a new byte in the kernal byte decoder
+inline void ResetKernalDecoder(KERNAL_DECODER_STATE &decoder)
+{
+    decoder.sync_start = 0;
+    decoder.sync_end = 0;
+    decoder.sync_pulse_count = 0;
+    decoder.found_sync = false;
+    decoder.last_pulse = 0;
+    decoder.pulse_counter = 0;
+    decoder.byte_reading = false;
+    decoder.parity_bit = 1;
+    decoder.data_byte = 0;
+    decoder.start_new_block = false;
+}
+
+/// @brief  Decode one pulse of a kernal byte
+/// @param decoder  State of the decoder
+/// @param pulse_type  Type of the pulse (Short, Medium, Long, Unknown)
+/// @param pos  Position of the pulse (for the messages)
+/// @return  KERNAL_DECODE_RESULT, the byte is in decoder.data_byte
+/// @note   The last pulse of a byte is also the first pulse of the next byte,
+///         it is decoded again with a new state.
+inline int DecodeKernalPulse(KERNAL_DECODER_STATE &decoder, uint8_t pulse_type, uint32_t pos)
+{
+    switch (pulse_type)
+    {
+    case PULSE_TYPE::SHORT_PULSE:
+        // Short Pulse
+        decoder.pulse_counter++;
+        decoder.sync_pulse_count++;
+
+        if((decoder.sync_pulse_count > 1) && !decoder.found_sync)
+        {
+            decoder.sync_start = pos-1;
+            decoder.found_sync = true;
+        }
+
+        if(decoder.byte_reading)
+        {
+            if(((decoder.pulse_counter & 1) == 0) && (decoder.last_pulse == MEDIUM_PULSE))
+            {
+                // Bit is 1
+                if(decoder.pulse_counter <= 16)
+                {
+                    decoder.data_byte >>= 1;
+                    decoder.data_byte |= 0x80;
+                    decoder.parity_bit ^= 1;
+                }
+                else if(decoder.pulse_counter == 18)
+                {
+                    // Parity Check
+                    return decoder.parity_bit == 0 ? KERNAL_DECODE_PARITY_ERROR : KERNAL_DECODE_BYTE;
+                }
+            }
+        }
+
+        decoder.last_pulse = SHORT_PULSE;
+        break;
+
+    case PULSE_TYPE::MEDIUM_PULSE:
+        // Medium Pulse
+        decoder.pulse_counter++;
+
+        if(decoder.found_sync)
+        {
+            decoder.sync_end = pos-1;
+            decoder.found_sync = false;
+            if(decoder.sync_end - decoder.sync_start >= 2)
+            {
+                decoder.start_new_block = true;
+                DecoderPrint("Sync found: %4.4x - %4.4x (%d pulses)\n",decoder.sync_start,decoder.sync_end, decoder.sync_end - decoder.sync_start);
+            }
+        }
+
+        if(decoder.byte_reading)
+        {
+            if(((decoder.pulse_counter & 1) == 0) && (decoder.last_pulse == SHORT_PULSE))
+            {
+                // Bit is 0
+                if(decoder.pulse_counter <= 16)
+                {
+                    decoder.data_byte >>= 1;
+                    decoder.data_byte &= 0x7f;
+                }
+                else if(decoder.pulse_counter == 18)
+                {
+                    // Parity Check
+                    if(decoder.parity_bit == 1)
+                    {
+                        DecoderPrint("Parity Error: %4.4x - %4.4x (%d pulses)\n",decoder.sync_start,decoder.sync_end, decoder.sync_end - decoder.sync_start);
+                        return KERNAL_DECODE_PARITY_ERROR;
+                    }
+                    return KERNAL_DECODE_BYTE;
+                }
+            }
+        }
+
+        // Check if last pulse was a short pulse the is here a ByteMarker
+        if(decoder.last_pulse == LONG_PULSE)
+        {
+            decoder.byte_reading = true;
+            decoder.pulse_counter = 0;
+        }
+
+        decoder.sync_pulse_count = 0;
+        decoder.last_pulse = MEDIUM_PULSE;
+        break;
+
+    case PULSE_TYPE::LONG_PULSE:
+        // Long Pulse
+        decoder.pulse_counter++;
+
+        if(decoder.found_sync)
+        {
+            decoder.sync_end = pos-1;
+            decoder.found_sync = false;
+            if(decoder.sync_end - decoder.sync_start >= 2)
+            {
+                decoder.start_new_block = true;
+                DecoderPrint("Sync found: %4.4x - %4.4x (%d pulses)\n",decoder.sync_start,decoder.sync_end, decoder.sync_end - decoder.sync_start);
+            }
+        }
+        decoder.sync_pulse_count = 0;
+        decoder.last_pulse = LONG_PULSE;
+        break;
+
+    default:
+        // Unknown Pulse
+        break;
+    }
+
+    return KERNAL_DECODE_NO_BYTE;
+}
+
+/// @brief  Get the next byte from the TAP file
+/// @param feed  Pulse feed of the TAP file, it stands on the last pulse of the byte behind the call
+/// @param error  Error flag
+/// @param start_new_block  A sync was found before the byte
+/// @return  Next byte from the TAP file
+template<class TIMING>
+uint8_t GetNextKernalByte(TAPPulseFeedClass &feed, bool &error, bool &start_new_block)
+{
+    KERNAL_DECODER_STATE decoder;
+    ResetKernalDecoder(decoder);
+
+    start_new_block = false;
+    error = false;
+
+    while (!feed.IsEnd())
+    {
+        uint32_t pulse_pos = feed.GetPosition();
+        uint8_t pulse_type = GetNextPulse<TIMING>(feed);
+
+        // Position of the last byte of the pulse (a pause of version 1 has 4 bytes)
+        int result = DecodeKernalPulse(decoder, pulse_type, feed.GetPosition() - 1);
+
+        if(result != KERNAL_DECODE_NO_BYTE)
+        {
+            // The last pulse of the byte is also the first pulse of the next byte
+            feed.SetPosition(pulse_pos);
+            error = result == KERNAL_DECODE_PARITY_ERROR;
+            start_new_block = decoder.start_new_block;
+            return decoder.data_byte;
+        }
+    }
+    start_new_block = decoder.start_new_block;
+    error = true;
+    return 0;
+}
+
+#endif // KERNAL_DECODER_H
@@ -1,52 +1,108 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <algorithm>
 #include <math.h>
+#include <stdarg.h>
+#include <thread>
+#include <atomic>
+#include <ctype.h>
+#include <signal.h>
+#include <errno.h>
 
 using namespace std;
 
 #define VERSION_STRING "0.1"
 
 #include "command_line_class.h"
+#include "tap_pulse.h"
+#include "timing_profile.h"
+#include "tap_cycle_index_class.h"
+#include "tap_pulse_feed_class.h"
+#include "csw_file.h"
+#include "wav_file.h"
+#include "tape_program_class.h"
+#include "d64_image_class.h"
+#include "t64_file.h"
+#include "wav_wave_table_class.h"
+#include "pcm_pulse_detector_class.h"
+#include "async_writer_class.h"
+#include "kernal_decoder.h"
 #include <string.h>
 
-// TAP Pulse Lengths (from VICE)
-// Short Pulse between 288 and 432 Cycles
-// Medium Pulse between 440 and 584 Cycles
-// Long Pulse between 592 and 800 Cycles
-// Cycles per second (PAL): 985248
-// Cycles per second (NTSC): 1022727
-#define SHORT_PULSE_MIN 288     // 0x24 (Databyte in TAP file)
-#define SHORT_PULSE_MAX 432     // 0x36 (Databyte in TAP file)
-#define MEDIUM_PULSE_MIN 440    // 0x37 (Databyte in TAP file)
-#define MEDIUM_PULSE_MAX 584    // 0x49 (Databyte in TAP file)
-#define LONG_PULSE_MIN 592      // 0x4A (Databyte in TAP file)
-#define LONG_PULSE_MAX 800      // 0x64 (Databyte in TAP file)
-
-// TAP Pulse Lengths for send to C64
-// Cycles per second (PAL): 985248
-// Cycles per second (NTSC): 1022727
-#define SHORT_PULSE_LENGTH 360
-#define MEDIUM_PULSE_LENGTH 524
-#define LONG_PULSE_LENGTH 687
-
-enum PULSE_TYPE {SHORT_PULSE, MEDIUM_PULSE, LONG_PULSE, UNKNOWN_PULSE};
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
 
 typedef std::vector<uint8_t> ByteVector;
 vector<ByteVector> current_block_list;
+vector<ByteVector> current_parity_error_list;
+vector<ByteVector> current_turbo_block_list;
+
+bool FindAllKernalBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block_list, vector<ByteVector> *parity_error_list = nullptr);
+bool FindAllTurboBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block_list);
+std::string GetKernalFilename(const ByteVector &header_block);
+bool IsKernalHeaderBlock(const ByteVector &block);
+std::string GetTurboFilename(const ByteVector &turbo_block);
 
 void AnalyzeTAPFile(const char *tap_file);
-void ExportTAPFile(const char *tap_file);
+void ExportTAPFile(const char *tap_file, const char *image_file = nullptr);
+void DiffTAPFiles(const char *tap_file_a, const char *tap_file_b);
+void SeekTAPFile(const char *tap_file, const char *position);
+void MergeTAPFiles(const vector<const char*> &tap_files);
 bool ConvertPRGToTAP(const char *prg_file, const char *tap_file);
+bool ConvertPRGsToTAP(const char *tap_file_name, const vector<const char*> &prg_files);
+bool ConvertD64ToTAP(const char *d64_file_name, const char *tap_file_name);
 bool ConvertPRGToWAV(const char *prg_file_name, const char *wav_file_name);
+bool ConvertTAPToWAVFile(const char *tap_file_name, const char *wav_file_name);
+bool PlayPRG(const char *prg_file_name);
+bool WriteWAVProgramFile(const char *wav_file_name, const TapeProgramClass &program);
+bool ConvertPRGToCSW(const char *prg_file_name, const char *csw_file_name, int csw_version);
+bool ConvertPRGToFiles(const char *prg_file_name, const vector<const char*> &output_files, int csw_version);
+bool ConvertTAPToCSWFile(const char *tap_file_name, const char *csw_file_name, int csw_version);
+bool ConvertWAVToTAPFile(const char *wav_file_name, const char *tap_file_name);
+bool CaptureTape(const char *tap_file_name);
+bool CleanTAPFile(const char *tap_file_name, const char *clean_tap_file_name);
+bool WriteOutputFile(const char *file_name, const ByteVector &data);
+std::string GetDisplayedPRGName(const std::string &prg_file_name);
 
 // Defineren aller Kommandozeilen Parameter
-enum CMD_COMMAND {CMD_HELP, CMD_VERSION, CMD_ANALYZE, CMD_EXPORT, CMD_CONVERT_TO_TAP, CMD_CONVERT_TO_WAV};
+enum CMD_COMMAND {CMD_HELP, CMD_VERSION, CMD_ANALYZE, CMD_EXPORT, CMD_CONVERT_TO_TAP, CMD_CONVERT_TO_WAV, CMD_DIFF, CMD_SEEK, CMD_MERGE, CMD_CONVERT_MULTI_TO_TAP, CMD_CONVERT_TO_CSW, CMD_CONVERT_TAP_TO_CSW, CMD_CSW_VERSION_1, CMD_TURBO, CMD_CONVERT_TO_FILES, CMD_TIMING_NTSC, CMD_TIMING_DREAN, CMD_TIMING_USER, CMD_CLEAN, CMD_CONVERT_D64_TO_TAP, CMD_EXPORT_IMAGE, CMD_WAV_SAMPLE_RATE, CMD_WAV_FORMAT, CMD_WAV_SQUARE, CMD_CONVERT_TAP_TO_WAV, CMD_CONVERT_WAV_TO_TAP, CMD_CAPTURE, CMD_CAPTURE_TO_TAP, CMD_PCM_SAMPLE_RATE, CMD_PCM_FORMAT, CMD_PCM_CHANNELS, CMD_PLAY};
 static const CMD_STRUCT command_list[]{
     {CMD_ANALYZE, "a", "analyze", "Analyzes the tap file. (c64_tap_tool --analyze <filename>)", 1},
     {CMD_EXPORT, "e", "export", "Export all files in this tap file as prg. (c64_tap_tool --export <filename>)", 1},
+    {CMD_EXPORT_IMAGE, "", "export-image", "Export all files in this tap file into one t64 or d64 image, the format is selected by the extension. (c64_tap_tool --export-image <tap_filename> <image_filename>)", 2},
     {CMD_CONVERT_TO_TAP, "", "conv2tap", "Convert a prg to a tap file. (c64_tap_tool --conv2tap <prg_filename> <tap_filename>)", 2},
+    {CMD_CONVERT_MULTI_TO_TAP, "", "conv2tap-multi", "Convert several prg files to one tap file, the displayed name can follow a '='. (c64_tap_tool --conv2tap-multi <tap_filename> <prg_filename>[=<name>] ...)", CMD_VARIABLE_ARG_COUNT},
+    {CMD_CONVERT_D64_TO_TAP, "", "d642tap", "Convert all prg files of a d64 image to one tap file with their original names. (c64_tap_tool --d642tap <d64_filename> <tap_filename>)", 2},
+    {CMD_CONVERT_TO_FILES, "", "convert", "Convert a prg to several files with one encode, the format is selected by the extension (.tap, .wav, .csw). (c64_tap_tool --convert <prg_filename> <output_filename> ...)", CMD_VARIABLE_ARG_COUNT},
+    {CMD_CONVERT_TO_CSW, "", "conv2csw", "Convert a prg to a csw file (version 2, compressed if zlib is available). (c64_tap_tool --conv2csw <prg_filename> <csw_filename>)", 2},
+    {CMD_CONVERT_TAP_TO_CSW, "", "tap2csw", "Convert a tap to a csw file. (c64_tap_tool --tap2csw <tap_filename> <csw_filename>)", 2},
+    {CMD_CSW_VERSION_1, "", "csw1", "Write csw files in version 1 (uncompressed).", 0},
+    {CMD_TURBO, "", "turbo", "Write prg files in turbo format (loader in the kernal header, one pulse per bit) with conv2tap, conv2tap-multi, conv2csw and conv2wav.", 0},
+    {CMD_TIMING_NTSC, "", "ntsc", "Use the NTSC timing (clock, wav frequencies, tap header) instead of PAL.", 0},
+    {CMD_TIMING_DREAN, "", "drean", "Use the Drean (PAL-N) timing instead of PAL.", 0},
+    {CMD_TIMING_USER, "", "user-timing", "Use the user defined timing set at compile time (USER_TIMING_*) instead of PAL.", 0},
     {CMD_CONVERT_TO_WAV, "", "conv2wav", "Convert a prg to a wav file. (c64_tap_tool --conv2wav <prg_filename> <wav_filename>)", 2},
+    {CMD_CONVERT_TAP_TO_WAV, "", "tap2wav", "Convert a tap file (version 0 or 1) to a wav file, pauses are written as silence. (c64_tap_tool --tap2wav <tap_filename> <wav_filename>)", 2},
+    {CMD_CONVERT_WAV_TO_TAP, "", "wav2tap", "Convert a wav file (recording of a tape, 8/16/24/32 bit pcm or float) to a tap file (version 1). (c64_tap_tool --wav2tap <wav_filename> <tap_filename>)", 2},
+    {CMD_PLAY, "", "play", "Stream a prg as raw pcm samples (no WAV header) to stdout while it is rendered, for a player like aplay. Sample rate and format are taken from --wav-rate and --wav-format. (c64_tap_tool --play <prg_filename> | aplay -f FLOAT_LE -r 44100)", 1},
+    {CMD_CAPTURE, "", "capture", "Decode a tape live from raw pcm samples on stdin (e.g. from arecord) and show the blocks and filenames while it plays. (arecord -f S16_LE -r 44100 | c64_tap_tool --capture)", 0},
+    {CMD_CAPTURE_TO_TAP, "", "capture-tap", "Like capture, the tape is also written to a tap file (version 1) while it plays. (arecord -f S16_LE -r 44100 | c64_tap_tool --capture-tap <tap_filename>)", 1},
+    {CMD_PCM_SAMPLE_RATE, "", "pcm-rate", "Sample rate of the raw pcm samples of capture in Hz, default 44100. (c64_tap_tool --pcm-rate <sample_rate> --capture)", 1},
+    {CMD_PCM_FORMAT, "", "pcm-format", "Sample format of the raw pcm samples of capture: u8, s16 (default), s24, s32 or float (little endian). (c64_tap_tool --pcm-format <format> --capture)", 1},
+    {CMD_PCM_CHANNELS, "", "pcm-channels", "Number of channels of the raw pcm samples of capture, default 1, the first channel is used. (c64_tap_tool --pcm-channels <channels> --capture)", 1},
+    {CMD_WAV_SAMPLE_RATE, "", "wav-rate", "Sample rate of the written wav files in Hz, default 44100 (e.g. 22050 or 11025). (c64_tap_tool --wav-rate <sample_rate> --conv2wav ...)", 1},
+    {CMD_WAV_FORMAT, "", "wav-format", "Sample format of the written wav files: float (default), pcm16 or pcm8. (c64_tap_tool --wav-format <format> --conv2wav ...)", 1},
+    {CMD_WAV_SQUARE, "", "wav-square", "Write the pulses in wav files as square waves instead of sine waves (for datasettes and C2N interfaces), needs a sample rate of at least 22050 Hz.", 0},
+    {CMD_DIFF, "", "diff", "Compares the pulses and blocks of two tap files. (c64_tap_tool --diff <tap_filename_a> <tap_filename_b>)", 2},
+    {CMD_CLEAN, "", "clean", "Quantize all recognized pulses to the canonical lengths, unknown pulses and pauses are kept. (c64_tap_tool --clean <tap_filename> <clean_tap_filename>)", 2},
+    {CMD_SEEK, "", "seek", "Find the file position of a time (hh:mm:ss, mm:ss, seconds) or block (block:<n>). (c64_tap_tool --seek <tap_filename> <position>)", 2},
+    {CMD_MERGE, "", "merge", "Merge several dumps of the same tape and export the repaired files as prg. (c64_tap_tool --merge <tap_filename_1> <tap_filename_2> ...)", CMD_VARIABLE_ARG_COUNT},
     {CMD_HELP, "?", "help", "This text.", 0},
     {CMD_VERSION, "", "version", "Displays the current version number.", 0}
 };
@@ -54,7 +110,15 @@ static const CMD_STRUCT command_list[]{
 #define command_list_count sizeof(command_list) / sizeof(command_list[0])
 
 CommandLineClass *cmd;
-uint8_t tap_version;
+bool turbo_mode = false;                        // true: PRG files are written in turbo format
+int timing_profile = TIMING_PAL;                // Timing of the machine (TIMING_PROFILE), selects the instantiation of encoder and decoder
+uint32_t wav_sample_rate = WAV_DEFAULT_SAMPLE_RATE;     // Sample rate of the written WAV files
+int wav_sample_format = WAV_FORMAT_FLOAT;               // Sample format of the written WAV files (WAV_SAMPLE_FORMAT)
+int wav_waveform = WAV_WAVE_SINE;                       // Waveform of the pulses in the written WAV files (WAV_WAVEFORM)
+uint32_t pcm_sample_rate = WAV_DEFAULT_SAMPLE_RATE;     // Sample rate of the raw PCM samples of a live capture
+uint16_t pcm_format_tag = WAV_FORMAT_TAG_PCM;           // Sample format of the raw PCM samples (WAV_FORMAT_TAG_PCM or WAV_FORMAT_TAG_FLOAT)
+uint16_t pcm_bits_per_sample = 16;
+uint16_t pcm_channels = 1;
 
 /// TAP Block Header
 /// @brief  Kernal Header Block
@@ -93,6 +157,103 @@ int main(int argc, char *argv[])
 
     if(cmd->GetCommandCount() > 0)
     {
+        turbo_mode = cmd->FoundCommand(CMD_TURBO);
+        if(cmd->FoundCommand(CMD_WAV_SQUARE))
+            wav_waveform = WAV_WAVE_SQUARE;
+
+        if(cmd->FoundCommand(CMD_TIMING_NTSC))
+            timing_profile = TIMING_NTSC;
+        else if(cmd->FoundCommand(CMD_TIMING_DREAN))
+            timing_profile = TIMING_DREAN;
+        else if(cmd->FoundCommand(CMD_TIMING_USER))
+            timing_profile = TIMING_USER;
+
+        for(int i=0; i<cmd->GetCommandCount(); i++)
+        {
+            if(cmd->GetCommand(i) == CMD_WAV_SAMPLE_RATE)
+            {
+                bool err;
+                int sample_rate = cmd->GetArgInt(i+1, &err);
+                if(err || sample_rate < WAV_MIN_SAMPLE_RATE || sample_rate > WAV_MAX_SAMPLE_RATE)
+                {
+                    printf("Invalid WAV sample rate (%d - %d Hz): %s\n", WAV_MIN_SAMPLE_RATE, WAV_MAX_SAMPLE_RATE, cmd->GetArg(i+1));
+                    return(-1);
+                }
+                wav_sample_rate = static_cast<uint32_t>(sample_rate);
+            }
+
+            if(cmd->GetCommand(i) == CMD_WAV_FORMAT)
+            {
+                const char *format = cmd->GetArg(i+1);
+                if(strcmp(format, "float") == 0)
+                    wav_sample_format = WAV_FORMAT_FLOAT;
+                else if(strcmp(format, "pcm16") == 0)
+                    wav_sample_format = WAV_FORMAT_PCM16;
+                else if(strcmp(format, "pcm8") == 0)
+                    wav_sample_format = WAV_FORMAT_PCM8;
+                else
+                {
+                    printf("Unknown WAV sample format (float, pcm16, pcm8): %s\n", format);
+                    return(-1);
+                }
+            }
+
+            if(cmd->GetCommand(i) == CMD_PCM_SAMPLE_RATE)
+            {
+                bool err;
+                int sample_rate = cmd->GetArgInt(i+1, &err);
+                if(err || sample_rate < WAV_MIN_SAMPLE_RATE || sample_rate > WAV_MAX_SAMPLE_RATE)
+                {
+                    printf("Invalid PCM sample rate (%d - %d Hz): %s\n", WAV_MIN_SAMPLE_RATE, WAV_MAX_SAMPLE_RATE, cmd->GetArg(i+1));
+                    return(-1);
+                }
+                pcm_sample_rate = static_cast<uint32_t>(sample_rate);
+            }
+
+            if(cmd->GetCommand(i) == CMD_PCM_FORMAT)
+            {
+                const char *format = cmd->GetArg(i+1);
+                pcm_format_tag = WAV_FORMAT_TAG_PCM;
+                if(strcmp(format, "u8") == 0)
+                    pcm_bits_per_sample = 8;
+                else if(strcmp(format, "s16") == 0)
+                    pcm_bits_per_sample = 16;
+                else if(strcmp(format, "s24") == 0)
+                    pcm_bits_per_sample = 24;
+                else if(strcmp(format, "s32") == 0)
+                    pcm_bits_per_sample = 32;
+                else if(strcmp(format, "float") == 0)
+                {
+                    pcm_format_tag = WAV_FORMAT_TAG_FLOAT;
+                    pcm_bits_per_sample = 32;
+                }
+                else
+                {
+                    printf("Unknown PCM sample format (u8, s16, s24, s32, float): %s\n", format);
+                    return(-1);
+                }
+            }
+
+            if(cmd->GetCommand(i) == CMD_PCM_CHANNELS)
+            {
+                bool err;
+                int channels = cmd->GetArgInt(i+1, &err);
+                if(err || channels < 1 || channels > 8)
+                {
+                    printf("Invalid number of PCM channels (1 - 8): %s\n", cmd->GetArg(i+1));
+                    return(-1);
+                }
+                pcm_channels = static_cast<uint16_t>(channels);
+            }
+        }
+
+        // The edges of a square wave lie on whole samples, at low sample rates a pulse leaves its decoder window
+        if(wav_waveform == WAV_WAVE_SQUARE && wav_sample_rate < WAV_SQUARE_MIN_SAMPLE_RATE)
+        {
+            printf("Square waves need a WAV sample rate of at least %d Hz: %u\n", WAV_SQUARE_MIN_SAMPLE_RATE, wav_sample_rate);
+            return(-1);
+        }
+
         for(int i=0; i<cmd->GetCommandCount(); i++)
         {
             if(cmd->GetCommand(i) == CMD_ANALYZE)
@@ -125,18 +286,145 @@ int main(int argc, char *argv[])
                 }
             }
 
+            if(cmd->GetCommand(i) == CMD_EXPORT_IMAGE)
+            {
+                printf("Export all files in this TAP file into an image: %s\n", cmd->GetArg(i+1));
+                ExportTAPFile(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
             if(cmd->GetCommand(i) == CMD_CONVERT_TO_TAP)
             {
-                printf("Convert PRG to TAP file.\n");
+                // "-" writes the TAP file to stdout
+                if(strcmp(cmd->GetArg(i+2), "-") != 0)
+                    printf("Convert PRG to TAP file.\n");
                 ConvertPRGToTAP(cmd->GetArg(i+1), cmd->GetArg(i+2));
             }
 
+            if(cmd->GetCommand(i) == CMD_CONVERT_MULTI_TO_TAP)
+            {
+                if(cmd->GetArgCount(i) < 2)
+                {
+                    printf("A TAP file and at least one PRG file are needed.\n");
+                    return(-1);
+                }
+
+                vector<const char*> prg_files;
+                for(int j=2; j<=cmd->GetArgCount(i); j++)
+                    prg_files.push_back(cmd->GetArg(i+j));
+
+                if(strcmp(cmd->GetArg(i+1), "-") != 0)
+                    printf("Convert %d PRG files to TAP file.\n", static_cast<int>(prg_files.size()));
+                ConvertPRGsToTAP(cmd->GetArg(i+1), prg_files);
+            }
+
+            if(cmd->GetCommand(i) == CMD_CONVERT_D64_TO_TAP)
+            {
+                if(strcmp(cmd->GetArg(i+2), "-") != 0)
+                    printf("Convert D64 image to TAP file.\n");
+                ConvertD64ToTAP(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
+            if(cmd->GetCommand(i) == CMD_CONVERT_TO_FILES)
+            {
+                if(cmd->GetArgCount(i) < 2)
+                {
+                    printf("A PRG file and at least one output file are needed.\n");
+                    return(-1);
+                }
+
+                vector<const char*> output_files;
+                for(int j=2; j<=cmd->GetArgCount(i); j++)
+                    output_files.push_back(cmd->GetArg(i+j));
+
+                printf("Convert PRG to %d files.\n", static_cast<int>(output_files.size()));
+                ConvertPRGToFiles(cmd->GetArg(i+1), output_files, cmd->FoundCommand(CMD_CSW_VERSION_1) ? 1 : 2);
+            }
+
+            if(cmd->GetCommand(i) == CMD_CONVERT_TO_CSW)
+            {
+                if(strcmp(cmd->GetArg(i+2), "-") != 0)
+                    printf("Convert PRG to CSW file.\n");
+                ConvertPRGToCSW(cmd->GetArg(i+1), cmd->GetArg(i+2), cmd->FoundCommand(CMD_CSW_VERSION_1) ? 1 : 2);
+            }
+
+            if(cmd->GetCommand(i) == CMD_CONVERT_TAP_TO_CSW)
+            {
+                if(strcmp(cmd->GetArg(i+2), "-") != 0)
+                    printf("Convert TAP to CSW file.\n");
+                ConvertTAPToCSWFile(cmd->GetArg(i+1), cmd->GetArg(i+2), cmd->FoundCommand(CMD_CSW_VERSION_1) ? 1 : 2);
+            }
+
+            if(cmd->GetCommand(i) == CMD_CONVERT_TAP_TO_WAV)
+            {
+                printf("Convert TAP to WAV file.\n");
+                ConvertTAPToWAVFile(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
+            if(cmd->GetCommand(i) == CMD_CONVERT_WAV_TO_TAP)
+            {
+                if(strcmp(cmd->GetArg(i+2), "-") != 0)
+                    printf("Convert WAV to TAP file.\n");
+                ConvertWAVToTAPFile(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
+            if(cmd->GetCommand(i) == CMD_PLAY)
+            {
+                // stdout gets the samples, no messages
+                PlayPRG(cmd->GetArg(i+1));
+            }
+
+            if(cmd->GetCommand(i) == CMD_CAPTURE)
+            {
+                printf("Live capture from stdin.\n");
+                CaptureTape(nullptr);
+            }
+
+            if(cmd->GetCommand(i) == CMD_CAPTURE_TO_TAP)
+            {
+                printf("Live capture from stdin to TAP file.\n");
+                CaptureTape(cmd->GetArg(i+1));
+            }
+
             if(cmd->GetCommand(i) == CMD_CONVERT_TO_WAV)
             {
                 printf("Convert PRG to WAV file.\n");
                 ConvertPRGToWAV(cmd->GetArg(i+1), cmd->GetArg(i+2));
             }
 
+            if(cmd->GetCommand(i) == CMD_DIFF)
+            {
+                printf("Compare TAP files: %s <-> %s\n", cmd->GetArg(i+1), cmd->GetArg(i+2));
+                DiffTAPFiles(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
+            if(cmd->GetCommand(i) == CMD_SEEK)
+            {
+                SeekTAPFile(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
+            if(cmd->GetCommand(i) == CMD_CLEAN)
+            {
+                if(strcmp(cmd->GetArg(i+2), "-") != 0)
+                    printf("Clean TAP file: %s\n", cmd->GetArg(i+1));
+                CleanTAPFile(cmd->GetArg(i+1), cmd->GetArg(i+2));
+            }
+
+            if(cmd->GetCommand(i) == CMD_MERGE)
+            {
+                if(cmd->GetArgCount(i) < 2)
+                {
+                    printf("At least two TAP files are needed.\n");
+                    return(-1);
+                }
+
+                vector<const char*> tap_files;
+                for(int j=1; j<=cmd->GetArgCount(i); j++)
+                    tap_files.push_back(cmd->GetArg(i+j));
+
+                printf("Merge %d TAP files.\n", static_cast<int>(tap_files.size()));
+                MergeTAPFiles(tap_files);
+            }
+
         }
 
         if(cmd->FoundCommand(CMD_HELP))
@@ -176,254 +464,139 @@ bool IsTAPFile(uint8_t *data, uint32_t size)
     return true;
 }
 
-/// @brief  Get the next pulse from the TAP file
-/// @param data  Pointer to the TAP file data
-/// @param pos  Current position in the TAP file data
-/// @return  Type of the pulse (Short, Medium, Long, Unknown)
-uint8_t GetNextPulse(uint8_t *data, uint32_t &pos)
+/// @brief  Load a TAP file, a CSW or WAV file is converted to a TAP image (version 1)
+/// @param file_name  Path to the TAP, CSW or WAV file
+/// @param tap_data  Complete TAP image (with 4 padding bytes)
+/// @param tap_size  Size of the TAP image (without the padding bytes)
+/// @param source_format  Optional, set to "CSW" or "WAV" if the file was converted, otherwise nullptr
+/// @return  True if the file could be read (and converted), false otherwise
+/// @note   The padding bytes make sure that a v1 pause at the end can never read outside the buffer.
+bool LoadTAPImage(const char *file_name, ByteVector &tap_data, uint32_t &tap_size, const char **source_format = nullptr)
 {
-    uint32_t pulse_length = data[pos];
-    uint8_t pulse_type;
-    
-    if(pulse_length == 0x00)
-    {
-        if(tap_version == 0)
-        {
-            pulse_length = 256 * 8;
-        }
-            
-        if(tap_version == 1)
-        {
-            pulse_length = data[pos+1] | data[pos+2] << 8 | data[pos+3] << 16;
-            pos += 3;
-        }
-    }
-    else
-    {
-        pulse_length *= 8;
-    }
-
-    if(pulse_length >= SHORT_PULSE_MIN && pulse_length <= SHORT_PULSE_MAX)
-        {
-            pulse_type = SHORT_PULSE;
-        }
-        else if(pulse_length >= MEDIUM_PULSE_MIN && pulse_length <= MEDIUM_PULSE_MAX)
-        {
-            pulse_type = MEDIUM_PULSE;
-        }
-        else if(pulse_length >= LONG_PULSE_MIN && pulse_length <= LONG_PULSE_MAX)
-        {
-            pulse_type = LONG_PULSE;
-        }
-        else
-        {
-            pulse_type = UNKNOWN_PULSE;
-        }
-
-    return pulse_type;
-}
+    std::ifstream file_stream(file_name, ios::binary);
+    if(!file_stream.is_open())
+        return false;
 
-/// @brief  Get the next byte from the TAP file
-/// @param data  Pointer to the TAP file data
-/// @param size  Size of the TAP file data
-/// @param pos  Current position in the TAP file data
-/// @param error  Error flag
-/// @return  Next byte from the TAP file
-uint8_t GetNextKernalByte(uint8_t *data, uint32_t size, uint32_t &pos, bool &error, bool &start_new_block)
-{
-    u_int32_t sync_start = 0;
-    u_int32_t sync_end = 0;
-    uint32_t sync_pulse_count = 0;
-    bool found_sync = false;
+    file_stream.seekg(0, ios::end);
+    streamoff file_size = file_stream.tellg();
+    file_stream.seekg(0, ios::beg);
 
-    uint8_t last_pulse = 0;  // 0 = Short, 1 = Medium, 2 = Long
-    uint8_t pulse_counter = 0;
-    bool byte_reading = false;
-    uint8_t parity_bit = 1;
-    uint8_t data_byte = 0;
+    tap_data.resize(static_cast<size_t>(file_size));
+    file_stream.read((char*)tap_data.data(), file_size);
+    file_stream.close();
 
-    start_new_block = false;
-    error = false;
+    bool is_csw = IsCSWFile(tap_data.data(), tap_data.size());
+    bool is_wav = IsWAVFile(tap_data.data(), tap_data.size());
+    if(source_format != nullptr)
+        *source_format = is_csw ? "CSW" : is_wav ? "WAV" : nullptr;
 
-    while (pos < size)
+    if(is_csw)
     {
-        uint8_t pulse_type = GetNextPulse(data, pos);
-
-        switch (pulse_type)
-        {
-        case PULSE_TYPE::SHORT_PULSE:
-            // Short Pulse
-            pulse_counter++;
-            sync_pulse_count++;
-
-            if((sync_pulse_count > 1) && !found_sync)
-            {
-                sync_start = pos-1;
-                found_sync = true;
-            }
-
-            if(byte_reading)
-            {
-                if(((pulse_counter & 1) == 0) && (last_pulse == MEDIUM_PULSE))
-                {
-                    // Bit is 1
-                    if(pulse_counter <= 16)
-                    {
-                        data_byte >>= 1;
-                        data_byte |= 0x80;
-                        parity_bit ^= 1;
-                    }
-                    else if(pulse_counter == 18)
-                    {
-                        // Parity Check
-                        if(parity_bit == 0)
-                        {
-                            error = true;
-                        }
-                        else error = false;
-                        return data_byte;
-                    }
-                }
-            }
-
-            last_pulse = SHORT_PULSE;
-            break;
-        
-        case PULSE_TYPE::MEDIUM_PULSE:
-            // Medium Pulse
-            pulse_counter++;
-
-            if(found_sync)
-            {
-                sync_end = pos-1;
-                found_sync = false;
-                if(sync_end - sync_start >= 2) 
-                {
-                    start_new_block = true;
-                    printf("Sync found: %4.4x - %4.4x (%d pulses)\n",sync_start,sync_end, sync_end - sync_start);
-                }
-            }
-
-            if(byte_reading)
-            {
-                if(((pulse_counter & 1) == 0) && (last_pulse == SHORT_PULSE))
-                {
-                    // Bit is 0
-                    if(pulse_counter <= 16)
-                    {
-                        data_byte >>= 1;
-                        data_byte &= 0x7f;
-                        parity_bit ^= 0;
-                    }
-                    else if(pulse_counter == 18)
-                    {
-                        // Parity Check
-                        if(parity_bit == 1)
-                        {
-                            printf("Parity Error: %4.4x - %4.4x (%d pulses)\n",sync_start,sync_end, sync_end - sync_start);
-                            error = true;
-                        }
-                        else error = false;
-                        return data_byte;
-                   }
-                }
-            }
-            
-            // Check if last pulse was a short pulse the is here a ByteMarker
-            if(last_pulse == LONG_PULSE)
-            {
-                byte_reading = true;
-                pulse_counter = 0;
-            }
-
-            sync_pulse_count = 0;
-            last_pulse = MEDIUM_PULSE;
-            break;
-        case PULSE_TYPE::LONG_PULSE:
-            // Long Pulse
-            pulse_counter++;
-
-            if(found_sync)
-            {
-                sync_end = pos-1;
-                found_sync = false;
-                if(sync_end - sync_start >= 2)
-                {
-                    start_new_block = true;
-                    printf("Sync found: %4.4x - %4.4x (%d pulses)\n",sync_start,sync_end, sync_end - sync_start);
-                }
-            }
-            sync_pulse_count = 0;
-            last_pulse = LONG_PULSE;   
-            break;
-
-        case PULSE_TYPE::UNKNOWN_PULSE:
-            /* code */
-                //printf("Unknown Pulse at: %4.4x\n", pos);
-            break;
+        ByteVector csw_data;
+        csw_data.swap(tap_data);
+        if(!ConvertCSWToTAP(csw_data.data(), csw_data.size(), tap_data, GetTimingCyclesPerSecond(timing_profile)))
+            return false;
+    }
 
-        default:
-            break;
-        }
-        pos++;
+    if(is_wav)
+    {
+        ByteVector wav_data;
+        wav_data.swap(tap_data);
+        if(!ConvertWAVToTAP(wav_data.data(), wav_data.size(), tap_data, GetTimingCyclesPerSecond(timing_profile)))
+            return false;
     }
-    error = true;
-    return 0;
+
+    tap_size = static_cast<uint32_t>(tap_data.size());
+    tap_data.insert(tap_data.end(), 4, 0x00);
+    return true;
 }
 
+// Countdown (9 bytes) and checksum, a shorter block is a broken block
+#define KERNAL_BLOCK_MIN_SIZE 10
+
 /// @brief  Find all kernal blocks in the TAP file
 /// @param data  Pointer to the TAP file data
 /// @param size  Size of the TAP file data
 /// @param block_list  List of kernal blocks
+/// @param parity_error_list  Optional, if given bytes with parity errors are kept in
+///                           the blocks and marked here with 1 (one list per block)
 /// @return  True if all blocks are found, false otherwise
-bool FindAllKernalBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block_list)
+bool FindAllKernalBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block_list, vector<ByteVector> *parity_error_list)
 {
-    uint32_t pos = 0X14;    // start data's at position 0x14 in TAP file 
     bool error;
     bool start_new_block;
     bool ret = true;
 
     block_list.clear();
-    ByteVector *current_block;
+    if(parity_error_list != nullptr)
+        parity_error_list->clear();
+    ByteVector *current_block = nullptr;
 
-    while(pos < size)
+    // The pulses are read from position 0x14 in TAP file
+    TAPPulseFeedClass feed;
+    if(!feed.Open(data, size))
+        return false;
+
+    // The byte decoder of the timing profile is selected once
+    typedef uint8_t (*KERNAL_BYTE_DECODER)(TAPPulseFeedClass&, bool&, bool&);
+    KERNAL_BYTE_DECODER get_next_kernal_byte = CallWithTimingProfile(timing_profile, [](auto timing) -> KERNAL_BYTE_DECODER
+    {
+        return &GetNextKernalByte<decltype(timing)>;
+    });
+
+    while(!feed.IsEnd())
     {
-        uint8_t data_byte = GetNextKernalByte(data, size, pos, error, start_new_block);
-        if(!error)
+        uint8_t data_byte = get_next_kernal_byte(feed, error, start_new_block);
+
+        // Behind the end of the data there is no byte, otherwise the error is a parity error
+        bool parity_error = error && !feed.IsEnd();
+
+        if(!error || (parity_error && parity_error_list != nullptr))
         {
-            if(start_new_block)
+            if(start_new_block || current_block == nullptr)
             {
                 // Start new block and add first byte to it
                 block_list.push_back(ByteVector());
                 current_block = &block_list.back();
-                current_block->push_back(data_byte);
-            }
-            else
-            {
-                // Add byte to current block
-                current_block->push_back(data_byte);
+                if(parity_error_list != nullptr)
+                    parity_error_list->push_back(ByteVector());
             }
+
+            // Add byte to current block
+            current_block->push_back(data_byte);
+            if(parity_error_list != nullptr)
+                parity_error_list->back().push_back(parity_error ? 1 : 0);
         }
-        else
+
+        if(error)
         {
-            if(pos < size)
+            if(!feed.IsEnd())
             {
                 ret = false;
-                printf("Error reading byte at position %4.4x\n",pos);
+                DecoderPrint("Error reading byte at position %4.4x\n",feed.GetPosition());
             }
             else
             {
-                printf("End of TAP file reached.\n");
+                DecoderPrint("End of TAP file reached.\n");
             }
         }  
     }
 
-    printf("Block Count: %ld\n", block_list.size());
+    DecoderPrint("Block Count: %ld\n", block_list.size());
 
     // CRC Checking
     for(int i=0; i < (int)block_list.size(); i++)
     {
-        printf("Block %d Size: %ld [CRC: ", i, block_list[i].size());
+        DecoderPrint("Block %d Size: %ld [CRC: ", i, block_list[i].size());
+
+        // Checksum and countdown need a complete block
+        if(block_list[i].size() < KERNAL_BLOCK_MIN_SIZE)
+        {
+            ret = false;
+            DecoderPrint("Error] - [Countdown: Error] Block is too short\n");
+            continue;
+        }
+
         uint8_t crc = 0;
         for(int j=9; j < (int)block_list[i].size()-1; j++)
         {
@@ -431,12 +604,12 @@ bool FindAllKernalBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block
         }
         if(crc == block_list[i].back())
         {
-            printf("OK]");
+            DecoderPrint("OK]");
         }
         else
         {
             ret = false;
-            printf("Error]");
+            DecoderPrint("Error]");
         }
     
 
@@ -455,378 +628,2331 @@ bool FindAllKernalBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block
             countdown--;
         }
 
-        printf(" - [Countdown: ");
+        DecoderPrint(" - [Countdown: ");
         
         if(countdown_io)
-            printf("OK]\n");
+            DecoderPrint("OK]\n");
         else
         {
             ret = false;
-            printf("Error]\n");
+            DecoderPrint("Error]\n");
         }
     }
 
     return ret;
 }
 
-/// @brief  Analyze the TAP file and find all kernal blocks
-/// @param tap_file  Path to the TAP file
-/// @note   The TAP file must be in binary format
-///         and must start with the string "C64-TAPE-RAW".
-///         The version number must be present.
-///         The function will read the TAP file and find all kernal blocks.
-void AnalyzeTAPFile(const char *tap_file)
+// Turbo tape format
+// Pilot (TURBO_PILOT_BYTE), sync byte, header (start address, end address,
+// filename 16 characters), data, checksum (XOR over the data).
+// Every bit is one pulse, the bytes are written MSB first.
+#define TURBO_PILOT_BYTE 0x02
+#define TURBO_SYNC_BYTE 0x09
+#define TURBO_HEADER_SIZE 20
+#define TURBO_MIN_PILOT_BYTES 16    // Pilot bytes needed by the decoder
+
+/// @brief  Get the next bit of a turbo block
+/// @param feed  Pulse feed of the TAP file
+/// @param bit  Bit of the pulse
+/// @return  False if the pulse is no turbo pulse or the end of the TAP data is reached
+bool GetNextTurboBit(TAPPulseFeedClass &feed, uint8_t &bit)
 {
-    std::ifstream tap_file_stream(tap_file, ios::binary);
-    if(tap_file_stream.is_open())
-    {
-        tap_file_stream.seekg(0, ios::end);
-        streamoff file_size = tap_file_stream.tellg();
-        tap_file_stream.seekg(0, ios::beg);
+    if(feed.IsEnd())
+        return false;
 
-        uint8_t *tap_data = new uint8_t[file_size];
-        tap_file_stream.read((char*)tap_data, file_size);
-        tap_file_stream.close();
+    uint32_t pulse_length = feed.GetNextPulse();
 
-        printf("TAP file size: %ld\n", static_cast<long>(file_size));
-        
-        if(IsTAPFile(tap_data, (uint32_t)file_size))
-        {
-            printf("TAP file is valid.\n");
-            printf("TAP version: %d\n",tap_version);
-            if(FindAllKernalBlocks(tap_data, (uint32_t)file_size, current_block_list))
-            {
-                for(int i=0; i < (int)current_block_list.size(); i++)
-                {
-                    KERNAL_HEADER_BLOCK *kernal_header_block = (KERNAL_HEADER_BLOCK *)&current_block_list[i][9];
-                    if(current_block_list[i].size() == 202 && (kernal_header_block->header_type >= 0x01) && (kernal_header_block->header_type <= 0x05))
-                    {
-                        printf("Block %d: Kernal Header Block", i);
-                        if((current_block_list[i][0] & 0x80) != 0x80)
-                        {
-                            printf(" [BACKUP]\n");
-                        }
-                        else
-                        {
-                            printf("\n");
-                        }
-                        printf("Start Address: %4.4x\n", kernal_header_block->start_address_low | (kernal_header_block->start_address_high << 8));
-                        printf("End Address: %4.4x\n", kernal_header_block->end_address_low | (kernal_header_block->end_address_high << 8));
-                        for(int j=15; j>0; j--)
-                        {
-                            if(kernal_header_block->filename_dispayed[j] == 0x20)
-                            {
-                                kernal_header_block->filename_dispayed[j] = 0;
-                            }
-                            else
-                            {
-                                break;
-                            }
-                        }
-                        kernal_header_block->filename_dispayed[15] = 0;
-                        printf("Filename: %s\n", kernal_header_block->filename_dispayed);
-                        printf("Filename displayed: %s\n", kernal_header_block->filename_dispayed);
-                    }
-                }
-            }
-            else
-            {
-                printf("Error finding kernal blocks.\n");
-            }
-        }
-        else
-        {
-            printf("TAP file is invalid.\n");
-        }
+    if(pulse_length < TURBO_PULSE_MIN || pulse_length > TURBO_PULSE_MAX)
+        return false;
 
-        delete[] tap_data;
-    }
-    else
-    {
-        printf("Error opening TAP file: %s\n",tap_file);
-    }
+    bit = pulse_length >= TURBO_PULSE_THRESHOLD ? 1 : 0;
+    return true;
 }
 
-void ExportTAPFile(const char *tap_file)
+/// @brief  Get the next byte of a turbo block (MSB first)
+/// @return  False if a pulse is no turbo pulse or the end of the TAP data is reached
+bool GetNextTurboByte(TAPPulseFeedClass &feed, uint8_t &byte)
 {
-    AnalyzeTAPFile(tap_file);
-
-    for(int i=0; i < (int)current_block_list.size(); i++)
+    uint8_t bit;
+    for(int i=0; i<8; i++)
     {
-        KERNAL_HEADER_BLOCK *kernal_header_block = (KERNAL_HEADER_BLOCK *)&current_block_list[i][9];
-        if(current_block_list[i].size() == 202 && (kernal_header_block->header_type >= 0x01) && ((current_block_list[i][0] & 0x80) == 0x80))
+        if(!GetNextTurboBit(feed, bit))
+            return false;
+        byte = static_cast<uint8_t>(byte << 1 | bit);
+    }
+    return true;
+}
+
+/// @brief  Find all turbo blocks in the TAP data
+/// @param data  Pointer to the TAP file data
+/// @param size  Size of the TAP file data
+/// @param block_list  Found blocks (header + data + checksum)
+/// @return  True if all blocks are complete and have a correct checksum
+/// @note   Works like the loader, the bits are synchronised on the pilot byte.
+bool FindAllTurboBlocks(uint8_t *data, uint32_t size, vector<ByteVector> &block_list)
+{
+    uint8_t shift_register = 0;
+    bool ret = true;
+
+    block_list.clear();
+
+    TAPPulseFeedClass feed;
+    if(!feed.Open(data, size))
+        return false;
+
+    while(!feed.IsEnd())
+    {
+        uint8_t bit;
+        if(!GetNextTurboBit(feed, bit))
+        {
+            shift_register = 0;
+            continue;
+        }
+
+        shift_register = static_cast<uint8_t>(shift_register << 1 | bit);
+        if(shift_register != TURBO_PILOT_BYTE)
+            continue;
+
+        // Byte synchronised, skip the pilot
+        uint32_t pilot_start = feed.GetPosition();
+        uint32_t pilot_bytes = 1;
+        uint8_t byte = 0;
+        bool valid;
+        while((valid = GetNextTurboByte(feed, byte)) && byte == TURBO_PILOT_BYTE)
+            pilot_bytes++;
+
+        shift_register = valid ? byte : 0;
+        if(!valid || byte != TURBO_SYNC_BYTE || pilot_bytes < TURBO_MIN_PILOT_BYTES)
+            continue;
+
+        DecoderPrint("Turbo pilot found: %4.4x (%u bytes)\n", pilot_start, pilot_bytes);
+
+        // Header
+        ByteVector block;
+        while(block.size() < TURBO_HEADER_SIZE && GetNextTurboByte(feed, byte))
+            block.push_back(byte);
+
+        uint16_t start_address = block.size() == TURBO_HEADER_SIZE ? static_cast<uint16_t>(block[0] | block[1] << 8) : 0;
+        uint16_t end_address = block.size() == TURBO_HEADER_SIZE ? static_cast<uint16_t>(block[2] | block[3] << 8) : 0;
+        if(end_address <= start_address)
+        {
+            ret = false;
+            DecoderPrint("Invalid turbo header at position %4.4x\n", feed.GetPosition());
+            shift_register = 0;
+            continue;
+        }
+
+        // Data and checksum
+        size_t block_size = TURBO_HEADER_SIZE + (end_address - start_address) + 1;
+        while(block.size() < block_size && GetNextTurboByte(feed, byte))
+            block.push_back(byte);
+
+        shift_register = 0;
+        if(block.size() < block_size)
+        {
+            ret = false;
+            DecoderPrint("Turbo block incomplete at position %4.4x\n", feed.GetPosition());
+            continue;
+        }
+
+        block_list.push_back(block);
+    }
+
+    if(block_list.size() > 0)
+        DecoderPrint("Turbo Block Count: %ld\n", block_list.size());
+
+    for(int i=0; i < (int)block_list.size(); i++)
+    {
+        const ByteVector &block = block_list[i];
+        uint8_t crc = 0;
+        for(size_t j=TURBO_HEADER_SIZE; j<block.size(); j++)
+            crc ^= block[j];
+
+        DecoderPrint("Turbo Block %d: %4.4x - %4.4x Filename: %s [CRC: %s]\n", i, block[0] | block[1] << 8, block[2] | block[3] << 8,
+                     GetTurboFilename(block).c_str(), crc == 0 ? "OK" : "Error");
+        if(crc != 0)
+            ret = false;
+    }
+
+    return ret;
+}
+
+/// @brief  Analyze the TAP file and find all kernal blocks
+/// @param tap_file  Path to the TAP file
+/// @note   The TAP file must be in binary format
+///         and must start with the string "C64-TAPE-RAW".
+///         The version number must be present.
+///         The function will read the TAP file and find all kernal blocks.
+void AnalyzeTAPFile(const char *tap_file)
+{
+    ByteVector tap_image;
+    uint32_t file_size;
+    const char *source_format;
+    if(LoadTAPImage(tap_file, tap_image, file_size, &source_format))
+    {
+        uint8_t *tap_data = tap_image.data();
+
+        if(source_format != nullptr)
+            printf("%s file converted to TAP.\n", source_format);
+        printf("TAP file size: %ld\n", static_cast<long>(file_size));
+        
+        if(file_size >= TAP_DATA_START && IsTAPFile(tap_data, file_size))
         {
-            kernal_header_block->filename_dispayed[15] = 0;
-            printf("Exporting Block %d: %s\n", i, kernal_header_block->filename_dispayed);
-            std::ofstream prg_file(kernal_header_block->filename_dispayed + std::string(".prg"), ios::binary);
-            if(prg_file.is_open())
+            printf("TAP file is valid.\n");
+            printf("TAP version: %d\n",tap_version);
+            if(FindAllKernalBlocks(tap_data, (uint32_t)file_size, current_block_list, &current_parity_error_list))
             {
-                prg_file.write((const char*)&kernal_header_block->start_address_low, 1);
-                prg_file.write((const char*)&kernal_header_block->start_address_high, 1);
-                prg_file.write((char*)&current_block_list[i+2][9], current_block_list[i+2].size()-9);
-                prg_file.close();
+                for(int i=0; i < (int)current_block_list.size(); i++)
+                {
+                    if(IsKernalHeaderBlock(current_block_list[i]))
+                    {
+                        KERNAL_HEADER_BLOCK *kernal_header_block = (KERNAL_HEADER_BLOCK *)&current_block_list[i][9];
+                        printf("Block %d: Kernal Header Block", i);
+                        if((current_block_list[i][0] & 0x80) != 0x80)
+                        {
+                            printf(" [BACKUP]\n");
+                        }
+                        else
+                        {
+                            printf("\n");
+                        }
+                        printf("Start Address: %4.4x\n", kernal_header_block->start_address_low | (kernal_header_block->start_address_high << 8));
+                        printf("End Address: %4.4x\n", kernal_header_block->end_address_low | (kernal_header_block->end_address_high << 8));
+                        printf("Filename: %s\n", GetKernalFilename(current_block_list[i]).c_str());
+                        printf("Filename displayed: %s\n", GetKernalFilename(current_block_list[i]).c_str());
+                    }
+                }
             }
             else
             {
-                printf("Error opening PRG file: %s\n",kernal_header_block->filename_dispayed);
+                printf("Error finding kernal blocks.\n");
             }
+
+            FindAllTurboBlocks(tap_data, file_size, current_turbo_block_list);
+        }
+        else
+        {
+            printf("TAP file is invalid.\n");
         }
     }
+    else
+    {
+        printf("Error opening TAP file: %s\n",tap_file);
+    }
 }
 
-inline uint32_t WriteTAPShortPulse(std::ofstream &tap_stream, uint32_t pulse_count) 
+// TAP Diff
+// Every 2^n pulses the file position is stored (to find the position of a pulse quickly)
+#define DIFF_CHECKPOINT_SHIFT 12
+// Maximum shift (in pulses) which is checked for a local resynchronization
+#define DIFF_MAX_LOCAL_SHIFT 8
+// Number of pulses that must be equal after a resynchronization
+#define DIFF_RESYNC_PULSES 64
+// Maximum number of differences that are printed
+#define DIFF_MAX_REPORTED_REGIONS 256
+
+/// @brief  Pulse stream of a TAP file, used to compare two TAP files
+struct TAP_PULSE_STREAM
+{
+    ByteVector tap_data;                // Complete TAP file (with 4 padding bytes)
+    uint32_t file_size;                 // Size of the TAP file
+    uint8_t version;                    // TAP version
+    ByteVector pulses;                  // Type of every pulse (PULSE_TYPE)
+    vector<uint32_t> checkpoints;       // File position of every 2^DIFF_CHECKPOINT_SHIFT pulse
+    vector<uint32_t> leader_ends;       // Index of the first pulse behind every sync leader
+};
+
+/// @brief  Load a TAP file and classify all pulses
+/// @param tap_file  Path to the TAP file
+/// @param stream  Pulse stream that is filled
+/// @return  True if the TAP file could be loaded, false otherwise
+bool LoadTAPPulseStream(const char *tap_file, TAP_PULSE_STREAM &stream)
 {
-    uint8_t short_pulse_len = SHORT_PULSE_LENGTH >> 3;
-    for (uint32_t pulse = 0; pulse < pulse_count; ++pulse) 
+    if(!LoadTAPImage(tap_file, stream.tap_data, stream.file_size))
     {
-        tap_stream.write(reinterpret_cast<const char*>(&short_pulse_len), 1);
+        printf("Error opening TAP file: %s\n",tap_file);
+        return false;
+    }
+
+    if(stream.file_size < 0x14 || !IsTAPFile(stream.tap_data.data(), stream.file_size))
+    {
+        printf("TAP file is invalid: %s\n",tap_file);
+        return false;
     }
-    return pulse_count;
+    stream.version = tap_version;
+
+    // Classify all pulses
+    TAPPulseFeedClass feed;
+    feed.Open(stream.tap_data.data(), stream.file_size);
+    uint32_t short_pulse_count = 0;
+
+    stream.pulses.clear();
+    stream.pulses.reserve(stream.file_size - 0x14);
+    stream.checkpoints.clear();
+    stream.leader_ends.clear();
+
+    CallWithTimingProfile(timing_profile, [&](auto timing)
+    {
+        typedef decltype(timing) TIMING;
+
+        while(!feed.IsEnd())
+        {
+            if((stream.pulses.size() & ((1 << DIFF_CHECKPOINT_SHIFT) - 1)) == 0)
+                stream.checkpoints.push_back(feed.GetPosition());
+
+            uint8_t pulse_type = GetNextPulse<TIMING>(feed);
+            if(pulse_type == SHORT_PULSE)
+            {
+                short_pulse_count++;
+            }
+            else
+            {
+                if(short_pulse_count >= TAP_MIN_LEADER_PULSES)
+                    stream.leader_ends.push_back(static_cast<uint32_t>(stream.pulses.size()));
+                short_pulse_count = 0;
+            }
+            stream.pulses.push_back(pulse_type);
+        }
+    });
+
+    return true;
+}
+
+/// @brief  Get the file position of a pulse
+/// @param stream  Pulse stream
+/// @param index  Index of the pulse
+/// @return  Position of the pulse in the TAP file
+uint32_t GetPulseFilePosition(const TAP_PULSE_STREAM &stream, uint32_t index)
+{
+    if(index >= stream.pulses.size())
+        return stream.file_size;
+
+    // Start at the last checkpoint and walk to the pulse
+    TAPPulseFeedClass feed;
+    feed.Open(stream.tap_data.data(), stream.file_size);
+    feed.SetPosition(stream.checkpoints[index >> DIFF_CHECKPOINT_SHIFT]);
+
+    for(uint32_t i = index & ~((1u << DIFF_CHECKPOINT_SHIFT) - 1); i < index; i++)
+        feed.GetNextPulse();
+    return feed.GetPosition();
+}
+
+/// @brief  Get the number of the block in which a pulse lies
+/// @param stream  Pulse stream
+/// @param index  Index of the pulse
+/// @return  Block number, -1 if the pulse lies before the first sync leader
+int GetPulseBlockNumber(const TAP_PULSE_STREAM &stream, uint32_t index)
+{
+    return static_cast<int>(std::upper_bound(stream.leader_ends.begin(), stream.leader_ends.end(), index) - stream.leader_ends.begin()) - 1;
 }
 
-inline uint32_t WriteTAPMediumPulse(std::ofstream &tap_stream, uint32_t pulse_count) 
+/// @brief  Find the first pulse that differs between two pulse arrays
+/// @param a  First pulse array
+/// @param b  Second pulse array
+/// @param count  Number of pulses to compare
+/// @return  Index of the first different pulse, count if all pulses are equal
+/// @note   Equal areas are skipped with memcmp in large blocks (vectorized by
+///         the C library) and 8 pulses at once, only the last word is compared
+///         pulse by pulse.
+uint32_t FindPulseMismatch(const uint8_t *a, const uint8_t *b, uint32_t count)
 {
-    uint8_t medium_pulse_len = MEDIUM_PULSE_LENGTH >> 3;
-    for (uint32_t pulse = 0; pulse < pulse_count; ++pulse) 
+    const uint32_t block_size = 4096;
+    uint32_t i = 0;
+
+    while(i + block_size <= count && memcmp(a + i, b + i, block_size) == 0)
+        i += block_size;
+
+    while(i + 8 <= count)
     {
-        tap_stream.write(reinterpret_cast<const char*>(&medium_pulse_len), 1);
+        uint64_t word_a, word_b;
+        memcpy(&word_a, a + i, 8);
+        memcpy(&word_b, b + i, 8);
+        if(word_a != word_b)
+            break;
+        i += 8;
     }
-    return pulse_count;
+
+    while(i < count && a[i] == b[i])
+        i++;
+
+    return i;
+}
+
+/// @brief  Check if two pulse streams are equal at the given positions
+/// @return  True if the next DIFF_RESYNC_PULSES pulses (or all up to the end) are equal
+bool PulsesEqualAt(const TAP_PULSE_STREAM &a, uint32_t pos_a, const TAP_PULSE_STREAM &b, uint32_t pos_b)
+{
+    uint32_t count_a = std::min<uint32_t>(DIFF_RESYNC_PULSES, static_cast<uint32_t>(a.pulses.size()) - pos_a);
+    uint32_t count_b = std::min<uint32_t>(DIFF_RESYNC_PULSES, static_cast<uint32_t>(b.pulses.size()) - pos_b);
+
+    if(count_a != count_b)
+        return false;
+
+    return memcmp(a.pulses.data() + pos_a, b.pulses.data() + pos_b, count_a) == 0;
 }
 
-inline uint32_t WriteTAPLongPulse(std::ofstream &tap_stream, uint32_t pulse_count) 
+/// @brief  Find the positions after a difference where both pulse streams are equal again
+/// @param a  First pulse stream
+/// @param pos_a  Position of the difference in a, will be set to the resync position
+/// @param b  Second pulse stream
+/// @param pos_b  Position of the difference in b, will be set to the resync position
+/// @return  True if a resync position was found, false otherwise
+/// @note   First small substitutions, insertions and deletions are checked,
+///         otherwise both streams are aligned at the end of the next sync leader.
+bool FindPulseResync(const TAP_PULSE_STREAM &a, uint32_t &pos_a, const TAP_PULSE_STREAM &b, uint32_t &pos_b)
 {
-    uint8_t long_pulse_len = LONG_PULSE_LENGTH >> 3;
-    for (uint32_t pulse = 0; pulse < pulse_count; ++pulse) 
+    uint32_t size_a = static_cast<uint32_t>(a.pulses.size());
+    uint32_t size_b = static_cast<uint32_t>(b.pulses.size());
+
+    // Local resync (smallest shift first)
+    for(uint32_t shift = 1; shift <= 2 * DIFF_MAX_LOCAL_SHIFT; shift++)
+    {
+        uint32_t shift_a_min = shift > DIFF_MAX_LOCAL_SHIFT ? shift - DIFF_MAX_LOCAL_SHIFT : 0;
+        uint32_t shift_a_max = std::min<uint32_t>(shift, DIFF_MAX_LOCAL_SHIFT);
+        for(uint32_t shift_a = shift_a_min; shift_a <= shift_a_max; shift_a++)
+        {
+            uint32_t shift_b = shift - shift_a;
+            if(pos_a + shift_a > size_a || pos_b + shift_b > size_b)
+                continue;
+            if(PulsesEqualAt(a, pos_a + shift_a, b, pos_b + shift_b))
+            {
+                pos_a += shift_a;
+                pos_b += shift_b;
+                return true;
+            }
+        }
+    }
+
+    // Resync at the end of the current or next sync leader
+    vector<uint32_t>::const_iterator leader_a = std::lower_bound(a.leader_ends.begin(), a.leader_ends.end(), pos_a);
+    vector<uint32_t>::const_iterator leader_b = std::lower_bound(b.leader_ends.begin(), b.leader_ends.end(), pos_b);
+
+    // Both at the end of a leader, but the pulses behind differ
+    if(leader_a != a.leader_ends.end() && leader_b != b.leader_ends.end() && *leader_a == pos_a && *leader_b == pos_b)
     {
-        tap_stream.write(reinterpret_cast<const char*>(&long_pulse_len), 1);
+        leader_a++;
+        leader_b++;
     }
-    return pulse_count;
+
+    if(leader_a == a.leader_ends.end() || leader_b == b.leader_ends.end())
+        return false;
+
+    pos_a = *leader_a;
+    pos_b = *leader_b;
+    return true;
 }
 
-inline uint32_t WriteTAPByte(std::ofstream &tap_stream, uint8_t byte) 
+/// @brief  Format the block number of a pulse
+void FormatPulseBlock(const TAP_PULSE_STREAM &stream, uint32_t index, char *str, size_t str_size)
 {
-    uint32_t num_samples = 0;
+    if(index >= stream.pulses.size())
+        snprintf(str, str_size, "end of file");
+    else if(GetPulseBlockNumber(stream, index) < 0)
+        snprintf(str, str_size, "before first block");
+    else
+        snprintf(str, str_size, "block %d", GetPulseBlockNumber(stream, index));
+}
 
-    // Write the byte in the TAP file
-    // ByteMaker (Long Pulse + Medium Pulse)
-    num_samples += WriteTAPLongPulse(tap_stream, 1);
-    num_samples += WriteTAPMediumPulse(tap_stream, 1);
+/// @brief  Compare the pulses and the decoded kernal blocks of two TAP files
+/// @param tap_file_a  Path to the first TAP file
+/// @param tap_file_b  Path to the second TAP file
+void DiffTAPFiles(const char *tap_file_a, const char *tap_file_b)
+{
+    TAP_PULSE_STREAM stream_a, stream_b;
+
+    if(!LoadTAPPulseStream(tap_file_a, stream_a) || !LoadTAPPulseStream(tap_file_b, stream_b))
+        return;
+
+    uint32_t size_a = static_cast<uint32_t>(stream_a.pulses.size());
+    uint32_t size_b = static_cast<uint32_t>(stream_b.pulses.size());
+
+    printf("A: TAP version %d, %u pulses, %zu sync leaders\n", stream_a.version, size_a, stream_a.leader_ends.size());
+    printf("B: TAP version %d, %u pulses, %zu sync leaders\n", stream_b.version, size_b, stream_b.leader_ends.size());
 
-    // Write the bits of the byte (LSB first)
-    uint8_t parity_bit = 1;
-    for (int i = 0; i < 8; ++i)     
+    // Compare the pulse streams
+    uint32_t pos_a = 0, pos_b = 0;
+    int region_count = 0;
+
+    while(pos_a < size_a || pos_b < size_b)
     {
-        if (byte & (1 << i)) 
+        uint32_t equal_count = FindPulseMismatch(stream_a.pulses.data() + pos_a, stream_b.pulses.data() + pos_b, std::min(size_a - pos_a, size_b - pos_b));
+        pos_a += equal_count;
+        pos_b += equal_count;
+
+        if(pos_a >= size_a && pos_b >= size_b)
+            break;
+
+        uint32_t resync_a = pos_a, resync_b = pos_b;
+        if(pos_a >= size_a || pos_b >= size_b || !FindPulseResync(stream_a, resync_a, stream_b, resync_b))
         {
-            // Bit is 1
-            num_samples += WriteTAPMediumPulse(tap_stream, 1);
-            num_samples += WriteTAPShortPulse(tap_stream, 1);
-            parity_bit ^= 1;
-        } else 
+            // No resync possible, the difference reaches to the end
+            resync_a = size_a;
+            resync_b = size_b;
+        }
+
+        if(region_count < DIFF_MAX_REPORTED_REGIONS)
         {
-            // Bit is 0
-            num_samples += WriteTAPShortPulse(tap_stream, 1);
-            num_samples += WriteTAPMediumPulse(tap_stream, 1);
+            char block_a[32], block_b[32];
+            FormatPulseBlock(stream_a, pos_a, block_a, sizeof(block_a));
+            FormatPulseBlock(stream_b, pos_b, block_b, sizeof(block_b));
+            printf("Difference %d:\n", region_count + 1);
+            printf("  A: %8.8x - %8.8x (%u pulses, %s)\n", GetPulseFilePosition(stream_a, pos_a), GetPulseFilePosition(stream_a, resync_a), resync_a - pos_a, block_a);
+            printf("  B: %8.8x - %8.8x (%u pulses, %s)\n", GetPulseFilePosition(stream_b, pos_b), GetPulseFilePosition(stream_b, resync_b), resync_b - pos_b, block_b);
         }
+        region_count++;
+
+        pos_a = resync_a;
+        pos_b = resync_b;
     }
-    // Write the parity bit (odd parity)
-    if (parity_bit == 1) 
+
+    if(region_count == 0)
+        printf("The pulses of both TAP files are equal.\n");
+    else
+        printf("Different pulse regions: %d\n", region_count);
+
+    // Compare the decoded kernal blocks, the messages of the decoder are not part of the report
+    vector<ByteVector> block_list_a, block_list_b;
+    bool old_decoder_messages = decoder_messages;
+    decoder_messages = false;
+    tap_version = stream_a.version;
+    FindAllKernalBlocks(stream_a.tap_data.data(), stream_a.file_size, block_list_a);
+    tap_version = stream_b.version;
+    FindAllKernalBlocks(stream_b.tap_data.data(), stream_b.file_size, block_list_b);
+    decoder_messages = old_decoder_messages;
+
+    int different_blocks = 0;
+    size_t block_count = std::max(block_list_a.size(), block_list_b.size());
+    for(size_t i=0; i<block_count; i++)
     {
-        num_samples += WriteTAPMediumPulse(tap_stream, 1);
-        num_samples += WriteTAPShortPulse(tap_stream, 1);
-    } else 
+        if(i >= block_list_a.size() || i >= block_list_b.size())
+        {
+            printf("Block %zu: only in %s\n", i, i < block_list_a.size() ? "A" : "B");
+            different_blocks++;
+            continue;
+        }
+
+        const ByteVector &block_a = block_list_a[i];
+        const ByteVector &block_b = block_list_b[i];
+        size_t compare_size = std::min(block_a.size(), block_b.size());
+        size_t first_diff = FindPulseMismatch(block_a.data(), block_b.data(), static_cast<uint32_t>(compare_size));
+
+        if(first_diff < compare_size || block_a.size() != block_b.size())
+        {
+            printf("Block %zu: decoded bytes differ at byte %zu (size A: %zu, size B: %zu)\n", i, first_diff, block_a.size(), block_b.size());
+            different_blocks++;
+        }
+    }
+
+    if(different_blocks == 0)
+        printf("The decoded blocks of both TAP files are equal.\n");
+    else
+        printf("Different decoded blocks: %d\n", different_blocks);
+}
+
+/// @brief  Format a cycle position as time (mm:ss.sss)
+void FormatTapeTime(uint64_t cycles, char *str, size_t str_size)
+{
+    double seconds = static_cast<double>(cycles) / GetTimingCyclesPerSecond(timing_profile);
+    unsigned int minutes = static_cast<unsigned int>(seconds / 60);
+    snprintf(str, str_size, "%02u:%06.3f", minutes, seconds - minutes * 60.0);
+}
+
+/// @brief  Parse a time position (hh:mm:ss.sss, mm:ss.sss or ss.sss)
+/// @param str  Time as string
+/// @param seconds  Parsed time in seconds
+/// @return  True if the time could be parsed, false otherwise
+bool ParseTapeTime(const char *str, double &seconds)
+{
+    seconds = 0;
+    int part_count = 0;
+
+    while(*str != 0)
     {
-        num_samples += WriteTAPShortPulse(tap_stream, 1);
-        num_samples += WriteTAPMediumPulse(tap_stream, 1);
+        char *end;
+        double value = strtod(str, &end);
+        if(end == str || value < 0 || ++part_count > 3)
+            return false;
+
+        seconds = seconds * 60 + value;
+
+        if(*end == ':')
+            str = end + 1;
+        else if(*end == 0)
+            str = end;
+        else
+            return false;
     }
 
-    return num_samples;
+    return part_count > 0;
 }
 
-bool ConvertPRGToTAP(const char *prg_file_name, const char *tap_file_name)
+/// @brief  Find the file position of a time or block in a TAP file
+/// @param tap_file  Path to the TAP file
+/// @param position  Time (hh:mm:ss, mm:ss or seconds) or block (block:<n>)
+void SeekTAPFile(const char *tap_file, const char *position)
 {
-    // TODO: Implement the conversion from PRG to TAP
-    // TAP write 
-    // C64 PAL Frquency: 985248 Hz
-    // ● a short 365.4µs pulse (2737 Hz) PAL - 360 Takte    
-    // ● a medium 531.4µs pulse (1882Hz) PAL - 524 Takte
-    // ● a long 697.6µs pulse (1434 Hz) PAL - 687 Takte
+    ByteVector tap_data;
+    uint32_t file_size;
+    if(!LoadTAPImage(tap_file, tap_data, file_size))
+    {
+        printf("Error opening TAP file: %s\n",tap_file);
+        return;
+    }
 
-    // 1. Short pulse (27135)
-    // 2. Countdown Sequence 0x89 0x88 0x87 0x86 0x85 0x84 0x83 0x82 0x81
-    // 3. Kernal Header Block
-    // 3a. EndOfData Maker
-    // 4. Short pulse (79)
-    // 5. Countdown Sequence 0x09 0x08 0x07 0x06 0x05 0x04 0x03 0x02 0x01
-    // 6. Kernal Header Block (Backup)
-    // 7. Short pulse (5671)
-    // 9. Countdown Sequence 0x89 0x88 0x87 0x86 0x85 0x84 0x83 0x82 0x81
-    // 10. Kernal Data Block
-    // 10a. EndOfData Maker
-    // 11. Short pulse (79)
-    // 12. Countdown Sequence 0x09 0x08 0x07 0x06 0x05 0x04 0x03 0x02 0x01
-    // 13. Kernal Data Block (Backup)
+    TAPCycleIndexClass tap_index;
+    if(!tap_index.Create(tap_data.data(), file_size, timing_profile))
+    {
+        printf("TAP file is invalid.\n");
+        return;
+    }
 
-    ifstream prg_stream;
-    ofstream tap_stream;
-    prg_stream.open(prg_file_name, ios::binary);
-    if(!prg_stream.is_open())
+    char time_str[32];
+    FormatTapeTime(tap_index.GetTotalCycles(), time_str, sizeof(time_str));
+    printf("TAP length: %s (%" PRIu64 " cycles, %u pulses, %d blocks)\n", time_str, tap_index.GetTotalCycles(), tap_index.GetPulseCount(), tap_index.GetBlockCount());
+
+    TAP_INDEX_ENTRY entry;
+    if(strncmp(position, "block:", 6) == 0)
     {
-        printf("Error opening PRG file: %s\n", prg_file_name);
+        char *end;
+        int block = static_cast<int>(strtol(position + 6, &end, 10));
+        if(end == position + 6 || *end != 0 || !tap_index.GetBlockStart(block, entry))
+        {
+            printf("Block not found: %s\n", position + 6);
+            return;
+        }
+    }
+    else
+    {
+        double seconds;
+        if(!ParseTapeTime(position, seconds))
+        {
+            printf("Invalid position: %s\n", position);
+            return;
+        }
+        entry = tap_index.FindTime(seconds, GetTimingCyclesPerSecond(timing_profile));
+    }
+
+    FormatTapeTime(entry.cycle, time_str, sizeof(time_str));
+    printf("Position: %8.8x (pulse %u, cycle %" PRIu64 ", time %s, block %d)\n", entry.pos, entry.pulse, entry.cycle, time_str, tap_index.FindBlock(entry.cycle));
+}
+
+// Best-of-N Merge
+
+/// @brief  Kernal blocks of one dump of a tape
+struct TAP_DUMP
+{
+    const char *tap_file;
+    bool valid;
+    vector<ByteVector> block_list;
+    vector<ByteVector> parity_error_list;
+};
+
+/// @brief  Copy of a kernal block with the parity errors of its bytes
+struct KERNAL_BLOCK_COPY
+{
+    const ByteVector *block;
+    const ByteVector *parity_errors;
+};
+
+/// @brief  All copies of the header and data block of a kernal file
+struct KERNAL_FILE_COPIES
+{
+    ByteVector header_key;                      // Header type, addresses and displayed filename
+    vector<KERNAL_BLOCK_COPY> header_copies;
+    vector<KERNAL_BLOCK_COPY> data_copies;
+};
+
+/// @brief  Load a TAP file and find all kernal blocks with the parity errors of all bytes
+/// @param dump  Dump with the path of the TAP file, the blocks are filled in
+/// @note   Runs in its own thread, therefore the decoder prints no messages.
+void DecodeTAPDump(TAP_DUMP *dump)
+{
+    decoder_messages = false;
+    dump->valid = false;
+
+    ByteVector tap_data;
+    uint32_t file_size;
+    if(!LoadTAPImage(dump->tap_file, tap_data, file_size))
+        return;
+
+    if(file_size < 0x14 || !IsTAPFile(tap_data.data(), file_size))
+        return;
+
+    FindAllKernalBlocks(tap_data.data(), file_size, dump->block_list, &dump->parity_error_list);
+    dump->valid = true;
+}
+
+/// @brief  Check the checksum of a kernal block
+/// @param block  Kernal block (countdown + data + checksum)
+/// @return  True if the checksum is correct
+bool CheckKernalBlockChecksum(const ByteVector &block)
+{
+    if(block.size() < 11)
         return false;
+
+    uint8_t crc = 0;
+    for(size_t i=9; i < block.size()-1; i++)
+    {
+        crc ^= block[i];
     }
+    return crc == block.back();
+}
 
-    // PRG file size    
-    prg_stream.seekg(0, ios::end);
-    streamoff prg_file_size = prg_stream.tellg();
-    prg_stream.seekg(0, ios::beg);
+/// @brief  Check if a kernal block is a header block
+bool IsKernalHeaderBlock(const ByteVector &block)
+{
+    return block.size() == 202 && block[9] >= 0x01 && block[9] <= 0x05;
+}
 
-    tap_stream.open(tap_file_name, ios::binary);
-    if(!tap_stream.is_open())
+/// @brief  Find the most frequent value of a byte in all copies of a block
+/// @param copies  Copies of the block
+/// @param index  Index of the byte
+/// @param only_parity_ok  True: only copies without parity error for this byte are used
+/// @param byte  Most frequent value (the first copy wins on a tie)
+/// @return  True if a value was found
+bool VoteKernalByte(const vector<KERNAL_BLOCK_COPY> &copies, size_t index, bool only_parity_ok, uint8_t &byte)
+{
+    uint32_t best_votes = 0;
+
+    for(size_t i=0; i<copies.size(); i++)
     {
-        printf("Error opening TAP file: %s\n", tap_file_name);
-        prg_stream.close();
-        return false;
+        if(only_parity_ok && (*copies[i].parity_errors)[index])
+            continue;
+
+        uint8_t value = (*copies[i].block)[index];
+        uint32_t votes = 0;
+        for(size_t j=0; j<copies.size(); j++)
+        {
+            if(only_parity_ok && (*copies[j].parity_errors)[index])
+                continue;
+            if((*copies[j].block)[index] == value)
+                votes++;
+        }
+
+        if(votes > best_votes)
+        {
+            best_votes = votes;
+            byte = value;
+        }
     }
 
-    // TAP Header
-    tap_stream.write("C64-TAPE-RAW", 12); // TAP Header
-    tap_stream.write(reinterpret_cast<const char*>(&tap_version), 1); // TAP Version
-    uint8_t tap_header[3] = {0x00, 0x00, 0x00}; // TAP Header (Future expanison)
-    tap_stream.write(reinterpret_cast<const char*>(tap_header), sizeof(tap_header));
-    uint32_t tap_data_size = 0; // TAP Data Size
-    tap_stream.write(reinterpret_cast<const char*>(&tap_data_size), 4); // TAP Data Size
+    return best_votes > 0;
+}
+
+/// @brief  Merge several copies of a kernal block byte by byte
+/// @param copies  Copies of the block, copies shorter than block_size are not used
+/// @param block_size  Size of the block (countdown + data + checksum)
+/// @param merged_block  Merged block
+/// @param unsure_bytes  Number of bytes which have a parity error in all copies
+/// @return  True if the checksum of the merged block is correct
+/// @note   Every byte is taken from the majority of the copies without parity
+///         error. If all copies have a parity error, the majority of all is used.
+bool MergeKernalBlockCopies(const vector<KERNAL_BLOCK_COPY> &copies, size_t block_size, ByteVector &merged_block, uint32_t &unsure_bytes)
+{
+    vector<KERNAL_BLOCK_COPY> usable_copies;
+    for(size_t i=0; i<copies.size(); i++)
+    {
+        if(copies[i].block->size() >= block_size)
+            usable_copies.push_back(copies[i]);
+    }
+
+    merged_block.assign(block_size, 0);
+    unsure_bytes = 0;
+
+    if(usable_copies.empty())
+        return false;
+
+    for(size_t i=0; i<block_size; i++)
+    {
+        if(!VoteKernalByte(usable_copies, i, true, merged_block[i]))
+        {
+            VoteKernalByte(usable_copies, i, false, merged_block[i]);
+            unsure_bytes++;
+        }
+    }
+
+    return CheckKernalBlockChecksum(merged_block);
+}
+
+/// @brief  Check if a block has at least one copy which is not too short
+/// @param copies  Copies of the block
+/// @param block_size  Size of the block (countdown + data + checksum)
+bool HasUsableKernalBlockCopy(const vector<KERNAL_BLOCK_COPY> &copies, size_t block_size)
+{
+    for(size_t i=0; i<copies.size(); i++)
+    {
+        if(copies[i].block->size() >= block_size)
+            return true;
+    }
+    return false;
+}
+
+/// @brief  Get the displayed filename of a kernal header without trailing spaces
+std::string GetKernalFilename(const ByteVector &header_block)
+{
+    const KERNAL_HEADER_BLOCK *kernal_header_block = (const KERNAL_HEADER_BLOCK *)&header_block[9];
+    std::string filename(kernal_header_block->filename_dispayed, sizeof(kernal_header_block->filename_dispayed));
+
+    size_t end = filename.find_last_not_of(' ');
+    filename.erase(end == std::string::npos ? 0 : end + 1);
+    return filename;
+}
+
+/// @brief  Group the kernal blocks of a tape into files
+/// @param block_list  Kernal blocks of the tape
+/// @param parity_error_list  Parity errors of all bytes in the blocks
+/// @param file_list  List of files (header and data copies) in the order of the tape
+void GroupKernalFiles(const vector<ByteVector> &block_list, const vector<ByteVector> &parity_error_list, vector<KERNAL_FILE_COPIES> &file_list)
+{
+    file_list.clear();
+
+    for(size_t i=0; i<block_list.size(); i++)
+    {
+        const ByteVector &block = block_list[i];
+        if(block.size() < KERNAL_BLOCK_MIN_SIZE)
+            continue;
+
+        KERNAL_BLOCK_COPY copy = {&block, &parity_error_list[i]};
+        KERNAL_FILE_COPIES *current_file = file_list.empty() ? nullptr : &file_list.back();
+
+        // A program header is followed by its data blocks, even if they look like a header
+        bool expect_data = current_file != nullptr && current_file->data_copies.empty() &&
+                           (current_file->header_key[0] == 0x01 || current_file->header_key[0] == 0x03);
+        bool backup = (block[0] & 0x80) != 0x80;
+
+        if(IsKernalHeaderBlock(block) && (!expect_data || (backup && current_file->header_copies.size() == 1)))
+        {
+            if(current_file == nullptr || !backup || !current_file->data_copies.empty())
+            {
+                file_list.push_back(KERNAL_FILE_COPIES());
+                current_file = &file_list.back();
+            }
+            current_file->header_copies.push_back(copy);
+
+            // The key is taken from the merged header copies of this dump
+            ByteVector header;
+            uint32_t unsure_bytes;
+            MergeKernalBlockCopies(current_file->header_copies, 202, header, unsure_bytes);
+            current_file->header_key.assign(header.begin() + 9, header.begin() + 9 + 21);
+        }
+        else if(current_file != nullptr)
+        {
+            current_file->data_copies.push_back(copy);
+        }
+    }
+}
+
+/// @brief  Get the name of a PRG file which is not used by an earlier file of the export
+/// @param filename  Displayed filename of the file
+/// @param file_number  Number of the file on the tape, it is appended if the name is already used
+/// @param prg_names  Names of the PRG files written by the export, the new name is added
+/// @return  Name of the PRG file
+std::string GetUniquePRGFileName(const std::string &filename, int file_number, vector<std::string> &prg_names)
+{
+    std::string prg_name = filename + ".prg";
+    if(std::find(prg_names.begin(), prg_names.end(), prg_name) != prg_names.end())
+        prg_name = filename + "_" + std::to_string(file_number) + ".prg";
+
+    prg_names.push_back(prg_name);
+    return prg_name;
+}
+
+/// @brief  Write a PRG file with the writer thread
+/// @param prg_name  Path to the PRG file
+/// @param start_address  Start address (low and high byte), the first two bytes of the file
+/// @param data  Content of the file behind the start address
+/// @param size  Size of the content
+/// @return  True if the PRG file was written
+bool WritePRGFile(const std::string &prg_name, const uint8_t start_address[2], const uint8_t *data, size_t size)
+{
+    AsyncWriterClass writer;
+    if(!writer.Open(prg_name.c_str()))
+    {
+        printf("Error opening PRG file: %s\n", prg_name.c_str());
+        return false;
+    }
+
+    // Start address and content are copied once into a buffer of the ring
+    ByteVector &buffer = writer.GetBuffer();
+    buffer.assign(start_address, start_address + 2);
+    buffer.insert(buffer.end(), data, data + size);
+    writer.Submit(buffer, buffer.size());
+
+    if(!writer.Close())
+    {
+        printf("Error writing PRG file: %s\n", prg_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief  Merge all copies of a kernal file and export it as PRG
+/// @param file  Header and data copies of the file
+/// @param file_number  Number of the file on the tape
+/// @param prg_names  Names of the PRG files written by the export, a file with the name of an earlier file gets its number appended
+/// @param export_list  Optional, if given the file is added to this list instead of writing a PRG file
+/// @return  True if the PRG file was written, false otherwise
+bool ExportKernalFile(const KERNAL_FILE_COPIES &file, int file_number, vector<std::string> &prg_names, vector<T64_FILE> *export_list = nullptr)
+{
+    ByteVector header;
+    uint32_t header_unsure_bytes;
+    bool header_ok = MergeKernalBlockCopies(file.header_copies, 202, header, header_unsure_bytes);
+
+    const KERNAL_HEADER_BLOCK *kernal_header_block = (const KERNAL_HEADER_BLOCK *)&header[9];
+    uint16_t start_address = static_cast<uint16_t>(kernal_header_block->start_address_low | (kernal_header_block->start_address_high << 8));
+    uint16_t end_address = static_cast<uint16_t>(kernal_header_block->end_address_low | (kernal_header_block->end_address_high << 8));
+    std::string filename = GetKernalFilename(header);
+
+    printf("File %d: %s (%4.4x - %4.4x) [Header copies: %d, Unsure bytes: %u, CRC: %s]\n", file_number, filename.c_str(), start_address, end_address,
+           static_cast<int>(file.header_copies.size()), header_unsure_bytes, header_ok ? "OK" : "Error");
+
+    if((kernal_header_block->header_type != 0x01 && kernal_header_block->header_type != 0x03) || end_address <= start_address)
+        return false;
+
+    // Without a complete copy of the data block no PRG file is written
+    size_t data_block_size = 9 + (end_address - start_address) + 1;
+    if(!HasUsableKernalBlockCopy(file.data_copies, data_block_size))
+    {
+        printf("  Data [Copies: %d, no complete copy] The file is skipped.\n", static_cast<int>(file.data_copies.size()));
+        return false;
+    }
+
+    ByteVector data;
+    uint32_t data_unsure_bytes;
+    bool data_ok = MergeKernalBlockCopies(file.data_copies, data_block_size, data, data_unsure_bytes);
+
+    printf("  Data [Copies: %d, Unsure bytes: %u, CRC: %s]\n", static_cast<int>(file.data_copies.size()), data_unsure_bytes, data_ok ? "OK" : "Error");
+
+    if(export_list != nullptr)
+    {
+        T64_FILE export_file;
+        export_file.filename = filename;
+        export_file.prg_data.push_back(kernal_header_block->start_address_low);
+        export_file.prg_data.push_back(kernal_header_block->start_address_high);
+        export_file.prg_data.insert(export_file.prg_data.end(), data.begin() + 9, data.end() - 1);
+        export_list->push_back(export_file);
+        return true;
+    }
+
+    const uint8_t prg_start_address[2] = {kernal_header_block->start_address_low, kernal_header_block->start_address_high};
+    return WritePRGFile(GetUniquePRGFileName(filename, file_number, prg_names), prg_start_address, &data[9], data.size() - 10);
+}
+
+/// @brief  Merge several dumps of the same tape and export the repaired files as PRG
+/// @param tap_files  Paths to the TAP files
+/// @note   All TAP files are decoded in parallel. The files are aligned by their
+///         headers, then every byte is taken from the majority of all copies
+///         (both copies in every dump) without parity error.
+void MergeTAPFiles(const vector<const char*> &tap_files)
+{
+    vector<TAP_DUMP> dump_list(tap_files.size());
+    vector<std::thread> threads;
+
+    for(size_t i=0; i<tap_files.size(); i++)
+    {
+        dump_list[i].tap_file = tap_files[i];
+        threads.push_back(std::thread(DecodeTAPDump, &dump_list[i]));
+    }
+    for(size_t i=0; i<threads.size(); i++)
+        threads[i].join();
+
+    // Align the files of all dumps by their headers (in the order of the tape)
+    vector<KERNAL_FILE_COPIES> merge_list;
+    for(size_t i=0; i<dump_list.size(); i++)
+    {
+        if(!dump_list[i].valid)
+        {
+            printf("Error reading TAP file: %s\n", dump_list[i].tap_file);
+            continue;
+        }
+
+        vector<KERNAL_FILE_COPIES> file_list;
+        GroupKernalFiles(dump_list[i].block_list, dump_list[i].parity_error_list, file_list);
+        printf("%s: %d blocks, %d files\n", dump_list[i].tap_file, static_cast<int>(dump_list[i].block_list.size()), static_cast<int>(file_list.size()));
+
+        size_t next = 0;
+        for(size_t j=0; j<file_list.size(); j++)
+        {
+            size_t k = next;
+            while(k < merge_list.size() && merge_list[k].header_key != file_list[j].header_key)
+                k++;
+
+            if(k == merge_list.size())
+            {
+                // Not found, the file is inserted behind the last aligned file
+                k = next;
+                merge_list.insert(merge_list.begin() + static_cast<long>(k), file_list[j]);
+            }
+            else
+            {
+                merge_list[k].header_copies.insert(merge_list[k].header_copies.end(), file_list[j].header_copies.begin(), file_list[j].header_copies.end());
+                merge_list[k].data_copies.insert(merge_list[k].data_copies.end(), file_list[j].data_copies.begin(), file_list[j].data_copies.end());
+            }
+            next = k + 1;
+        }
+    }
+
+    // Merge and export
+    vector<std::string> prg_names;
+    for(size_t i=0; i<merge_list.size(); i++)
+    {
+        ExportKernalFile(merge_list[i], static_cast<int>(i), prg_names);
+    }
+}
+
+/// @brief  Get the filename of a turbo block
+/// @param turbo_block  Turbo block (header + data + checksum)
+/// @return  Filename without trailing spaces
+std::string GetTurboFilename(const ByteVector &turbo_block)
+{
+    std::string filename((const char*)&turbo_block[4], 16);
+
+    size_t end = filename.find_last_not_of(' ');
+    filename.erase(end == std::string::npos ? 0 : end + 1);
+    return filename;
+}
+
+/// @brief  Export a turbo block as PRG
+/// @param turbo_block  Turbo block (header + data + checksum)
+/// @param file_number  Number of the file (for the output)
+/// @param prg_names  Names of the PRG files written by the export, the file replaces the PRG file of its loader
+/// @param export_list  Optional, if given the file replaces its loader in this list (or is added) instead of writing a PRG file
+/// @return  True if the PRG file was written
+bool ExportTurboFile(const ByteVector &turbo_block, int file_number, vector<std::string> &prg_names, vector<T64_FILE> *export_list = nullptr)
+{
+    std::string filename = GetTurboFilename(turbo_block);
+    uint16_t start_address = static_cast<uint16_t>(turbo_block[0] | turbo_block[1] << 8);
+    uint16_t end_address = static_cast<uint16_t>(turbo_block[2] | turbo_block[3] << 8);
+
+    uint8_t crc = 0;
+    for(size_t i=TURBO_HEADER_SIZE; i<turbo_block.size(); i++)
+        crc ^= turbo_block[i];
+
+    printf("Turbo File %d: %s (%4.4x - %4.4x) [CRC: %s]\n", file_number, filename.c_str(), start_address, end_address, crc == 0 ? "OK" : "Error");
+
+    if(export_list != nullptr)
+    {
+        T64_FILE export_file;
+        export_file.filename = filename;
+        export_file.prg_data.assign(turbo_block.begin(), turbo_block.begin() + 2);
+        export_file.prg_data.insert(export_file.prg_data.end(), turbo_block.begin() + TURBO_HEADER_SIZE, turbo_block.end() - 1);
+
+        // Like the PRG file, the turbo file replaces the loader with the same name
+        for(T64_FILE &loader_file : *export_list)
+        {
+            if(loader_file.filename == filename)
+            {
+                loader_file.prg_data.swap(export_file.prg_data);
+                return true;
+            }
+        }
+        export_list->push_back(export_file);
+        return true;
+    }
+
+    // Like in the image, the turbo file replaces the PRG file of the loader with the same name
+    std::string prg_name = filename + ".prg";
+    if(std::find(prg_names.begin(), prg_names.end(), prg_name) == prg_names.end())
+        prg_name = GetUniquePRGFileName(filename, file_number, prg_names);
+
+    return WritePRGFile(prg_name, &turbo_block[0], &turbo_block[TURBO_HEADER_SIZE], turbo_block.size() - TURBO_HEADER_SIZE - 1);
+}
+
+/// @brief  Write the exported files into one T64 or D64 image
+/// @param image_file  Path to the image, the format is selected by the extension (.t64, .d64)
+/// @param tape_name  Name of the tape (disk name of the D64 image)
+/// @param export_list  Exported files in the order of the tape
+/// @return  True if the image was written
+/// @note   The image is created in memory and written with the writer thread.
+bool WriteExportImage(const char *image_file, const std::string &tape_name, const vector<T64_FILE> &export_list)
+{
+    std::string image_file_name = image_file;
+    size_t extension_pos = image_file_name.find_last_of('.');
+    std::string extension = extension_pos == std::string::npos ? "" : image_file_name.substr(extension_pos);
+    for(size_t i=0; i<extension.size(); i++)
+        extension[i] = static_cast<char>(tolower(static_cast<unsigned char>(extension[i])));
+
+    ByteVector image_data;
+    if(extension == ".t64")
+    {
+        if(!CreateT64Image(tape_name, export_list, image_data))
+        {
+            printf("Error creating T64 image: %s\n", image_file);
+            return false;
+        }
+    }
+    else if(extension == ".d64")
+    {
+        D64ImageClass d64_image;
+        d64_image.Format(tape_name, "TP");
+        for(const T64_FILE &file : export_list)
+        {
+            if(!d64_image.AddFile(file.filename, file.prg_data))
+            {
+                printf("D64 image is full, file is missing: %s\n", file.filename.c_str());
+                break;
+            }
+        }
+        image_data = d64_image.GetImage();
+    }
+    else
+    {
+        printf("Unknown image format (.t64 or .d64): %s\n", image_file);
+        return false;
+    }
+
+    if(!WriteOutputFile(image_file, image_data))
+    {
+        printf("Error writing image: %s\n", image_file);
+        return false;
+    }
+
+    printf("%d files written to: %s\n", static_cast<int>(export_list.size()), image_file);
+    return true;
+}
+
+/// @brief  Export all files of a TAP file as PRG
+/// @param tap_file  Path to the TAP file
+/// @param image_file  Optional, path to a T64 or D64 image which gets all files instead of single PRG files
+/// @note   Every header and data block is stored twice on the tape. Both copies
+///         are merged byte by byte, a byte with parity error is taken from the
+///         other copy.
+void ExportTAPFile(const char *tap_file, const char *image_file)
+{
+    AnalyzeTAPFile(tap_file);
+
+    vector<KERNAL_FILE_COPIES> file_list;
+    GroupKernalFiles(current_block_list, current_parity_error_list, file_list);
+
+    vector<T64_FILE> export_list;
+    vector<T64_FILE> *image_export_list = image_file != nullptr ? &export_list : nullptr;
+    vector<std::string> prg_names;
+
+    for(size_t i=0; i<file_list.size(); i++)
+    {
+        ExportKernalFile(file_list[i], static_cast<int>(i), prg_names, image_export_list);
+    }
+
+    // A turbo file has the name of its loader and replaces it
+    for(size_t i=0; i<current_turbo_block_list.size(); i++)
+    {
+        ExportTurboFile(current_turbo_block_list[i], static_cast<int>(file_list.size() + i), prg_names, image_export_list);
+    }
+
+    if(image_file != nullptr)
+        WriteExportImage(image_file, GetDisplayedPRGName(tap_file), export_list);
+}
+
+// Kernal tape layout (number of short pulses before the blocks)
+#define KERNAL_HEADER_LEADER_PULSES 27135   // 10sec Syncronisation
+#define KERNAL_DATA_LEADER_PULSES 5671      // 2sec Syncronisation
+#define KERNAL_REPEAT_LEADER_PULSES 79      // before the backup copy
+
+/// @brief  Read a complete PRG file
+/// @param prg_file_name  Path to the PRG file
+/// @param prg_data  Content of the PRG file (with start address)
+/// @return  True if the file could be read and contains at least the start address
+bool ReadPRGFile(const char *prg_file_name, ByteVector &prg_data)
+{
+    ifstream prg_stream(prg_file_name, ios::binary);
+    if(!prg_stream.is_open())
+    {
+        printf("Error opening PRG file: %s\n", prg_file_name);
+        return false;
+    }
+
+    prg_stream.seekg(0, ios::end);
+    streamoff prg_file_size = prg_stream.tellg();
+    prg_stream.seekg(0, ios::beg);
+
+    prg_data.resize(static_cast<size_t>(prg_file_size));
+    prg_stream.read(reinterpret_cast<char*>(prg_data.data()), prg_file_size);
+    prg_stream.close();
+
+    if(prg_file_size < 2)
+    {
+        printf("PRG file is too short: %s\n", prg_file_name);
+        return false;
+    }
+    return true;
+}
+
+/// @brief  Write a complete file from several parts
+/// @param file_name  Path to the file, "-" writes to stdout
+/// @param parts  Content of the file, written in the buffers of the writer thread
+/// @return  True if all data could be written
+/// @note   The file is written from the start to the end without seeking,
+///         so it can also be a pipe or another non-seekable file.
+bool WriteOutputFile(const char *file_name, const vector<const ByteVector*> &parts)
+{
+    // The writer thread writes a buffer while the next one is filled
+    AsyncWriterClass writer;
+    if(!writer.Open(file_name))
+    {
+        printf("Error opening file: %s\n", file_name);
+        return false;
+    }
+
+    for(size_t i=0; i<parts.size(); i++)
+        writer.Write(parts[i]->data(), parts[i]->size());
+
+    return writer.Close();
+}
+
+/// @brief  Write a complete file from memory with the writer thread
+/// @param file_name  Path to the file, "-" writes to stdout
+/// @param data  Content of the file
+/// @return  True if all data could be written
+bool WriteOutputFile(const char *file_name, const ByteVector &data)
+{
+    return WriteOutputFile(file_name, vector<const ByteVector*>(1, &data));
+}
+
+// TAP Clean
+
+/// @brief  Canonical TAP data byte for every TAP data byte
+struct TAP_CLEAN_TABLE
+{
+    uint8_t pulses[256];
+};
+
+/// @brief  Create the clean table of a timing profile at compile time
+/// @note   A byte in the short, medium or long window becomes the pulse length
+///         of the encoder, all other bytes (unknown pulses, 0x00) are kept.
+template<class TIMING>
+constexpr TAP_CLEAN_TABLE CreateTAPCleanTable()
+{
+    TAP_CLEAN_TABLE table = {};
+
+    for(uint32_t byte = 0; byte < 256; byte++)
+    {
+        switch(TIMING::GetPulseType(byte * 8))
+        {
+        case SHORT_PULSE:
+            table.pulses[byte] = TIMING::short_pulse_length >> 3;
+            break;
+        case MEDIUM_PULSE:
+            table.pulses[byte] = TIMING::medium_pulse_length >> 3;
+            break;
+        case LONG_PULSE:
+            table.pulses[byte] = TIMING::long_pulse_length >> 3;
+            break;
+        default:
+            table.pulses[byte] = static_cast<uint8_t>(byte);
+            break;
+        }
+    }
+
+    return table;
+}
+
+template<class TIMING>
+constexpr TAP_CLEAN_TABLE tap_clean_table = CreateTAPCleanTable<TIMING>();
+
+/// @brief  Quantize all recognized pulses of TAP data to the canonical lengths
+/// @param data  Pointer to the TAP data (behind the header), changed in place
+/// @param size  Size of the TAP data
+/// @param version  TAP version, in version 1 the 3 bytes of a pause are skipped
+/// @return  Number of changed pulses
+/// @note   Between two 0x00 bytes the data is mapped byte by byte with the table,
+///         the 0x00 bytes are found with memchr.
+template<class TIMING>
+uint32_t CleanTAPData(uint8_t *data, uint32_t size, uint8_t version)
+{
+    const uint8_t *table = tap_clean_table<TIMING>.pulses;
+    uint32_t changed = 0;
+    uint32_t pos = 0;
+
+    while(pos < size)
+    {
+        const uint8_t *pause = static_cast<const uint8_t*>(memchr(data + pos, 0x00, size - pos));
+        uint32_t end = pause != nullptr ? static_cast<uint32_t>(pause - data) : size;
+
+        for(; pos < end; pos++)
+        {
+            uint8_t pulse = table[data[pos]];
+            changed += pulse != data[pos];
+            data[pos] = pulse;
+        }
+
+        if(pause != nullptr)
+            pos += version == 1 ? 4 : 1;
+    }
+
+    return changed;
+}
+
+/// @brief  Write a TAP file with all recognized pulses quantized to the canonical lengths
+/// @param tap_file_name  Path to the TAP (or CSW) file
+/// @param clean_tap_file_name  Path to the cleaned TAP file ("-" for stdout)
+/// @return  True if the cleaned TAP file was written
+/// @note   The pulses are classified with the windows of the timing profile,
+///         unknown pulses and pauses are kept, so the size does not change.
+bool CleanTAPFile(const char *tap_file_name, const char *clean_tap_file_name)
+{
+    ByteVector tap_image;
+    uint32_t tap_size;
+    if(!LoadTAPImage(tap_file_name, tap_image, tap_size))
+    {
+        printf("Error opening TAP file: %s\n", tap_file_name);
+        return false;
+    }
+
+    if(tap_size < TAP_DATA_START || !IsTAPFile(tap_image.data(), tap_size))
+    {
+        printf("TAP file is invalid: %s\n", tap_file_name);
+        return false;
+    }
+
+    // Remove the padding bytes of LoadTAPImage
+    tap_image.resize(tap_size);
+
+    uint8_t version = tap_image[12];
+    uint32_t changed = CallWithTimingProfile(timing_profile, [&](auto timing)
+    {
+        return CleanTAPData<decltype(timing)>(tap_image.data() + TAP_DATA_START, tap_size - TAP_DATA_START, version);
+    });
+
+    if(!WriteOutputFile(clean_tap_file_name, tap_image))
+    {
+        printf("Error writing TAP file: %s\n", clean_tap_file_name);
+        return false;
+    }
+
+    if(strcmp(clean_tap_file_name, "-") != 0)
+        printf("Changed pulses: %u\n", changed);
+
+    return true;
+}
+
+/// @brief  Create the kernal header block of a PRG file
+/// @param prg_data  Content of the PRG file (with start address)
+/// @param filename_displayed  Filename on the C64 (max. 16 characters)
+/// @param kernal_header_block  Created header block
+void CreateKernalHeaderBlock(const ByteVector &prg_data, const char *filename_displayed, KERNAL_HEADER_BLOCK &kernal_header_block)
+{
+    kernal_header_block.start_address_low = prg_data[0];
+    kernal_header_block.start_address_high = prg_data[1];
+
+    uint32_t temp_address = (kernal_header_block.start_address_low | (kernal_header_block.start_address_high << 8));
+        
+    uint16_t end_adress = static_cast<uint16_t>(temp_address);
+    end_adress += static_cast<uint16_t>(prg_data.size() - 2);
+    kernal_header_block.end_address_low = static_cast<uint8_t>(end_adress & 0x00FF);
+    kernal_header_block.end_address_high = static_cast<uint8_t>((end_adress >> 8) & 0x00FF);
+
+    kernal_header_block.header_type = 0x01; // Kernal Header Block
+    memset(kernal_header_block.filename_dispayed, 0x20, sizeof(kernal_header_block.filename_dispayed));
+    memset(kernal_header_block.filename_not_displayed, 0x20, sizeof(kernal_header_block.filename_not_displayed));
+
+    memcpy(kernal_header_block.filename_dispayed, filename_displayed, std::min(strlen(filename_displayed), sizeof(kernal_header_block.filename_dispayed)));
+}
+
+/// @brief  Encode a PRG file in kernal tape format
+/// @param prg_data  Content of the PRG file (with start address)
+/// @param kernal_header_block  Header block of the file
+/// @param program  Tape program, the pulses of the file are appended
+template<class TIMING>
+void EncodeKernalTAPFile(const ByteVector &prg_data, const KERNAL_HEADER_BLOCK &kernal_header_block, TapeProgramClass &program)
+{
+    // TAP write 
+    // C64 PAL Frquency: 985248 Hz
+    // ● a short 365.4µs pulse (2737 Hz) PAL - 360 Takte    
+    // ● a medium 531.4µs pulse (1882Hz) PAL - 524 Takte
+    // ● a long 697.6µs pulse (1434 Hz) PAL - 687 Takte
+    // The pulse lengths are taken from the timing profile
+
+    // 1. Short pulse (27135)
+    // 2. Countdown Sequence 0x89 0x88 0x87 0x86 0x85 0x84 0x83 0x82 0x81
+    // 3. Kernal Header Block
+    // 3a. EndOfData Maker
+    // 4. Short pulse (79)
+    // 5. Countdown Sequence 0x09 0x08 0x07 0x06 0x05 0x04 0x03 0x02 0x01
+    // 6. Kernal Header Block (Backup)
+    // 7. Short pulse (5671)
+    // 9. Countdown Sequence 0x89 0x88 0x87 0x86 0x85 0x84 0x83 0x82 0x81
+    // 10. Kernal Data Block
+    // 10a. EndOfData Maker
+    // 11. Short pulse (79)
+    // 12. Countdown Sequence 0x09 0x08 0x07 0x06 0x05 0x04 0x03 0x02 0x01
+    // 13. Kernal Data Block (Backup)
+
+    const uint8_t *prg_bytes = prg_data.data() + 2;
+    uint32_t prg_file_size = static_cast<uint32_t>(prg_data.size() - 2);
+
+    // Start with 27135 short pulses (10sec Syncronisation)
+    program.AddPulses(TIMING::short_pulse_length, KERNAL_HEADER_LEADER_PULSES);
+
+    // Countdown Sequence (none backup)
+    for (uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+    {
+        program.AddKernalByte(countdown);
+    }
+
+    // Kernal Header Block
+    const uint8_t *header_bytes = (const uint8_t*)&kernal_header_block;
+    uint8_t crc = 0;
+    for(int i=0; i < (int)sizeof(kernal_header_block); i++)
+    {
+        crc ^= header_bytes[i];
+    }
+    program.AddKernalBytes(header_bytes, sizeof(kernal_header_block));
+    program.AddKernalByte(crc);
+
+    // Write the EndOfData Maker
+    program.AddPulses(TIMING::long_pulse_length, 1); 
+    program.AddPulses(TIMING::short_pulse_length, 1);
+
+    // Start with 79 short pulses
+    program.AddPulses(TIMING::short_pulse_length, KERNAL_REPEAT_LEADER_PULSES);
+
+    // Countdown Sequence (backup)
+    for (uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+    {
+        program.AddKernalByte(countdown);
+    }
+
+    // Kernal Header Block (Backup)
+    program.AddKernalBytes(header_bytes, sizeof(kernal_header_block));
+    program.AddKernalByte(crc);
+
+    // Start with 5671 short pulses (2sec Syncronisation)
+    program.AddPulses(TIMING::short_pulse_length, KERNAL_DATA_LEADER_PULSES);
+
+    // Countdown Sequence (none backup)
+    for (uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+    {
+        program.AddKernalByte(countdown);
+    }
+
+    // Kernal Data Block
+    crc = 0;
+    for(uint32_t i=0; i < prg_file_size; i++)
+    {
+        crc ^= prg_bytes[i];
+    }
+    program.AddKernalBytes(prg_bytes, prg_file_size);
+    program.AddKernalByte(crc);
+    
+    // Write the EndOfData Maker        
+    program.AddPulses(TIMING::long_pulse_length, 1);
+    program.AddPulses(TIMING::short_pulse_length, 1);
+
+    // Start with 79 short pulses
+    program.AddPulses(TIMING::short_pulse_length, KERNAL_REPEAT_LEADER_PULSES);
+
+    // Countdown Sequence (backup)
+    for (uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+    {
+        program.AddKernalByte(countdown);
+    }
+
+    // Kernal Data Block (Backup)
+    program.AddKernalBytes(prg_bytes, prg_file_size);
+    program.AddKernalByte(crc);
+
+    // Write the EndOfData Maker (Optional)
+    //program.AddPulses(TIMING::long_pulse_length, 1); 
+    //program.AddPulses(TIMING::short_pulse_length, 1);
+}
+
+/// @brief  Encode a PRG file in kernal tape format
+/// @param prg_data  Content of the PRG file (with start address)
+/// @param filename_displayed  Filename on the C64 (max. 16 characters)
+/// @param program  Tape program, the pulses of the file are appended
+template<class TIMING>
+void EncodeKernalTAPFile(const ByteVector &prg_data, const char *filename_displayed, TapeProgramClass &program)
+{
+    KERNAL_HEADER_BLOCK kernal_header_block;
+    CreateKernalHeaderBlock(prg_data, filename_displayed, kernal_header_block);
+    EncodeKernalTAPFile<TIMING>(prg_data, kernal_header_block, program);
+}
+
+// Turbo tape layout
+// The loader is stored in the kernal header block behind the displayed filename
+// (tape buffer $033C + 21 = $0351) and is started by a BASIC stub (10 SYS849).
+#define TURBO_PILOT_BYTES 1024                                  // ~2sec, the loader starts the motor again
+#define TURBO_TRAILER_BYTES 16
+#define TURBO_LOADER_TIMER (TURBO_PULSE_THRESHOLD - 7)          // 7 cycles between edge and timer start / read
+#define TURBO_LOADER_RUN_OFFSET 0x75                            // "lda $fb" is replaced by "rts" if it is no BASIC program
+
+static const uint8_t turbo_basic_stub[]{
+    0x01, 0x08,                                                 // Start address $0801
+    0x0A, 0x08, 0x0A, 0x00, 0x9E, 0x38, 0x34, 0x39, 0x00,       // 10 SYS849
+    0x00, 0x00                                                  // End of the BASIC program
+};
+
+static const uint8_t turbo_loader[]{
+    0x78,                                   // 0351  loader:  sei            ; Interrupts off
+    0xA9, (TURBO_LOADER_TIMER & 0xFF),      // 0352           lda #<timer
+    0x8D, 0x06, 0xDD,                       // 0354           sta $dd06      ; CIA2 Timer B = threshold between bit 0 and 1
+    0xA9, (TURBO_LOADER_TIMER >> 8),        // 0357           lda #>timer
+    0x8D, 0x07, 0xDD,                       // 0359           sta $dd07
+    0xA9, 0x0B,                             // 035C           lda #$0b
+    0x8D, 0x11, 0xD0,                       // 035E           sta $d011      ; Screen off (no bad lines)
+    0xA9, 0x17,                             // 0361           lda #$17
+    0x85, 0x01,                             // 0363           sta $01        ; Motor on
+    0x20, 0xE5, 0x03,                       // 0365  sync:    jsr getbit     ; Bit synchronisation on the pilot byte
+    0x26, 0x02,                             // 0368           rol $02
+    0xA5, 0x02,                             // 036A           lda $02
+    0xC9, 0x02,                             // 036C           cmp #$02
+    0xD0, 0xF5,                             // 036E           bne sync
+    0x20, 0xD7, 0x03,                       // 0370  pilot:   jsr getbyte
+    0xC9, 0x02,                             // 0373           cmp #$02
+    0xF0, 0xF9,                             // 0375           beq pilot
+    0xC9, 0x09,                             // 0377           cmp #$09       ; Sync byte
+    0xD0, 0xEA,                             // 0379           bne sync
+    0xA2, 0x00,                             // 037B           ldx #$00
+    0x20, 0xD7, 0x03,                       // 037D  header:  jsr getbyte    ; Start and end address to $fb-$fe
+    0x95, 0xFB,                             // 0380           sta $fb,x
+    0xE8,                                   // 0382           inx
+    0xE0, 0x04,                             // 0383           cpx #$04
+    0xD0, 0xF6,                             // 0385           bne header
+    0xA2, 0x10,                             // 0387           ldx #$10
+    0x20, 0xD7, 0x03,                       // 0389  name:    jsr getbyte    ; Skip the filename
+    0xCA,                                   // 038C           dex
+    0xD0, 0xFA,                             // 038D           bne name
+    0x86, 0xA3,                             // 038F           stx $a3        ; Checksum = 0
+    0x20, 0xD7, 0x03,                       // 0391  data:    jsr getbyte
+    0xA0, 0x00,                             // 0394           ldy #$00
+    0x91, 0xFB,                             // 0396           sta ($fb),y
+    0x45, 0xA3,                             // 0398           eor $a3
+    0x85, 0xA3,                             // 039A           sta $a3
+    0xE6, 0xFB,                             // 039C           inc $fb
+    0xD0, 0x02,                             // 039E           bne check
+    0xE6, 0xFC,                             // 03A0           inc $fc
+    0xA5, 0xFB,                             // 03A2  check:   lda $fb
+    0xC5, 0xFD,                             // 03A4           cmp $fd
+    0xA5, 0xFC,                             // 03A6           lda $fc
+    0xE5, 0xFE,                             // 03A8           sbc $fe
+    0x90, 0xE5,                             // 03AA           bcc data
+    0x20, 0xD7, 0x03,                       // 03AC           jsr getbyte    ; Checksum
+    0x45, 0xA3,                             // 03AF           eor $a3
+    0x85, 0xA3,                             // 03B1           sta $a3
+    0xA9, 0x37,                             // 03B3           lda #$37
+    0x85, 0x01,                             // 03B5           sta $01        ; Motor off
+    0xA9, 0x1B,                             // 03B7           lda #$1b
+    0x8D, 0x11, 0xD0,                       // 03B9           sta $d011      ; Screen on
+    0x58,                                   // 03BC           cli
+    0xA5, 0xA3,                             // 03BD           lda $a3
+    0xF0, 0x05,                             // 03BF           beq run
+    0xA2, 0x1D,                             // 03C1           ldx #$1d
+    0x4C, 0x37, 0xA4,                       // 03C3           jmp $a437      ; ?LOAD ERROR
+    0xA5, 0xFB,                             // 03C6  run:     lda $fb        ; Replaced by RTS if it is no BASIC program
+    0x85, 0x2D,                             // 03C8           sta $2d        ; End of the BASIC program
+    0xA5, 0xFC,                             // 03CA           lda $fc
+    0x85, 0x2E,                             // 03CC           sta $2e
+    0x20, 0x33, 0xA5,                       // 03CE           jsr $a533      ; Relink lines
+    0x20, 0x59, 0xA6,                       // 03D1           jsr $a659      ; CLR
+    0x4C, 0xAE, 0xA7,                       // 03D4           jmp $a7ae      ; RUN
+    0xA9, 0x01,                             // 03D7  getbyte: lda #$01       ; Read 8 bits (MSB first)
+    0x85, 0x02,                             // 03D9           sta $02
+    0x20, 0xE5, 0x03,                       // 03DB  gbloop:  jsr getbit
+    0x26, 0x02,                             // 03DE           rol $02
+    0x90, 0xF9,                             // 03E0           bcc gbloop
+    0xA5, 0x02,                             // 03E2           lda $02
+    0x60,                                   // 03E4           rts
+    0xA9, 0x10,                             // 03E5  getbit:  lda #$10
+    0x2C, 0x0D, 0xDC,                       // 03E7  gbwait:  bit $dc0d      ; Wait for the falling edge (FLAG)
+    0xF0, 0xFB,                             // 03EA           beq gbwait
+    0xAD, 0x0D, 0xDD,                       // 03EC           lda $dd0d      ; Timer B underflow = long pulse = bit 1
+    0xA0, 0x19,                             // 03EF           ldy #$19
+    0x8C, 0x0F, 0xDD,                       // 03F1           sty $dd0f      ; Restart Timer B (one shot)
+    0x4A,                                   // 03F4           lsr
+    0x4A,                                   // 03F5           lsr            ; Bit in carry
+    0x60,                                   // 03F6           rts
+};
+
+/// @brief  Encode a PRG file in turbo tape format
+/// @param prg_data  Content of the PRG file (with start address)
+/// @param filename_displayed  Filename on the C64 (max. 16 characters)
+/// @param program  Tape program, the pulses of the file are appended
+/// @note   The BASIC stub with the loader in its header is written in kernal
+///         format, the PRG file follows with one pulse per bit (~10x faster).
+///         The turbo pulses are measured in cycles by the loader, they are the same for all timing profiles.
+template<class TIMING>
+void EncodeTurboTAPFile(const ByteVector &prg_data, const char *filename_displayed, TapeProgramClass &program)
+{
+    // Kernal file: BASIC stub, the loader is in the header block
+    ByteVector stub_data(turbo_basic_stub, turbo_basic_stub + sizeof(turbo_basic_stub));
+    KERNAL_HEADER_BLOCK kernal_header_block;
+    CreateKernalHeaderBlock(stub_data, filename_displayed, kernal_header_block);
+
+    static_assert(sizeof(turbo_loader) <= sizeof(kernal_header_block.filename_not_displayed), "Turbo loader is too big for the kernal header");
+    memcpy(kernal_header_block.filename_not_displayed, turbo_loader, sizeof(turbo_loader));
+
+    uint16_t start_address = static_cast<uint16_t>(prg_data[0] | prg_data[1] << 8);
+    if(start_address != 0x0801)
+        kernal_header_block.filename_not_displayed[TURBO_LOADER_RUN_OFFSET] = 0x60;
+
+    EncodeKernalTAPFile<TIMING>(stub_data, kernal_header_block, program);
+
+    // Turbo block
+    for(int i=0; i<TURBO_PILOT_BYTES; i++)
+        program.AddTurboByte(TURBO_PILOT_BYTE);
+    program.AddTurboByte(TURBO_SYNC_BYTE);
+
+    uint16_t end_address = static_cast<uint16_t>(start_address + prg_data.size() - 2);
+    program.AddTurboByte(prg_data[0]);
+    program.AddTurboByte(prg_data[1]);
+    program.AddTurboByte(static_cast<uint8_t>(end_address));
+    program.AddTurboByte(static_cast<uint8_t>(end_address >> 8));
+
+    char filename[16];
+    memset(filename, 0x20, sizeof(filename));
+    memcpy(filename, filename_displayed, std::min(strlen(filename_displayed), sizeof(filename)));
+    program.AddTurboBytes((const uint8_t*)filename, sizeof(filename));
+
+    uint8_t crc = 0;
+    for(size_t i=2; i<prg_data.size(); i++)
+    {
+        crc ^= prg_data[i];
+    }
+    program.AddTurboBytes(prg_data.data() + 2, static_cast<uint32_t>(prg_data.size() - 2));
+    program.AddTurboByte(crc);
+
+    // Trailer, the last bit needs the following edge
+    for(int i=0; i<TURBO_TRAILER_BYTES; i++)
+        program.AddTurboByte(0x00);
+}
+
+/// @brief  Encode a PRG file in the selected tape format (kernal or turbo)
+/// @param prg_data  Content of the PRG file (with start address)
+/// @param filename_displayed  Filename on the C64 (max. 16 characters)
+/// @param program  Tape program, the pulses of the file are appended
+/// @note   The encoder is instantiated with the selected timing profile
+void EncodeTAPFile(const ByteVector &prg_data, const char *filename_displayed, TapeProgramClass &program)
+{
+    program.SetTimingProfile(timing_profile);
+
+    CallWithTimingProfile(timing_profile, [&](auto timing)
+    {
+        typedef decltype(timing) TIMING;
+
+        if(turbo_mode)
+            EncodeTurboTAPFile<TIMING>(prg_data, filename_displayed, program);
+        else
+            EncodeKernalTAPFile<TIMING>(prg_data, filename_displayed, program);
+    });
+}
+
+/// @brief  Create the header of a TAP file
+/// @param version  TAP version
+/// @param tap_data_size  Size of the TAP data (without header)
+/// @param tap_header  TAP header (20 bytes) is appended
+/// @param video_standard  Video standard of the machine (TAP_VIDEO_*)
+void CreateTAPHeader(uint8_t version, uint32_t tap_data_size, ByteVector &tap_header, uint8_t video_standard = TAP_VIDEO_PAL)
+{
+    const char tap_signature[] = "C64-TAPE-RAW";
+    tap_header.insert(tap_header.end(), tap_signature, tap_signature + 12);     // TAP Header
+    tap_header.push_back(version);                                              // TAP Version
+    tap_header.push_back(0x00);                                                 // Platform (C64)
+    tap_header.push_back(video_standard);                                       // Video Standard
+    tap_header.push_back(0x00);                                                 // TAP Header (Future expanison)
+    for(int i=0; i<4; i++)
+        tap_header.push_back(static_cast<uint8_t>(tap_data_size >> (i * 8)));  // TAP Data Size
+}
+
+/// @brief  Render a tape program as TAP file and write it
+/// @param tap_file_name  Path to the TAP file ("-" for stdout)
+/// @param program  Tape program
+/// @param version  TAP version
+/// @return  True if the TAP file was written
+/// @note   The size is known before, so the header is written first. The TAP data
+///         is rendered directly into the buffers of the writer thread, which
+///         writes a buffer while the next one is rendered.
+bool WriteTAPProgramFile(const char *tap_file_name, const TapeProgramClass &program, uint8_t version)
+{
+    AsyncWriterClass writer;
+    if(!writer.Open(tap_file_name))
+    {
+        printf("Error opening TAP file: %s\n", tap_file_name);
+        return false;
+    }
+
+    ByteVector tap_header;
+    CreateTAPHeader(version, program.GetTAPDataSize(version), tap_header, GetTimingVideoStandard(program.GetTimingProfile()));
+    writer.Write(tap_header.data(), tap_header.size());
+
+    program.RenderTAPParts(version, ASYNC_WRITER_BUFFER_SIZE,
+                           [&]() -> ByteVector& { return writer.GetBuffer(); },
+                           [&](ByteVector &buffer) { writer.Submit(buffer, buffer.size()); });
+
+    if(!writer.Close())
+    {
+        printf("Error writing TAP file: %s\n", tap_file_name);
+        return false;
+    }
+
+    return true;
+}
+
+bool ConvertPRGToTAP(const char *prg_file_name, const char *tap_file_name)
+{
+    ByteVector prg_data;
+    if(!ReadPRGFile(prg_file_name, prg_data))
+        return false;
+
+    TapeProgramClass program;
+    EncodeTAPFile(prg_data, "C64-TAP-TOOL", program);
+
+    return WriteTAPProgramFile(tap_file_name, program, tap_version);
+}
+
+/// @brief  Convert a TAP image to a CSW file and write it
+/// @param tap_image  Complete TAP image
+/// @param tap_size  Size of the TAP image
+/// @param csw_file_name  Path to the CSW file ("-" for stdout)
+/// @param csw_version  CSW version (1 or 2)
+/// @return  True if the CSW file was written
+bool WriteCSWFile(const uint8_t *tap_image, uint32_t tap_size, const char *csw_file_name, int csw_version)
+{
+    ByteVector csw_data;
+    if(!ConvertTAPToCSW(tap_image, tap_size, csw_version, CSW_DEFAULT_SAMPLE_RATE, csw_data, GetTimingCyclesPerSecond(timing_profile)))
+    {
+        printf("Error converting to CSW.\n");
+        return false;
+    }
+
+    if(!WriteOutputFile(csw_file_name, csw_data))
+    {
+        printf("Error writing CSW file: %s\n", csw_file_name);
+        return false;
+    }
+
+    return true;
+}
+
+/// @brief  Render a tape program as CSW file and write it
+/// @note   The tape program is rendered as TAP image (version 1) and then written as half waves
+bool WriteCSWProgramFile(const char *csw_file_name, const TapeProgramClass &program, int csw_version)
+{
+    uint32_t tap_data_size = program.GetTAPDataSize(1);
+
+    ByteVector tap_image;
+    tap_image.reserve(TAP_DATA_START + tap_data_size);
+
+    CreateTAPHeader(1, tap_data_size, tap_image, GetTimingVideoStandard(program.GetTimingProfile()));
+    program.RenderTAP(tap_image, 1);
+
+    return WriteCSWFile(tap_image.data(), static_cast<uint32_t>(tap_image.size()), csw_file_name, csw_version);
+}
+
+bool ConvertPRGToCSW(const char *prg_file_name, const char *csw_file_name, int csw_version)
+{
+    ByteVector prg_data;
+    if(!ReadPRGFile(prg_file_name, prg_data))
+        return false;
+
+    TapeProgramClass program;
+    EncodeTAPFile(prg_data, "C64-TAP-TOOL", program);
+
+    return WriteCSWProgramFile(csw_file_name, program, csw_version);
+}
+
+bool ConvertTAPToCSWFile(const char *tap_file_name, const char *csw_file_name, int csw_version)
+{
+    ByteVector tap_image;
+    uint32_t tap_size;
+    if(!LoadTAPImage(tap_file_name, tap_image, tap_size))
+    {
+        printf("Error opening TAP file: %s\n", tap_file_name);
+        return false;
+    }
+
+    if(tap_size < TAP_DATA_START || !IsTAPFile(tap_image.data(), tap_size))
+    {
+        printf("TAP file is invalid: %s\n", tap_file_name);
+        return false;
+    }
+
+    return WriteCSWFile(tap_image.data(), tap_size, csw_file_name, csw_version);
+}
+
+/// @brief  Convert a WAV file (recording of a tape) to a TAP file (version 1)
+/// @param wav_file_name  Path to the WAV file
+/// @param tap_file_name  Path to the TAP file ("-" for stdout)
+/// @return  True if the TAP file was written
+bool ConvertWAVToTAPFile(const char *wav_file_name, const char *tap_file_name)
+{
+    ByteVector tap_image;
+    uint32_t tap_size;
+    const char *source_format;
+    if(!LoadTAPImage(wav_file_name, tap_image, tap_size, &source_format) || source_format == nullptr || strcmp(source_format, "WAV") != 0)
+    {
+        printf("Error reading WAV file: %s\n", wav_file_name);
+        return false;
+    }
+
+    tap_image.resize(tap_size);
+    if(!WriteOutputFile(tap_file_name, tap_image))
+    {
+        printf("Error writing TAP file: %s\n", tap_file_name);
+        return false;
+    }
+
+    return true;
+}
+
+// Live capture of a tape (raw PCM samples on stdin)
+#define CAPTURE_READ_SIZE 4096          // Max. bytes per read, a read returns with the samples which are already there
+#define KERNAL_HEADER_BLOCK_SIZE 202    // Countdown, header (192 bytes) and checksum
+
+volatile sig_atomic_t capture_stop = 0;
+
+/// @brief  Signal handler of the live capture (Ctrl+C), the capture ends and the TAP file is completed
+void CaptureSignalHandler(int)
+{
+    capture_stop = 1;
+}
+
+/// @brief  Read the samples from stdin which are already there (unbuffered)
+/// @return  Number of bytes, 0 at the end of the stream, -1 on error
+int64_t ReadStdin(uint8_t *buffer, size_t size)
+{
+#ifdef _WIN32
+    return _read(_fileno(stdin), buffer, static_cast<unsigned int>(size));
+#else
+    return read(STDIN_FILENO, buffer, size);
+#endif
+}
+
+/// @brief  Kernal block of a live capture
+struct CAPTURE_BLOCK
+{
+    ByteVector data;
+    uint32_t parity_errors;
+    size_t expected_size;       // Size of the block (countdown + data + checksum), known with the first byte
+    bool is_data;               // Data block of the last program header
+    bool open;                  // More bytes belong to this block
+    uint64_t start_cycles;      // Tape time of the first byte
+};
+
+/// @brief  State of a live capture
+struct CAPTURE_STATE
+{
+    KERNAL_DECODER_STATE decoder;
+    CAPTURE_BLOCK block;
+    int block_count;
+    size_t data_block_size;     // Size of the data blocks of the last program header, 0 = no data expected
+    bool last_block_was_data;
+    uint32_t pulse_count;
+    uint64_t cycles;            // Tape time of the current pulse
+};
+
+/// @brief  Print a block of a live capture and forget its bytes
+/// @param capture  State of the capture, the sizes of the next data blocks are taken from a program header
+void ReportCaptureBlock(CAPTURE_STATE &capture)
+{
+    CAPTURE_BLOCK &block = capture.block;
+    block.open = false;
+    if(block.data.empty())
+        return;
+
+    char time_str[32];
+    FormatTapeTime(block.start_cycles, time_str, sizeof(time_str));
+
+    bool backup = (block.data[0] & 0x80) != 0x80;
+    bool countdown_ok = block.data.size() >= 9;
+    for(size_t i=0; countdown_ok && i<9; i++)
+        countdown_ok = block.data[i] == static_cast<uint8_t>((backup ? 0x09 : 0x89) - i);
+
+    if(block.data.size() < block.expected_size)
+    {
+        printf("[%s] Block %d: %s%s incomplete (%ld of %ld bytes)", time_str, capture.block_count, block.is_data ? "Data" : "Header", backup ? " backup" : "",
+               static_cast<long>(block.data.size()), static_cast<long>(block.expected_size));
+    }
+    else if(!block.is_data && IsKernalHeaderBlock(block.data))
+    {
+        const KERNAL_HEADER_BLOCK *kernal_header_block = (const KERNAL_HEADER_BLOCK *)&block.data[9];
+        uint16_t start_address = static_cast<uint16_t>(kernal_header_block->start_address_low | kernal_header_block->start_address_high << 8);
+        uint16_t end_address = static_cast<uint16_t>(kernal_header_block->end_address_low | kernal_header_block->end_address_high << 8);
+
+        printf("[%s] Block %d: Header%s \"%s\" (%4.4x - %4.4x) [CRC: %s] - [Countdown: %s]", time_str, capture.block_count, backup ? " backup" : "",
+               GetKernalFilename(block.data).c_str(), start_address, end_address, CheckKernalBlockChecksum(block.data) ? "OK" : "Error", countdown_ok ? "OK" : "Error");
+
+        // A program header is followed by two data blocks with the size of the program
+        bool program = kernal_header_block->header_type == 0x01 || kernal_header_block->header_type == 0x03;
+        capture.data_block_size = program && end_address > start_address ? static_cast<size_t>(end_address - start_address) + 10 : 0;
+    }
+    else
+    {
+        printf("[%s] Block %d: %s%s (%ld bytes) [CRC: %s] - [Countdown: %s]", time_str, capture.block_count, block.is_data ? "Data" : "Block", backup ? " backup" : "",
+               static_cast<long>(block.data.size()), CheckKernalBlockChecksum(block.data) ? "OK" : "Error", countdown_ok ? "OK" : "Error");
+    }
+
+    if(block.parity_errors > 0)
+        printf(" - Parity errors: %u", block.parity_errors);
+    printf("\n");
+    fflush(stdout);
+
+    if(block.is_data && backup)
+        capture.data_block_size = 0;
+    capture.last_block_was_data = block.is_data;
+    capture.block_count++;
+
+    block.data.clear();
+    block.parity_errors = 0;
+}
+
+/// @brief  Add a decoded byte to the block of a live capture
+/// @param capture  State of the capture
+/// @param data_byte  Byte
+/// @param parity_error  True if the byte has a parity error
+/// @param start_new_block  True if a sync was found before the byte
+/// @note   The block is printed as soon as its last byte is there, the size
+///         of a data block is known from the header before.
+void AddCaptureByte(CAPTURE_STATE &capture, uint8_t data_byte, bool parity_error, bool start_new_block)
+{
+    CAPTURE_BLOCK &block = capture.block;
+
+    if(start_new_block || (!block.open && capture.block_count == 0 && block.data.empty()))
+    {
+        // A block which is interrupted by a sync is printed as incomplete
+        ReportCaptureBlock(capture);
+
+        // The first copy of the data follows the header, the backup of the data follows the data
+        bool backup = (data_byte & 0x80) != 0x80;
+        block.is_data = capture.data_block_size > 0 && backup == capture.last_block_was_data;
+        block.expected_size = block.is_data ? capture.data_block_size : KERNAL_HEADER_BLOCK_SIZE;
+        block.start_cycles = capture.cycles;
+        block.open = true;
+    }
+
+    // Bytes behind a complete block without a new sync are ignored
+    if(!block.open)
+        return;
+
+    block.data.push_back(data_byte);
+    if(parity_error)
+        block.parity_errors++;
+
+    if(block.data.size() >= block.expected_size)
+        ReportCaptureBlock(capture);
+}
+
+/// @brief  Push the pulses of a live capture into the kernal decoder
+/// @param capture  State of the capture
+/// @param pulses  Pulses in cycles
+template<class TIMING>
+void DecodeCapturePulses(CAPTURE_STATE &capture, const vector<uint64_t> &pulses)
+{
+    for(size_t i=0; i<pulses.size(); i++)
+    {
+        capture.cycles += pulses[i];
+        capture.pulse_count++;
+
+        uint8_t pulse_type = TIMING::GetPulseType(static_cast<uint32_t>(std::min<uint64_t>(pulses[i], 0xFFFFFFFF)));
+        int result = DecodeKernalPulse(capture.decoder, pulse_type, capture.pulse_count);
+        if(result != KERNAL_DECODE_NO_BYTE)
+        {
+            AddCaptureByte(capture, capture.decoder.data_byte, result == KERNAL_DECODE_PARITY_ERROR, capture.decoder.start_new_block);
+
+            // Like GetNextKernalByte, the last pulse of a byte is the first pulse of the next byte
+            ResetKernalDecoder(capture.decoder);
+            DecodeKernalPulse(capture.decoder, pulse_type, capture.pulse_count);
+        }
+    }
+}
+
+/// @brief  Capture a tape live from raw PCM samples on stdin
+/// @param tap_file_name  Optional, TAP file (version 1) which is written while capturing, nullptr = only decoding
+/// @return  True if the capture ended without an error
+/// @note   The samples are read as they arrive, the pulses of every read are
+///         decoded at once and the blocks are printed with their last byte.
+///         The memory is constant: a read buffer, the filter state and the
+///         current block. The capture ends at the end of the stream or with
+///         Ctrl+C, then the size in the TAP header is written.
+bool CaptureTape(const char *tap_file_name)
+{
+    PCMPulseDetectorClass detector;
+    if(!detector.Create(pcm_sample_rate, pcm_format_tag, pcm_bits_per_sample, pcm_channels, GetTimingCyclesPerSecond(timing_profile)))
+    {
+        printf("PCM format is not supported.\n");
+        return false;
+    }
+
+    ofstream tap_stream;
+    if(tap_file_name != nullptr)
+    {
+        tap_stream.open(tap_file_name, ios::binary);
+        if(!tap_stream.is_open())
+        {
+            printf("Error opening TAP file: %s\n", tap_file_name);
+            return false;
+        }
+
+        ByteVector tap_header;
+        CreateTAPHeader(1, 0, tap_header, GetTimingVideoStandard(timing_profile));
+        tap_stream.write(reinterpret_cast<const char*>(tap_header.data()), static_cast<streamsize>(tap_header.size()));
+    }
+
+#ifdef _WIN32
+    // Ctrl+C sets capture_stop, the capture ends after the next read
+    _setmode(_fileno(stdin), _O_BINARY);
+    signal(SIGINT, CaptureSignalHandler);
+#else
+    // Ctrl+C interrupts the read (no SA_RESTART) and ends the capture
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = CaptureSignalHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+#endif
+
+    printf("Sample rate: %u Hz, %d bit %s, %d channel(s)\n", pcm_sample_rate, pcm_bits_per_sample, pcm_format_tag == WAV_FORMAT_TAG_FLOAT ? "float" : "PCM", pcm_channels);
+    fflush(stdout);
+
+    decoder_messages = false;
+    CAPTURE_STATE capture;
+    ResetKernalDecoder(capture.decoder);
+    capture.block.parity_errors = 0;
+    capture.block.expected_size = KERNAL_HEADER_BLOCK_SIZE;
+    capture.block.is_data = false;
+    capture.block.open = false;
+    capture.block.start_cycles = 0;
+    capture.block_count = 0;
+    capture.data_block_size = 0;
+    capture.last_block_was_data = false;
+    capture.pulse_count = 0;
+    capture.cycles = 0;
+
+    const size_t frame_size = detector.GetFrameSize();
+    uint8_t pcm_buffer[CAPTURE_READ_SIZE];
+    size_t buffered = 0;
+    vector<uint64_t> pulses;
+    ByteVector tap_data;
+    uint64_t tap_data_size = 0;
+    bool ret = true;
+    bool end = false;
+
+    while(!end)
+    {
+        pulses.clear();
+
+        int64_t bytes = capture_stop ? 0 : ReadStdin(pcm_buffer + buffered, sizeof(pcm_buffer) - buffered);
+        if(bytes < 0 && errno == EINTR && !capture_stop)
+            continue;
+
+        if(bytes <= 0)
+        {
+            // End of the stream, the last wave ends its pulse
+            if(bytes < 0 && !capture_stop)
+            {
+                printf("Error reading stdin.\n");
+                ret = false;
+            }
+            detector.Flush(pulses);
+            end = true;
+        }
+        else
+        {
+            buffered += static_cast<size_t>(bytes);
+            size_t frames = buffered / frame_size;
+            detector.AddSamples(pcm_buffer, frames, pulses);
+
+            // An incomplete sample stays in the buffer
+            buffered -= frames * frame_size;
+            memmove(pcm_buffer, pcm_buffer + frames * frame_size, buffered);
+        }
+
+        CallWithTimingProfile(timing_profile, [&](auto timing)
+        {
+            DecodeCapturePulses<decltype(timing)>(capture, pulses);
+        });
+
+        if(tap_stream.is_open() && !pulses.empty())
+        {
+            tap_data.clear();
+            for(size_t i=0; i<pulses.size(); i++)
+                AddTAPPulse(tap_data, pulses[i]);
+            tap_stream.write(reinterpret_cast<const char*>(tap_data.data()), static_cast<streamsize>(tap_data.size()));
+            tap_stream.flush();
+            tap_data_size += tap_data.size();
+        }
+    }
+
+    ReportCaptureBlock(capture);
+
+    signal(SIGINT, SIG_DFL);
+    capture_stop = 0;
+    decoder_messages = true;
+
+    char time_str[32];
+    FormatTapeTime(capture.cycles, time_str, sizeof(time_str));
+    printf("Capture end: %d blocks, %u pulses, tape time %s\n", capture.block_count, capture.pulse_count, time_str);
+
+    if(tap_stream.is_open())
+    {
+        if(tap_data_size > 0xFFFFFFFF)
+        {
+            printf("TAP file is larger than 4 GB: %s\n", tap_file_name);
+            return false;
+        }
+
+        uint8_t size_field[4];
+        for(int i=0; i<4; i++)
+            size_field[i] = static_cast<uint8_t>(tap_data_size >> (i * 8));
+        tap_stream.seekp(16);
+        tap_stream.write(reinterpret_cast<const char*>(size_field), 4);
+        tap_stream.close();
+
+        if(tap_stream.fail())
+        {
+            printf("Error writing TAP file: %s\n", tap_file_name);
+            return false;
+        }
+        printf("TAP file written: %s\n", tap_file_name);
+    }
+
+    return ret;
+}
+
+/// @brief  Convert a PRG file to several output files with one encode
+/// @param prg_file_name  Path to the PRG file
+/// @param output_files  Output files, the format is selected by the extension (.wav, .csw, otherwise TAP)
+/// @param csw_version  CSW version (1 or 2)
+/// @return  True if all files were written
+bool ConvertPRGToFiles(const char *prg_file_name, const vector<const char*> &output_files, int csw_version)
+{
+    ByteVector prg_data;
+    if(!ReadPRGFile(prg_file_name, prg_data))
+        return false;
+
+    TapeProgramClass program;
+    EncodeTAPFile(prg_data, "C64-TAP-TOOL", program);
+
+    bool ret = true;
+    for(size_t i=0; i<output_files.size(); i++)
+    {
+        std::string output_file = output_files[i];
+        size_t extension_pos = output_file.find_last_of('.');
+        std::string extension = extension_pos == std::string::npos ? "" : output_file.substr(extension_pos);
+        for(size_t j=0; j<extension.size(); j++)
+            extension[j] = static_cast<char>(tolower(static_cast<unsigned char>(extension[j])));
+
+        if(extension == ".wav")
+            ret &= WriteWAVProgramFile(output_files[i], program);
+        else if(extension == ".csw")
+            ret &= WriteCSWProgramFile(output_files[i], program, csw_version);
+        else
+            ret &= WriteTAPProgramFile(output_files[i], program, tap_version);
+    }
+
+    return ret;
+}
+
+// Pause between two files on a tape with several files
+#define TAP_FILE_GAP_SECONDS 2
+
+/// @brief  PRG file on a tape with several files
+struct TAP_AUTHOR_FILE
+{
+    std::string prg_file_name;
+    std::string filename_displayed;
+    bool valid;
+    ByteVector prg_data;            // Content of the PRG file, read from prg_file_name if empty
+    ByteVector tap_data;            // Rendered TAP data (version 1)
+};
+
+/// @brief  Get the displayed name of a PRG file from its path
+/// @param prg_file_name  Path to the PRG file
+/// @return  Filename without directory and extension in upper case (max. 16 characters)
+std::string GetDisplayedPRGName(const std::string &prg_file_name)
+{
+    size_t start = prg_file_name.find_last_of("/\\");
+    std::string filename = prg_file_name.substr(start == std::string::npos ? 0 : start + 1);
+
+    size_t extension = filename.find_last_of('.');
+    if(extension != std::string::npos && extension > 0)
+        filename.erase(extension);
 
-    // Create the WAV File for the C64
-    // Start with 27135 short pulses (10sec Syncronisation)
-    tap_data_size += WriteTAPShortPulse(tap_stream, 27135);
+    for(size_t i=0; i<filename.size(); i++)
+        filename[i] = static_cast<char>(toupper(static_cast<unsigned char>(filename[i])));
 
-    // Countdown Sequence (none backup)
-    for (uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+    return filename.substr(0, 16);
+}
+
+/// @brief  Read and encode one PRG file of a tape with several files
+void EncodeAuthorFile(TAP_AUTHOR_FILE *file)
+{
+    if(file->prg_data.empty())
+        file->valid = ReadPRGFile(file->prg_file_name.c_str(), file->prg_data);
+    else
+        file->valid = true;
+
+    if(file->valid)
     {
-        tap_data_size += WriteTAPByte(tap_stream, countdown);
+        TapeProgramClass program;
+        EncodeTAPFile(file->prg_data, file->filename_displayed.c_str(), program);
+        program.RenderTAP(file->tap_data, 1);
     }
+}
 
-    // Kernal Header Block
-    KERNAL_HEADER_BLOCK kernal_header_block;
-    prg_stream.read(reinterpret_cast<char*>(&kernal_header_block.start_address_low), 1);
-    prg_stream.read(reinterpret_cast<char*>(&kernal_header_block.start_address_high), 1);
-    prg_file_size -= 2;
+/// @brief  Encode the files of a tape with several files and write the TAP file
+/// @param tap_file_name  Path to the TAP file, "-" writes to stdout
+/// @param file_list  Files of the tape (PRG file name or PRG data and displayed name)
+/// @return  True if the TAP file was written
+bool WriteAuthorTAPFile(const char *tap_file_name, vector<TAP_AUTHOR_FILE> &file_list)
+{
+    // Encode all files in parallel
+    std::atomic<size_t> next_file(0);
+    size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), file_list.size()));
+    vector<std::thread> threads;
 
-    uint32_t temp_address = (kernal_header_block.start_address_low | (kernal_header_block.start_address_high << 8));
-        
-    uint16_t end_adress = static_cast<uint16_t>(temp_address);
-    end_adress += static_cast<uint16_t>(prg_file_size);
-    kernal_header_block.end_address_low = static_cast<uint8_t>(end_adress & 0x00FF);
-    kernal_header_block.end_address_high = static_cast<uint8_t>((end_adress >> 8) & 0x00FF);
+    for(size_t i=0; i<thread_count; i++)
+    {
+        threads.push_back(std::thread([&file_list, &next_file]()
+        {
+            size_t file;
+            while((file = next_file++) < file_list.size())
+                EncodeAuthorFile(&file_list[file]);
+        }));
+    }
+    for(size_t i=0; i<threads.size(); i++)
+        threads[i].join();
+
+    // Join the files in order, with a pause between them (TAP version 1)
+    uint32_t file_gap_cycles = TAP_FILE_GAP_SECONDS * GetTimingCyclesPerSecond(timing_profile);
+    ByteVector file_gap;
+    file_gap.push_back(0x00);
+    for(int i=0; i<3; i++)
+        file_gap.push_back(static_cast<uint8_t>(file_gap_cycles >> (i * 8)));
+
+    vector<const ByteVector*> parts;
+    ByteVector tap_header;
+    uint32_t tap_data_size = 0;
+
+    parts.push_back(&tap_header);
+    for(size_t i=0; i<file_list.size(); i++)
+    {
+        if(!file_list[i].valid)
+            return false;
 
-    kernal_header_block.header_type = 0x01; // Kernal Header Block
-    memset(kernal_header_block.filename_dispayed, 0x20, sizeof(kernal_header_block.filename_dispayed));
-    memset(kernal_header_block.filename_not_displayed, 0x20, sizeof(kernal_header_block.filename_not_displayed));
+        if(i > 0)
+        {
+            parts.push_back(&file_gap);
+            tap_data_size += static_cast<uint32_t>(file_gap.size());
+        }
+        parts.push_back(&file_list[i].tap_data);
+        tap_data_size += static_cast<uint32_t>(file_list[i].tap_data.size());
 
-    const char *filename_displayed = "C64-TAP-TOOL";
-    const char *filename_not_displayed = "";
+        if(strcmp(tap_file_name, "-") != 0)
+            printf("File %d: %s (%s)\n", static_cast<int>(i), file_list[i].filename_displayed.c_str(), file_list[i].prg_file_name.c_str());
+    }
+    CreateTAPHeader(1, tap_data_size, tap_header, GetTimingVideoStandard(timing_profile));
 
-    strncpy(kernal_header_block.filename_dispayed, filename_displayed, strlen(filename_displayed));
-    strncpy(kernal_header_block.filename_not_displayed, filename_not_displayed, strlen(filename_not_displayed));
-   
-    // Write the Kernal Header Block to the WAV file
-    uint8_t crc = 0;
-    for(int i=0; i < (int)sizeof(kernal_header_block); i++)
+    if(!WriteOutputFile(tap_file_name, parts))
     {
-        crc ^= ((uint8_t*)&kernal_header_block)[i];
-        tap_data_size += WriteTAPByte(tap_stream, ((uint8_t*)&kernal_header_block)[i]);
+        printf("Error writing TAP file: %s\n", tap_file_name);
+        return false;
     }
-    tap_data_size += WriteTAPByte(tap_stream, crc);
 
-    // Write the EndOfData Maker
-    tap_data_size += WriteTAPLongPulse(tap_stream, 1); 
-    tap_data_size += WriteTAPShortPulse(tap_stream, 1);
+    return true;
+}
 
-    // Start with 79 short pulses
-    tap_data_size += WriteTAPShortPulse(tap_stream, 79);
+/// @brief  Convert several PRG files to one TAP file
+/// @param tap_file_name  Path to the TAP file, "-" writes to stdout
+/// @param prg_files  PRG files, optionally followed by '=' and the displayed name
+/// @return  True if the TAP file was written
+/// @note   Every file is encoded in its own buffer, the buffers are created in
+///         parallel on all cores and written in order. Between the files is a
+///         pause, therefore the TAP file has version 1.
+bool ConvertPRGsToTAP(const char *tap_file_name, const vector<const char*> &prg_files)
+{
+    vector<TAP_AUTHOR_FILE> file_list(prg_files.size());
 
-    // Countdown Sequence (backup)
-    for (uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+    for(size_t i=0; i<prg_files.size(); i++)
     {
-        tap_data_size += WriteTAPByte(tap_stream, countdown);
-    }
+        std::string prg_file = prg_files[i];
+        size_t separator = prg_file.find('=');
 
-    // Kernal Header Block (Backup)
-    crc = 0;
-    for(int i=0; i < (int)sizeof(kernal_header_block); i++)
-    {
-        crc ^= ((uint8_t*)&kernal_header_block)[i];
-        tap_data_size += WriteTAPByte(tap_stream, ((uint8_t*)&kernal_header_block)[i]);
+        if(separator != std::string::npos)
+        {
+            file_list[i].prg_file_name = prg_file.substr(0, separator);
+            file_list[i].filename_displayed = prg_file.substr(separator + 1, 16);
+        }
+        else
+        {
+            file_list[i].prg_file_name = prg_file;
+            file_list[i].filename_displayed = GetDisplayedPRGName(prg_file);
+        }
     }
-    tap_data_size += WriteTAPByte(tap_stream, crc);
 
-    // Start with 5671 short pulses (2sec Syncronisation)
-    tap_data_size += WriteTAPShortPulse(tap_stream, 5671);
+    return WriteAuthorTAPFile(tap_file_name, file_list);
+}
 
-    // Countdown Sequence (none backup)
-    for (uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+/// @brief  Convert all PRG files of a D64 image to one TAP file
+/// @param d64_file_name  Path to the D64 image
+/// @param tap_file_name  Path to the TAP file, "-" writes to stdout
+/// @return  True if the TAP file was written
+/// @note   The image is read once, the files are taken from their sector chains
+///         in memory and written with their original names (16 characters, PETSCII).
+bool ConvertD64ToTAP(const char *d64_file_name, const char *tap_file_name)
+{
+    ifstream d64_stream(d64_file_name, ios::binary);
+    if(!d64_stream.is_open())
     {
-        tap_data_size += WriteTAPByte(tap_stream, countdown);
+        printf("Error opening D64 file: %s\n", d64_file_name);
+        return false;
     }
 
-    // Kernal Data Block
-    // Write the PRG file data to the WAV file
-    crc = 0;
-    uint8_t byte;
-    for(int i=0; i < (int)prg_file_size; i++)
-    {
-        prg_stream.read(reinterpret_cast<char*>(&byte), 1);
-        crc ^= byte;
-        tap_data_size += WriteTAPByte(tap_stream, byte);
-    }
-    tap_data_size += WriteTAPByte(tap_stream, crc);
-    
-    // Write the EndOfData Maker        
-    tap_data_size += WriteTAPLongPulse(tap_stream, 1);
-    tap_data_size += WriteTAPShortPulse(tap_stream, 1);
+    d64_stream.seekg(0, ios::end);
+    streamoff d64_file_size = d64_stream.tellg();
+    d64_stream.seekg(0, ios::beg);
 
-    // Start with 79 short pulses (10sec Syncronisation)
-    tap_data_size += WriteTAPShortPulse(tap_stream, 79);    
+    ByteVector d64_data(static_cast<size_t>(d64_file_size));
+    d64_stream.read(reinterpret_cast<char*>(d64_data.data()), d64_file_size);
+    d64_stream.close();
 
-    // Countdown Sequence (backup)
-    for (uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+    D64ImageClass d64_image;
+    if(!d64_image.Load(d64_data.data(), d64_data.size()))
     {
-        tap_data_size += WriteTAPByte(tap_stream, countdown);
+        printf("D64 file is invalid: %s\n", d64_file_name);
+        return false;
     }
 
-    // Kernal Data Block (Backup)
-    prg_stream.seekg(2, ios::beg);
-    crc = 0;
-    for(int i=0; i < (int)prg_file_size; i++)
+    if(strcmp(tap_file_name, "-") != 0)
+        printf("Disk name: %s\n", d64_image.GetDiskName().c_str());
+
+    vector<TAP_AUTHOR_FILE> file_list;
+    for(const D64_FILE_ENTRY &file : d64_image.GetFiles())
     {
-        prg_stream.read(reinterpret_cast<char*>(&byte), 1);
-        crc ^= byte;
-        tap_data_size += WriteTAPByte(tap_stream, byte);
-    }
-    tap_data_size += WriteTAPByte(tap_stream, crc);
+        if((file.file_type & D64_FILE_TYPE_MASK) != D64_FILE_TYPE_PRG || (file.file_type & D64_FILE_CLOSED) == 0)
+            continue;
 
-    // Write the EndOfData Maker (Optional)
-    //tap_data_size += WriteTAPLongPulse(tap_stream, 1); 
-    //tap_data_size += WriteTAPShortPulse(tap_stream, 1);
+        TAP_AUTHOR_FILE author_file;
+        author_file.prg_file_name = d64_file_name;
+        author_file.filename_displayed = file.filename;
+        author_file.valid = false;
 
-    // Update the TAP Data Size
-    tap_stream.seekp(16, ios::beg);
-    tap_stream.write(reinterpret_cast<const char*>(&tap_data_size), 4); // TAP Data Size
+        if(!d64_image.ReadFile(file, author_file.prg_data) || author_file.prg_data.size() < 2)
+        {
+            printf("Skip damaged file: %s\n", file.filename.c_str());
+            continue;
+        }
 
-    prg_stream.close();
-    tap_stream.close();
+        file_list.push_back(author_file);
+    }
 
-    return true;
+    if(file_list.empty())
+    {
+        printf("No PRG files in the D64 image: %s\n", d64_file_name);
+        return false;
+    }
+
+    return WriteAuthorTAPFile(tap_file_name, file_list);
 }
 
 // Funktion zum Erstellen des WAV-Headers
-void WriteWAVHeader(std::ofstream &wav_file, uint32_t sample_rate, uint32_t num_samples) {
-    uint32_t byte_rate = sample_rate * sizeof(float); // Mono, Float
-    uint16_t block_align = sizeof(float);            // Mono, Float
-    uint32_t data_chunk_size = num_samples * sizeof(float);
-    uint32_t file_size = 36 + data_chunk_size;
+// sample_format: WAV_SAMPLE_FORMAT (Float, 16 bit PCM, 8 bit PCM)
+void WriteWAVHeader(std::ostream &wav_file, uint32_t sample_rate, uint32_t num_samples, int sample_format = WAV_FORMAT_FLOAT) {
+    uint16_t bits_per_sample = sample_format == WAV_FORMAT_PCM8 ? 8 : sample_format == WAV_FORMAT_PCM16 ? 16 : 32;
+    uint32_t byte_rate = sample_rate * bits_per_sample / 8; // Mono
+    uint16_t block_align = bits_per_sample / 8;             // Mono
+    uint32_t data_chunk_size = num_samples * block_align;
+    uint32_t file_size = 36 + data_chunk_size + (data_chunk_size & 1); // Chunks have an even size (pad byte)
 
     // WAV-Header schreiben
     wav_file.write("RIFF", 4);                        // Chunk ID
@@ -835,278 +2961,528 @@ void WriteWAVHeader(std::ofstream &wav_file, uint32_t sample_rate, uint32_t num_
     wav_file.write("fmt ", 4);                        // Subchunk1 ID
     uint32_t subchunk1_size = 16;                     // Subchunk1 Size
     wav_file.write(reinterpret_cast<const char*>(&subchunk1_size), 4);
-    uint16_t audio_format = 3;                        // Audio Format (3 = Float)
+    uint16_t audio_format = sample_format == WAV_FORMAT_FLOAT ? 3 : 1;  // Audio Format (3 = Float, 1 = PCM)
     wav_file.write(reinterpret_cast<const char*>(&audio_format), 2);
     uint16_t num_channels = 1;                        // Mono
     wav_file.write(reinterpret_cast<const char*>(&num_channels), 2);
     wav_file.write(reinterpret_cast<const char*>(&sample_rate), 4); // Sample Rate
     wav_file.write(reinterpret_cast<const char*>(&byte_rate), 4);   // Byte Rate
     wav_file.write(reinterpret_cast<const char*>(&block_align), 2); // Block Align
-    uint16_t bits_per_sample = 32;                    // Float = 32 bits
     wav_file.write(reinterpret_cast<const char*>(&bits_per_sample), 2);
     wav_file.write("data", 4);                        // Subchunk2 ID
     wav_file.write(reinterpret_cast<const char*>(&data_chunk_size), 4); // Subchunk2 Size
 }
 
-inline uint32_t WriteWAVShortPulse(std::ofstream &wav_stream, uint32_t sample_rate, uint32_t pulse_count, float amplitude = 1.0f) 
+/// @brief  Prepare the wave table for the WAV settings (--wav-rate, --wav-format, --wav-square)
+/// @param wave_table  Wave table
+/// @param profile  Timing profile (TIMING_PROFILE)
+void CreateWAVWaveTable(WAVWaveTableClass &wave_table, int profile)
 {
-    const float frequency = 2737.0f; // Frequenz des Shortpulses in Hz
-    const uint32_t samples_per_period = static_cast<uint32_t>(static_cast<float>(sample_rate) / frequency);
+    CallWithTimingProfile(profile, [&](auto timing)
+    {
+        typedef decltype(timing) TIMING;
+        wave_table.Create(wav_sample_rate, TIMING::cycles_per_second, TIMING::short_pulse_length, TIMING::medium_pulse_length, TIMING::long_pulse_length, wav_sample_format, wav_waveform);
+    });
+}
 
-    for (uint32_t pulse = 0; pulse < pulse_count; ++pulse) {
-        for (uint32_t sample = 0; sample < samples_per_period; ++sample) {
-            float t = static_cast<float>(sample) / static_cast<float>(sample_rate); // Zeit in Sekunden
-            float value = amplitude * sinf(2.0f * static_cast<float>(M_PI) * frequency * t) *-1.0f; // Invert the signal for short pulse
-            wav_stream.write(reinterpret_cast<const char*>(&value), sizeof(float));
-        }
-    }
+// Parts of the parallel WAV rendering, a segment of the tape program is split into parts of at most this number of pulses
+#define WAV_RENDER_PART_PULSES 32768
 
-    return pulse_count * samples_per_period;
-}
+/// @brief  Part of a tape program which is rendered by one thread
+struct WAV_RENDER_PART
+{
+    uint32_t segment;       // Index of the tape segment
+    uint32_t first;         // First pulse or byte of the segment
+    uint32_t count;         // Number of pulses or bytes
+    uint64_t start_cycles;  // Tape position of the part
+    uint64_t end_cycles;
+};
 
-inline uint32_t WriteWAVMediumPulse(std::ofstream &wav_stream, uint32_t sample_rate, uint32_t pulse_count, float amplitude = 1.0f) 
+/// @brief  Render a part of a tape program as WAV samples
+/// @param wave_table  Waveforms of the pulses (sample rate and format of the WAV file)
+/// @param program  Tape program
+/// @param part  Part of the program
+/// @param wav_data  Samples of the part
+/// @return  Index of the first sample of the part in the WAV data
+/// @note   The phase accumulator is set from the tape position of the part, so the samples are the
+///         same as if the tape was rendered from the start.
+uint64_t RenderWAVPart(WAVWaveTableClass &wave_table, const TapeProgramClass &program, const WAV_RENDER_PART &part, ByteVector &wav_data)
 {
-    const float frequency = 1882.0f; // Frequenz des Mediumpulses in Hz
-    const uint32_t samples_per_period = static_cast<uint32_t>(static_cast<float>(sample_rate) / frequency);
+    const TAPE_SEGMENT &segment = program.GetSegments()[part.segment];
+    const uint8_t *bytes = program.GetBytes() + segment.byte_offset + part.first;
+    const uint32_t sample_size = wave_table.GetSampleSize();
 
-    for (uint32_t pulse = 0; pulse < pulse_count; ++pulse) {
-        for (uint32_t sample = 0; sample < samples_per_period; ++sample) {
-            float t = static_cast<float>(sample) / static_cast<float>(sample_rate); // Zeit in Sekunden
-            float value = amplitude * sinf(2.0f * static_cast<float>(M_PI) * frequency * t) *-1.0f; // Invert the signal for medium pulse
-            wav_stream.write(reinterpret_cast<const char*>(&value), sizeof(float));
-        }
-    }
+    uint64_t start_sample = wave_table.SetTapePosition(part.start_cycles);
+    wav_data.resize(static_cast<size_t>(wave_table.GetSampleCount(part.end_cycles) - start_sample) * sample_size);
+    uint8_t *samples = wav_data.data();
 
-    return pulse_count * samples_per_period;
-}
+    uint32_t num_samples = 0;
+    switch(segment.type)
+    {
+    case TAPE_SEGMENT_PULSES:
+        num_samples += wave_table.WritePulses(segment.pulse_length, part.count, samples);
+        break;
 
-inline uint32_t WriteWAVLongPulse(std::ofstream &wav_stream, uint32_t sample_rate, uint32_t pulse_count, float amplitude = 1.0f) 
-{
-    const float frequency = 1434.0f; // Frequenz des Longpulses in Hz
-    const uint32_t samples_per_period = static_cast<uint32_t>(static_cast<float>(sample_rate) / frequency);
+    case TAPE_SEGMENT_KERNAL_BYTES:
+        num_samples += wave_table.WriteKernalBytes(bytes, part.count, samples);
+        break;
 
-    for (uint32_t pulse = 0; pulse < pulse_count; ++pulse) {
-        for (uint32_t sample = 0; sample < samples_per_period; ++sample) {
-            float t = static_cast<float>(sample) / static_cast<float>(sample_rate); // Zeit in Sekunden
-            float value = amplitude * sinf(2.0f * static_cast<float>(M_PI) * frequency * t) *-1.0f; // Invert the signal for long pulse
-            wav_stream.write(reinterpret_cast<const char*>(&value), sizeof(float));
+    case TAPE_SEGMENT_TURBO_BYTES:
+        for(uint32_t i=0; i<part.count; i++)
+        {
+            for(int j=7; j>=0; j--)
+                num_samples += wave_table.WritePulses((bytes[i] >> j) & 1 ? TURBO_BIT1_PULSE_LENGTH : TURBO_BIT0_PULSE_LENGTH, 1, samples + num_samples * sample_size);
         }
+        break;
     }
 
-    return pulse_count * samples_per_period;
+    return start_sample;
 }
 
-inline uint32_t WriteWAVByte(std::ofstream &wav_stream, uint32_t sample_rate, uint8_t byte, float amplitude = 1.0f) 
+/// @brief  Render a tape program as WAV file (mono, float or integer PCM, sine or square wave) and write it
+/// @param wav_file_name  Path to the WAV file
+/// @param program  Tape program
+/// @return  True if the WAV file was written
+/// @note   The number of samples of every pulse is known from the tape position, so the
+///         place of every part in the WAV file is known before the rendering. The parts
+///         (leaders, header and data copies, split into at most WAV_RENDER_PART_PULSES
+///         pulses) are rendered by a thread per core, every thread has its own wave
+///         table and gives its parts to the writer thread, which writes them with
+///         pwrite into the file of the final size.
+bool WriteWAVProgramFile(const char *wav_file_name, const TapeProgramClass &program)
 {
-    uint32_t num_samples = 0;
+    WAVWaveTableClass wave_table;
+    CreateWAVWaveTable(wave_table, program.GetTimingProfile());
+    const uint32_t sample_size = wave_table.GetSampleSize();
 
-    // Write the byte in the WAV file
-    // ByteMaker (Long Pulse + Medium Pulse)
-    num_samples += WriteWAVLongPulse(wav_stream, sample_rate, 1, amplitude);
-    num_samples += WriteWAVMediumPulse(wav_stream, sample_rate, 1, amplitude);
+    // Tape positions of all parts
+    const vector<TAPE_SEGMENT> &segments = program.GetSegments();
+    vector<WAV_RENDER_PART> parts;
+    uint64_t cycles = 0;
 
-    // Write the bits of the byte (LSB first)
-    uint8_t parity_bit = 1;
-    for (int i = 0; i < 8; ++i)     
+    for(uint32_t i=0; i<segments.size(); i++)
     {
-        if (byte & (1 << i)) 
-        {
-            // Bit is 1
-            num_samples += WriteWAVMediumPulse(wav_stream, sample_rate, 1, amplitude);
-            num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 1, amplitude);
-            parity_bit ^= 1;
-        } else 
+        uint32_t pulses_per_unit = segments[i].type == TAPE_SEGMENT_PULSES ? 1 : segments[i].type == TAPE_SEGMENT_KERNAL_BYTES ? TAP_PULSES_PER_BYTE : 8;
+        uint32_t max_count = WAV_RENDER_PART_PULSES / pulses_per_unit;
+
+        for(uint32_t first=0; first<segments[i].count; first+=max_count)
         {
-            // Bit is 0
-            num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 1, amplitude);
-            num_samples += WriteWAVMediumPulse(wav_stream, sample_rate, 1, amplitude);
+            WAV_RENDER_PART part;
+            part.segment = i;
+            part.first = first;
+            part.count = std::min(max_count, segments[i].count - first);
+            part.start_cycles = cycles;
+            cycles += program.GetSegmentCycles(segments[i], part.first, part.count);
+            part.end_cycles = cycles;
+            parts.push_back(part);
         }
     }
-    // Write the parity bit (odd parity)
-    if (parity_bit == 1) 
+
+    uint64_t num_samples = wave_table.GetSampleCount(cycles);
+    uint64_t data_size = num_samples * sample_size;
+    if(data_size > 0xFFFFFFFFULL - 36 - 1)
     {
-        num_samples += WriteWAVMediumPulse(wav_stream, sample_rate, 1, amplitude);
-        num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 1, amplitude);
-    } else 
+        printf("WAV file is larger than 4 GB, use a lower sample rate or a smaller sample format: %s\n", wav_file_name);
+        return false;
+    }
+
+    // WAV Header, the samples are written behind it at their positions
+    std::ostringstream wav_header;
+    WriteWAVHeader(wav_header, wav_sample_rate, static_cast<uint32_t>(num_samples), wav_sample_format);
+    const std::string header = wav_header.str();
+    const uint64_t data_start = header.size();
+
+    AsyncWriterClass writer;
+    if(!writer.Open(wav_file_name))
     {
-        num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 1, amplitude);
-        num_samples += WriteWAVMediumPulse(wav_stream, sample_rate, 1, amplitude);
+        printf("Error opening WAV file: %s\n", wav_file_name);
+        return false;
     }
+    bool ok = writer.SetFileSize(data_start + data_size + (data_size & 1));
+    writer.Write(reinterpret_cast<const uint8_t*>(header.data()), header.size(), 0);
 
-    return num_samples;
-}
+    std::atomic<size_t> next_part(0);
+    size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), parts.size()));
+    vector<std::thread> threads;
 
-bool ConvertPRGToWAV(const char *prg_file_name, const char *wav_file_name)
-{
-    // TODO: Implement the conversion from PRG to TAP
-    // TAP write 
-    // C64 PAL Frquency: 985248 Hz
-    // ● a short 365.4µs pulse (2737 Hz) PAL - 360 Takte    
-    // ● a medium 531.4µs pulse (1882Hz) PAL - 524 Takte
-    // ● a long 697.6µs pulse (1434 Hz) PAL - 687 Takte
+    for(size_t i=0; ok && i<thread_count; i++)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            WAVWaveTableClass thread_wave_table;
+            CreateWAVWaveTable(thread_wave_table, program.GetTimingProfile());
 
-    // 1. Short pulse (27135)
-    // 2. Countdown Sequence 0x89 0x88 0x87 0x86 0x85 0x84 0x83 0x82 0x81
-    // 3. Kernal Header Block
-    // 3a. EndOfData Maker
-    // 4. Short pulse (79)
-    // 5. Countdown Sequence 0x09 0x08 0x07 0x06 0x05 0x04 0x03 0x02 0x01
-    // 6. Kernal Header Block (Backup)
-    // 7. Short pulse (5671)
-    // 9. Countdown Sequence 0x89 0x88 0x87 0x86 0x85 0x84 0x83 0x82 0x81
-    // 10. Kernal Data Block
-    // 10a. EndOfData Maker
-    // 11. Short pulse (79)
-    // 12. Countdown Sequence 0x09 0x08 0x07 0x06 0x05 0x04 0x03 0x02 0x01
-    // 13. Kernal Data Block (Backup)
+            size_t part;
+            while(!writer.HasError() && (part = next_part++) < parts.size())
+            {
+                ByteVector &wav_data = writer.GetBuffer();
+                uint64_t start_sample = RenderWAVPart(thread_wave_table, program, parts[part], wav_data);
+                writer.Submit(wav_data, wav_data.size(), data_start + start_sample * sample_size);
+            }
+        }));
+    }
+    for(size_t i=0; i<threads.size(); i++)
+        threads[i].join();
 
-    ifstream prg_stream;
-    ofstream wav_stream;
-    prg_stream.open(prg_file_name, ios::binary);
-    if(!prg_stream.is_open())
+    if(!writer.Close() || !ok)
     {
-        printf("Error opening PRG file: %s\n", prg_file_name);
+        printf("Error writing WAV file: %s\n", wav_file_name);
         return false;
     }
 
-    // PRG file size    
-    prg_stream.seekg(0, ios::end);
-    streamoff prg_file_size = prg_stream.tellg();
-    prg_stream.seekg(0, ios::beg);
+    return true;
+}
 
-    wav_stream.open(wav_file_name, ios::binary);
-    if(!wav_stream.is_open())
+// Size of the chunks of --play, 4096 samples are 93 ms at 44100 Hz
+#define WAV_PLAY_CHUNK_SAMPLES 4096
+
+/// @brief  Render a tape program as raw samples (without WAV header) and stream them to stdout
+/// @param program  Tape program
+/// @return  True if all samples could be written
+/// @note   The samples are given to the writer thread in chunks of WAV_PLAY_CHUNK_SAMPLES as
+///         soon as they are rendered, a player can start at once and the tape is never in
+///         memory as a whole. The buffer has room for the longest pulse (or kernal byte)
+///         behind a chunk, these samples are the start of the next chunk.
+bool PlayWAVProgram(const TapeProgramClass &program)
+{
+    WAVWaveTableClass wave_table;
+    CreateWAVWaveTable(wave_table, program.GetTimingProfile());
+    wave_table.ResetPhase();
+    const uint32_t sample_size = wave_table.GetSampleSize();
+
+    // A kernal byte has 20 pulses (sync, 8 bits and parity), a turbo byte 8 pulses
+    const uint32_t byte_samples = wave_table.GetMaxPulseSamples(256 * 8) * 20;
+    uint32_t reserve = byte_samples;
+    for(const TAPE_SEGMENT &segment : program.GetSegments())
     {
-        printf("Error opening WAV file: %s\n", wav_file_name);
-        prg_stream.close();
-        return false;
+        if(segment.type == TAPE_SEGMENT_PULSES)
+            reserve = std::max(reserve, wave_table.GetMaxPulseSamples(segment.pulse_length));
     }
 
-    // WAV Header
-    uint32_t sample_rate = 44100; // Sample rate in Hz
-    uint32_t num_samples = 0; // Number of samples in the WAV file
-    WriteWAVHeader(wav_stream, sample_rate, num_samples);
+    AsyncWriterClass writer;
+    if(!writer.Open("-"))
+        return false;
 
-    // Create the WAV File for the C64
-    // Start with 27135 short pulses (10sec Syncronisation)
-    num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 27135);
+    const uint32_t chunk_limit = WAV_PLAY_CHUNK_SAMPLES + reserve;
+    ByteVector *chunk = &writer.GetBuffer();
+    chunk->resize(static_cast<size_t>(chunk_limit) * sample_size);
+    uint32_t chunk_samples = 0;
 
-    // Countdown Sequence (none backup)
-    for (uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+    const uint8_t *bytes = program.GetBytes();
+
+    for(const TAPE_SEGMENT &segment : program.GetSegments())
     {
-        num_samples += WriteWAVByte(wav_stream, sample_rate, countdown);
+        uint32_t done = 0;
+        while(!writer.HasError() && done < segment.count)
+        {
+            // As many pulses or bytes as fit behind the samples of the buffer, at least one
+            uint8_t *samples = chunk->data() + static_cast<size_t>(chunk_samples) * sample_size;
+            uint32_t count;
+            switch(segment.type)
+            {
+            case TAPE_SEGMENT_PULSES:
+                count = std::min(segment.count - done, (chunk_limit - chunk_samples) / wave_table.GetMaxPulseSamples(segment.pulse_length));
+                chunk_samples += wave_table.WritePulses(segment.pulse_length, count, samples);
+                break;
+
+            case TAPE_SEGMENT_KERNAL_BYTES:
+                count = std::min(segment.count - done, (chunk_limit - chunk_samples) / byte_samples);
+                chunk_samples += wave_table.WriteKernalBytes(bytes + segment.byte_offset + done, count, samples);
+                break;
+
+            default:
+                {
+                    count = 1;
+                    uint8_t byte = bytes[segment.byte_offset + done];
+                    for(int j=7; j>=0; j--)
+                        chunk_samples += wave_table.WritePulses((byte >> j) & 1 ? TURBO_BIT1_PULSE_LENGTH : TURBO_BIT0_PULSE_LENGTH, 1, chunk->data() + static_cast<size_t>(chunk_samples) * sample_size);
+                }
+                break;
+            }
+            done += count;
+
+            // Complete chunks to the writer, the samples behind a chunk start the next buffer
+            while(chunk_samples >= WAV_PLAY_CHUNK_SAMPLES)
+            {
+                ByteVector *next_chunk = &writer.GetBuffer();
+                next_chunk->resize(static_cast<size_t>(chunk_limit) * sample_size);
+                chunk_samples -= WAV_PLAY_CHUNK_SAMPLES;
+                memcpy(next_chunk->data(), chunk->data() + static_cast<size_t>(WAV_PLAY_CHUNK_SAMPLES) * sample_size, static_cast<size_t>(chunk_samples) * sample_size);
+                writer.Submit(*chunk, static_cast<size_t>(WAV_PLAY_CHUNK_SAMPLES) * sample_size);
+                chunk = next_chunk;
+            }
+        }
     }
 
-    // Kernal Header Block
-    KERNAL_HEADER_BLOCK kernal_header_block;
-    prg_stream.read(reinterpret_cast<char*>(&kernal_header_block.start_address_low), 1);
-    prg_stream.read(reinterpret_cast<char*>(&kernal_header_block.start_address_high), 1);
-    prg_file_size -= 2;
+    writer.Submit(*chunk, static_cast<size_t>(chunk_samples) * sample_size);
+    return writer.Close();
+}
 
-    uint32_t temp_address = (kernal_header_block.start_address_low | (kernal_header_block.start_address_high << 8));
-        
-    uint16_t end_adress = static_cast<uint16_t>(temp_address);
-    end_adress += static_cast<uint16_t>(prg_file_size);
-    kernal_header_block.end_address_low = static_cast<uint8_t>(end_adress & 0x00FF);
-    kernal_header_block.end_address_high = static_cast<uint8_t>((end_adress >> 8) & 0x00FF);
+/// @brief  Stream a PRG file as raw samples to stdout (--play)
+/// @param prg_file_name  Path to the PRG file
+/// @return  True if all samples could be written
+bool PlayPRG(const char *prg_file_name)
+{
+    ByteVector prg_data;
+    if(!ReadPRGFile(prg_file_name, prg_data))
+        return false;
 
-    kernal_header_block.header_type = 0x01; // Kernal Header Block
-    memset(kernal_header_block.filename_dispayed, 0x20, sizeof(kernal_header_block.filename_dispayed));
-    memset(kernal_header_block.filename_not_displayed, 0x20, sizeof(kernal_header_block.filename_not_displayed));
+    TapeProgramClass program;
+    EncodeTAPFile(prg_data, "C64-TAP-TOOL", program);
+
+    return PlayWAVProgram(program);
+}
 
-    const char *filename_displayed = "C64-TAP-TOOL";
-    const char *filename_not_displayed = "";
+// Size of the blocks in which a TAP file is read by --tap2wav
+#define TAP_STREAM_BUFFER_SIZE (1024 * 1024)
 
-    strncpy(kernal_header_block.filename_dispayed, filename_displayed, strlen(filename_displayed));
-    strncpy(kernal_header_block.filename_not_displayed, filename_not_displayed, strlen(filename_not_displayed));
-   
-    // Write the Kernal Header Block to the WAV file
-    uint8_t crc = 0;
-    for(int i=0; i < (int)sizeof(kernal_header_block); i++)
+/// @brief  Block of a TAP file which is converted to WAV by one thread
+struct TAP_WAV_BLOCK
+{
+    uint64_t file_offset;   // Position of the block in the TAP file
+    uint32_t size;          // Size of the block, a pause (4 bytes) is never split
+    uint64_t start_cycles;  // Tape position of the first pulse
+};
+
+/// @brief  Find the blocks of a TAP file and the tape position of every block
+/// @param tap_stream  TAP file, behind the TAP header
+/// @param version  TAP version
+/// @param blocks  Blocks of the TAP data
+/// @param cycles  Length of the tape in cycles
+/// @return  False if the TAP file could not be read to the end
+bool FindTAPWAVBlocks(std::ifstream &tap_stream, uint8_t version, vector<TAP_WAV_BLOCK> &blocks, uint64_t &cycles)
+{
+    ByteVector tap_buffer(TAP_STREAM_BUFFER_SIZE + 4);
+    uint32_t tap_bytes = 0;
+    uint64_t file_offset = TAP_DATA_START;
+    bool tap_end = false;
+
+    cycles = 0;
+
+    while(!tap_end)
     {
-        crc ^= ((uint8_t*)&kernal_header_block)[i];
-        num_samples += WriteWAVByte(wav_stream, sample_rate, ((uint8_t*)&kernal_header_block)[i]);
+        tap_stream.read(reinterpret_cast<char*>(tap_buffer.data() + tap_bytes), TAP_STREAM_BUFFER_SIZE - tap_bytes);
+        tap_bytes += static_cast<uint32_t>(tap_stream.gcount());
+        tap_end = tap_stream.eof();
+
+        // A read error sets failbit or badbit without eof, the end would never be reached
+        if(tap_stream.bad() || (tap_stream.fail() && !tap_end))
+            return false;
+
+        TAP_WAV_BLOCK block;
+        block.file_offset = file_offset;
+        block.start_cycles = cycles;
+
+        uint32_t pos = 0;
+        while(pos < tap_bytes)
+        {
+            if(version == 1 && tap_buffer[pos] == 0x00 && pos + 4 > tap_bytes)
+            {
+                if(!tap_end)
+                    break;
+                // Incomplete pause at the end of the file
+                pos = tap_bytes;
+                break;
+            }
+
+            cycles += GetTAPPulseLength(tap_buffer.data(), pos, version);
+            pos++;
+        }
+
+        block.size = pos;
+        if(pos > 0)
+            blocks.push_back(block);
+        file_offset += pos;
+
+        // Rest of the block (begin of a pause) to the start of the buffer
+        memmove(tap_buffer.data(), tap_buffer.data() + pos, tap_bytes - pos);
+        tap_bytes -= pos;
     }
-    num_samples += WriteWAVByte(wav_stream, sample_rate, crc);
 
-    // Write the EndOfData Maker
-    num_samples += WriteWAVLongPulse(wav_stream, sample_rate, 1); 
-    num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 1);
+    return true;
+}
 
-    // Start with 79 short pulses (10sec Syncronisation)
-    num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 79);
+/// @brief  Convert a block of a TAP file to WAV samples and write them at their position in the WAV file
+/// @param wave_table  Waveforms of the pulses
+/// @param tap_data  TAP data of the block
+/// @param block  Block
+/// @param version  TAP version
+/// @param writer  WAV file, the samples are written in buffers of WAV_STREAM_BUFFER_SAMPLES
+/// @param data_start  Position of the samples in the WAV file
+void ConvertTAPWAVBlock(WAVWaveTableClass &wave_table, const uint8_t *tap_data, const TAP_WAV_BLOCK &block, uint8_t version, AsyncWriterClass &writer, uint64_t data_start)
+{
+    const uint32_t sample_size = wave_table.GetSampleSize();
+    const uint32_t buffer_limit = WAV_STREAM_BUFFER_SAMPLES - wave_table.GetMaxPulseSamples(256 * 8);
+    uint64_t sample_pos = wave_table.SetTapePosition(block.start_cycles);
+    uint32_t buffer_samples = 0;
 
+    ByteVector *wav_buffer = &writer.GetBuffer();
+    wav_buffer->resize(static_cast<size_t>(WAV_STREAM_BUFFER_SAMPLES) * sample_size);
 
-    // Countdown Sequence (backup)
-    for (uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+    // The full buffer to the writer thread, the next pulses go into a free buffer
+    auto submit_buffer = [&]()
+    {
+        writer.Submit(*wav_buffer, static_cast<size_t>(buffer_samples) * sample_size, data_start + sample_pos * sample_size);
+        sample_pos += buffer_samples;
+        buffer_samples = 0;
+        wav_buffer = &writer.GetBuffer();
+        wav_buffer->resize(static_cast<size_t>(WAV_STREAM_BUFFER_SAMPLES) * sample_size);
+    };
+
+    uint32_t pos = 0;
+    while(pos < block.size)
     {
-        num_samples += WriteWAVByte(wav_stream, sample_rate, countdown);
+        // Incomplete pause at the end of the file
+        if(version == 1 && tap_data[pos] == 0x00 && pos + 4 > block.size)
+            break;
+
+        bool pause = version == 1 && tap_data[pos] == 0x00;
+        uint32_t pulse_length = GetTAPPulseLength(tap_data, pos, version);
+        pos++;
+
+        if(pause)
+        {
+            // Silence, written in parts of the buffer
+            uint64_t pause_samples = wave_table.SkipCycles(pulse_length);
+            while(pause_samples > 0)
+            {
+                uint32_t samples = static_cast<uint32_t>(std::min<uint64_t>(pause_samples, WAV_STREAM_BUFFER_SAMPLES - buffer_samples));
+                wave_table.WriteSilence(wav_buffer->data() + buffer_samples * sample_size, samples);
+                buffer_samples += samples;
+                pause_samples -= samples;
+
+                if(buffer_samples == WAV_STREAM_BUFFER_SAMPLES)
+                    submit_buffer();
+            }
+        }
+        else
+            buffer_samples += wave_table.WritePulses(pulse_length, 1, wav_buffer->data() + buffer_samples * sample_size);
+
+        if(buffer_samples >= buffer_limit)
+            submit_buffer();
     }
 
-    // Kernal Header Block (Backup)
-    crc = 0;
-    for(int i=0; i < (int)sizeof(kernal_header_block); i++)
+    writer.Submit(*wav_buffer, static_cast<size_t>(buffer_samples) * sample_size, data_start + sample_pos * sample_size);
+}
+
+/// @brief  Convert a TAP file (version 0 or 1) to a WAV file
+/// @param tap_file_name  Path to the TAP file
+/// @param wav_file_name  Path to the WAV file
+/// @return  True if the WAV file was written
+/// @note   Every pulse of the TAP file is written with its exact length (phase accumulator),
+///         a pause of TAP version 1 is written as silence. A first pass finds the tape
+///         position of every block of the TAP file, then the blocks are converted by a
+///         thread per core and given to the writer thread, which writes them with pwrite
+///         at their position. Every thread reads its blocks with its own stream, the sample buffers
+///         are a ring of the writer, so the memory stays the same for every size of the
+///         TAP file.
+bool ConvertTAPToWAVFile(const char *tap_file_name, const char *wav_file_name)
+{
+    std::ifstream tap_stream(tap_file_name, ios::binary);
+    if(!tap_stream.is_open())
     {
-        crc ^= ((uint8_t*)&kernal_header_block)[i];
-        num_samples += WriteWAVByte(wav_stream, sample_rate, ((uint8_t*)&kernal_header_block)[i]);
+        printf("Error opening TAP file: %s\n", tap_file_name);
+        return false;
     }
-    num_samples += WriteWAVByte(wav_stream, sample_rate, crc);
 
-    // Start with 5671 short pulses (10sec Syncronisation)
-    num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 5671);
-
-    // Countdown Sequence (none backup)
-    for (uint8_t countdown = 0x89; countdown >= 0x81; countdown--)
+    uint8_t tap_header[TAP_DATA_START];
+    tap_stream.read(reinterpret_cast<char*>(tap_header), TAP_DATA_START);
+    if(tap_stream.gcount() != TAP_DATA_START || !IsTAPFile(tap_header, TAP_DATA_START) || tap_version > 1)
     {
-        num_samples += WriteWAVByte(wav_stream, sample_rate, countdown);
+        printf("TAP file is invalid (version 0 or 1): %s\n", tap_file_name);
+        return false;
     }
+    uint8_t version = tap_version;
 
-    // Kernal Data Block
-    // Write the PRG file data to the WAV file
-    crc = 0;
-    uint8_t byte;
-    for(int i=0; i < (int)prg_file_size; i++)
+    vector<TAP_WAV_BLOCK> blocks;
+    uint64_t cycles;
+    if(!FindTAPWAVBlocks(tap_stream, version, blocks, cycles))
     {
-        prg_stream.read(reinterpret_cast<char*>(&byte), 1);
-        crc ^= byte;
-        num_samples += WriteWAVByte(wav_stream, sample_rate, byte);
+        printf("Error reading TAP file: %s\n", tap_file_name);
+        return false;
     }
-    num_samples += WriteWAVByte(wav_stream, sample_rate, crc);
-    
-    // Write the EndOfData Maker        
-    num_samples += WriteWAVLongPulse(wav_stream, sample_rate, 1);
-    num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 1);
+    tap_stream.close();
 
-    // Start with 79 short pulses (10sec Syncronisation)
-    num_samples += WriteWAVShortPulse(wav_stream, sample_rate, 79);    
+    WAVWaveTableClass wave_table;
+    CreateWAVWaveTable(wave_table, timing_profile);
+    const uint32_t sample_size = wave_table.GetSampleSize();
 
-    // Countdown Sequence (backup)
-    for (uint8_t countdown = 0x09; countdown >= 0x01; countdown--)
+    uint64_t num_samples = wave_table.GetSampleCount(cycles);
+    uint64_t data_size = num_samples * sample_size;
+    if(data_size > 0xFFFFFFFFULL - 36 - 1)
     {
-        num_samples += WriteWAVByte(wav_stream, sample_rate, countdown);
+        printf("WAV file is larger than 4 GB, use a lower sample rate or a smaller sample format: %s\n", wav_file_name);
+        return false;
     }
 
-    // Kernal Data Block (Backup)
-    prg_stream.seekg(2, ios::beg);
-    crc = 0;
-    for(int i=0; i < (int)prg_file_size; i++)
+    // WAV Header, the samples are written behind it at their positions
+    std::ostringstream wav_header;
+    WriteWAVHeader(wav_header, wav_sample_rate, static_cast<uint32_t>(num_samples), wav_sample_format);
+    const std::string header = wav_header.str();
+    const uint64_t data_start = header.size();
+
+    AsyncWriterClass writer;
+    if(!writer.Open(wav_file_name))
     {
-        prg_stream.read(reinterpret_cast<char*>(&byte), 1);
-        crc ^= byte;
-        num_samples += WriteWAVByte(wav_stream, sample_rate, byte);
+        printf("Error opening WAV file: %s\n", wav_file_name);
+        return false;
     }
-    num_samples += WriteWAVByte(wav_stream, sample_rate, crc);
 
-    // Write the EndOfData Maker (Optional)
-    //num_samples += WriteTAPLongPulse(tap_stream, 1); 
-    //num_samples += WriteTAPShortPulse(tap_stream, 1);
+    bool ok = writer.SetFileSize(data_start + data_size + (data_size & 1));
+    writer.Write(reinterpret_cast<const uint8_t*>(header.data()), header.size(), 0);
 
-    // Update the WAV header with the correct data chunk size
-    wav_stream.seekp(0, ios::beg);
-    WriteWAVHeader(wav_stream, sample_rate, num_samples);
+    std::atomic<size_t> next_block(0);
+    std::atomic<bool> read_ok(ok);
+    size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), blocks.size()));
+    vector<std::thread> threads;
 
-    prg_stream.close();
-    wav_stream.close();
-    
+    for(size_t i=0; ok && i<thread_count; i++)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            WAVWaveTableClass thread_wave_table;
+            CreateWAVWaveTable(thread_wave_table, timing_profile);
+            ByteVector tap_data(TAP_STREAM_BUFFER_SIZE);
+
+            // Every thread has its own stream, so the blocks are read without a lock
+            std::ifstream thread_tap_stream(tap_file_name, ios::binary);
+            if(!thread_tap_stream.is_open())
+                read_ok = false;
+
+            size_t block;
+            while(read_ok && !writer.HasError() && (block = next_block++) < blocks.size())
+            {
+                thread_tap_stream.seekg(static_cast<streamoff>(blocks[block].file_offset));
+                thread_tap_stream.read(reinterpret_cast<char*>(tap_data.data()), blocks[block].size);
+                if(thread_tap_stream.gcount() != static_cast<streamsize>(blocks[block].size))
+                    read_ok = false;
+                else
+                    ConvertTAPWAVBlock(thread_wave_table, tap_data.data(), blocks[block], version, writer, data_start);
+            }
+        }));
+    }
+    for(size_t i=0; i<threads.size(); i++)
+        threads[i].join();
+
+    if(!writer.Close() || !read_ok)
+    {
+        printf("Error writing WAV file: %s\n", wav_file_name);
+        return false;
+    }
+
+    printf("%llu samples written to: %s\n", static_cast<unsigned long long>(num_samples), wav_file_name);
     return true;
-}
\ No newline at end of file
+}
+
+bool ConvertPRGToWAV(const char *prg_file_name, const char *wav_file_name)
+{
+    // The same tape program as for the TAP file is rendered as sine waves
+    ByteVector prg_data;
+    if(!ReadPRGFile(prg_file_name, prg_data))
+        return false;
+
+    TapeProgramClass program;
+    EncodeTAPFile(prg_data, "C64-TAP-TOOL", program);
+
+    return WriteWAVProgramFile(wav_file_name, program);
+}
@@ -0,0 +1,156 @@
+#include "./pcm_pulse_detector_class.h"
+#include <math.h>
+#include <algorithm>
+
+PCMPulseDetectorClass::PCMPulseDetectorClass()
+{
+    Create(44100, WAV_FORMAT_TAG_PCM, 16, 1, TAP_CYCLES_PER_SECOND);
+}
+
+/// @brief  Set the format of the samples and start a new stream
+/// @param new_sample_rate  Sample rate in Hz
+/// @param new_format_tag  WAV_FORMAT_TAG_PCM or WAV_FORMAT_TAG_FLOAT
+/// @param new_bits_per_sample  8, 16, 24 or 32 bit PCM, 32 or 64 bit float
+/// @param new_channels  Number of channels, only the first channel is used
+/// @param new_cycles_per_second  Clock of the timing profile
+/// @return  True if the format is supported
+bool PCMPulseDetectorClass::Create(uint32_t new_sample_rate, uint16_t new_format_tag, uint16_t new_bits_per_sample, uint16_t new_channels, uint32_t new_cycles_per_second)
+{
+    if(new_sample_rate == 0 || new_channels == 0 || !IsPCMFormatSupported(new_format_tag, new_bits_per_sample))
+        return false;
+
+    sample_rate = new_sample_rate;
+    cycles_per_second = new_cycles_per_second;
+    format_tag = new_format_tag;
+    bits_per_sample = new_bits_per_sample;
+    frame_size = static_cast<uint32_t>(bits_per_sample / 8) * new_channels;
+
+    low_pass = sample_rate >= WAV_LOW_PASS_MIN_SAMPLE_RATE;
+    dc_filter_factor = static_cast<float>(WAV_DC_FILTER_DIVIDER) / static_cast<float>(sample_rate);
+    peak_decay = static_cast<float>(pow(0.5, 1.0 / sample_rate));
+    silence = sample_rate / WAV_SILENCE_DIVIDER;
+
+    last_samples[0] = last_samples[1] = 0.0f;
+    dc_level = 0.0f;
+    peak_level = 0.0f;
+    last_signal[0] = last_signal[1] = 0.0f;
+    sample_pos = 0;
+
+    // Before the stream the level is high, so the first pulse starts at its falling edge
+    level = WAV_LEVEL_HIGH;
+    last_high = 0;
+    falling_crossing = 0.0;
+    has_wave_end = false;
+    wave_end = 0.0;
+    silence_edge_added = true;
+
+    first_edge = true;
+    cycle_pos = 0;
+    return true;
+}
+
+/// @brief  Get the size of one sample of all channels in bytes
+uint32_t PCMPulseDetectorClass::GetFrameSize() const
+{
+    return frame_size;
+}
+
+/// @brief  Push samples of the stream
+/// @param pcm_data  Samples in the format set by Create
+/// @param frames  Number of samples (of all channels)
+/// @param pulses  Completed pulses in cycles are appended, a silence is one long pulse
+void PCMPulseDetectorClass::AddSamples(const uint8_t *pcm_data, size_t frames, std::vector<uint64_t> &pulses)
+{
+    samples.resize(frames);
+    ConvertPCMSamples(pcm_data, frames, frame_size, format_tag, bits_per_sample, samples.data());
+
+    for(size_t i = 0; i < frames; i++)
+        AddSample(samples[i], pulses);
+}
+
+/// @brief  End of the stream, the last wave ends its pulse
+/// @param pulses  The last pulse is appended
+void PCMPulseDetectorClass::Flush(std::vector<uint64_t> &pulses)
+{
+    // The delayed sample of the low pass and the end of a wave which is cut by the end of the stream
+    AddSample(0.0f, pulses);
+    if(level == WAV_LEVEL_HIGH && !silence_edge_added && !has_wave_end)
+    {
+        float slope = last_signal[0] - last_signal[1];
+        wave_end = static_cast<double>(sample_pos) - 1.0 + (slope > 0.0f ? std::min(1.0f, last_signal[1] / slope) : 0.0f);
+        has_wave_end = true;
+    }
+
+    if(level == WAV_LEVEL_HIGH && !silence_edge_added && has_wave_end)
+        AddEdge(wave_end, pulses);
+    silence_edge_added = true;
+}
+
+/// @brief  Filter one sample and find the edges
+void PCMPulseDetectorClass::AddSample(float value, std::vector<uint64_t> &pulses)
+{
+    // Low pass for the sample before (one sample delay)
+    if(low_pass)
+    {
+        float filtered = 0.25f * last_samples[0] + 0.5f * last_samples[1] + 0.25f * value;
+        last_samples[0] = last_samples[1];
+        last_samples[1] = value;
+        value = filtered;
+    }
+
+    // DC removal and peak level
+    dc_level += (value - dc_level) * dc_filter_factor;
+    const float signal = value - dc_level;
+    const float magnitude = signal < 0.0f ? -signal : signal;
+    peak_level = magnitude > peak_level ? magnitude : peak_level * peak_decay;
+    const float threshold = std::max(WAV_MIN_LEVEL, peak_level * WAV_HYSTERESIS_LEVEL);
+
+    // Falling zero crossing, interpolated between the samples
+    if(last_signal[1] >= 0.0f && signal < 0.0f)
+        falling_crossing = static_cast<double>(sample_pos) - 1.0 + last_signal[1] / (last_signal[1] - signal);
+
+    // End of the wave behind the last high sample, the slope is extrapolated like in the WAV digitizer
+    if(level == WAV_LEVEL_HIGH && !has_wave_end && signal <= 0.0f)
+    {
+        float slope = last_signal[0] - last_signal[1];
+        if(slope > 0.0f)
+            wave_end = static_cast<double>(sample_pos) - 1.0 + std::min(1.0f, last_signal[1] / slope);
+        else
+            wave_end = static_cast<double>(sample_pos) - 1.0 + last_signal[1] / (last_signal[1] - signal);
+        has_wave_end = true;
+    }
+
+    // Hysteresis, a silence behind a wave ends the pulse at the end of the wave
+    if(signal > threshold)
+    {
+        level = WAV_LEVEL_HIGH;
+        last_high = sample_pos;
+        has_wave_end = false;
+        silence_edge_added = false;
+    }
+    else if(signal < -threshold && level != WAV_LEVEL_LOW)
+    {
+        if(level == WAV_LEVEL_HIGH)
+            AddEdge(falling_crossing, pulses);
+        level = WAV_LEVEL_LOW;
+    }
+    else if(level == WAV_LEVEL_HIGH && !silence_edge_added && has_wave_end && sample_pos - last_high > silence)
+    {
+        AddEdge(wave_end, pulses);
+        silence_edge_added = true;
+    }
+
+    last_signal[0] = last_signal[1];
+    last_signal[1] = signal;
+    sample_pos++;
+}
+
+/// @brief  Add a falling edge, the sample position is converted to cycles with the accumulated position (no drift)
+void PCMPulseDetectorClass::AddEdge(double edge, std::vector<uint64_t> &pulses)
+{
+    uint64_t new_cycle_pos = static_cast<uint64_t>(std::max(edge, 0.0) * cycles_per_second / sample_rate + 0.5);
+    if(!first_edge && new_cycle_pos > cycle_pos)
+        pulses.push_back(new_cycle_pos - cycle_pos);
+    first_edge = false;
+    cycle_pos = std::max(cycle_pos, new_cycle_pos);
+}
@@ -0,0 +1,59 @@
+#ifndef PCM_PULSE_DETECTOR_CLASS_H
+#define PCM_PULSE_DETECTOR_CLASS_H
+
+#include <vector>
+#include <inttypes.h>
+#include <cstddef>
+
+#include "wav_file.h"
+
+/// @brief  Pulse detector for a live stream of PCM samples (raw, without header)
+/// @note   The samples are pushed in blocks of any size, every completed
+///         pulse (falling edge to falling edge) is returned at once in
+///         cycles. The filters of the WAV digitizer are causal here: low pass
+///         [1 2 1] / 4 (one sample delay), DC removal with a one pole filter
+///         and the hysteresis thresholds from a decaying peak level instead
+///         of the peak of a chunk. A pulse is known at the low threshold of
+///         the next wave (less than half a pulse), the memory is constant.
+class PCMPulseDetectorClass
+{
+public:
+    PCMPulseDetectorClass();
+    bool Create(uint32_t new_sample_rate, uint16_t new_format_tag, uint16_t new_bits_per_sample, uint16_t new_channels, uint32_t new_cycles_per_second);
+    uint32_t GetFrameSize() const;
+    void AddSamples(const uint8_t *pcm_data, size_t frames, std::vector<uint64_t> &pulses);
+    void Flush(std::vector<uint64_t> &pulses);
+
+private:
+    void AddSample(float value, std::vector<uint64_t> &pulses);
+    void AddEdge(double edge, std::vector<uint64_t> &pulses);
+
+    uint32_t sample_rate;
+    uint32_t cycles_per_second;
+    uint16_t format_tag;                // WAV_FORMAT_TAG_PCM or WAV_FORMAT_TAG_FLOAT
+    uint16_t bits_per_sample;
+    uint32_t frame_size;                // Bytes per sample of all channels
+    bool low_pass;
+    float dc_filter_factor;
+    float peak_decay;                   // Factor per sample, the peak level falls to the half in one second
+    uint64_t silence;                   // Min. samples of a silence behind a wave
+
+    std::vector<float> samples;         // Converted samples of one block
+
+    float last_samples[2];              // Samples before the current (low pass)
+    float dc_level;
+    float peak_level;
+    float last_signal[2];               // Filtered samples before the current
+    uint64_t sample_pos;                // Position of the current filtered sample
+    int level;                          // WAV_LEVEL
+    uint64_t last_high;                 // Last sample above the high threshold
+    double falling_crossing;            // Last falling zero crossing (interpolated)
+    bool has_wave_end;                  // End of the wave behind last_high found
+    double wave_end;
+    bool silence_edge_added;            // The silence behind the last wave ended its pulse
+
+    bool first_edge;
+    uint64_t cycle_pos;                 // Cycles up to the last edge
+};
+
+#endif // PCM_PULSE_DETECTOR_CLASS_H
@@ -0,0 +1,68 @@
+#include "./t64_file.h"
+#include <string.h>
+#include <algorithm>
+
+/// @brief  Write a 16 bit value (little endian)
+static void WriteLE16(uint8_t *data, uint32_t value)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+}
+
+/// @brief  Create a complete T64 image in memory
+/// @param tape_name  Name of the tape (max. 24 characters)
+/// @param files  Files of the image (PRG files with start address)
+/// @param t64_data  Complete T64 file
+/// @return  False if a file is too short or does not fit into the C64 memory
+/// @note   The directory has at least 30 entries (like the most tools write
+///         it), the names are padded with spaces.
+bool CreateT64Image(const std::string &tape_name, const std::vector<T64_FILE> &files, std::vector<uint8_t> &t64_data)
+{
+    size_t entry_count = std::max<size_t>(files.size(), T64_MIN_ENTRIES);
+    size_t data_size = 0;
+
+    for(const T64_FILE &file : files)
+    {
+        if(file.prg_data.size() < 2)
+            return false;
+        uint32_t start_address = static_cast<uint32_t>(file.prg_data[0] | file.prg_data[1] << 8);
+        if(start_address + file.prg_data.size() - 2 > 0x10000)
+            return false;
+        data_size += file.prg_data.size() - 2;
+    }
+
+    t64_data.assign(T64_HEADER_SIZE + entry_count * T64_ENTRY_SIZE, 0x00);
+    t64_data.reserve(t64_data.size() + data_size);
+
+    // Header
+    const char signature[] = "C64S tape image file";
+    memcpy(t64_data.data(), signature, sizeof(signature) - 1);
+    WriteLE16(&t64_data[0x20], 0x0101);                                     // Version
+    WriteLE16(&t64_data[0x22], static_cast<uint32_t>(entry_count));         // Max. entries
+    WriteLE16(&t64_data[0x24], static_cast<uint32_t>(files.size()));        // Used entries
+    memset(&t64_data[0x28], 0x20, T64_NAME_LENGTH);
+    memcpy(&t64_data[0x28], tape_name.data(), std::min<size_t>(tape_name.size(), T64_NAME_LENGTH));
+
+    // Directory and data
+    for(size_t i=0; i<files.size(); i++)
+    {
+        const T64_FILE &file = files[i];
+        uint8_t *entry = &t64_data[T64_HEADER_SIZE + i * T64_ENTRY_SIZE];
+        uint32_t start_address = static_cast<uint32_t>(file.prg_data[0] | file.prg_data[1] << 8);
+        uint32_t end_address = start_address + static_cast<uint32_t>(file.prg_data.size() - 2);
+        uint32_t offset = static_cast<uint32_t>(t64_data.size());
+
+        entry[0] = 0x01;                            // Normal tape file
+        entry[1] = 0x82;                            // PRG (1541 file type)
+        WriteLE16(entry + 2, start_address);
+        WriteLE16(entry + 4, end_address);
+        for(int j=0; j<4; j++)
+            entry[8 + j] = static_cast<uint8_t>(offset >> (j * 8));
+        memset(entry + 16, 0x20, T64_FILENAME_LENGTH);
+        memcpy(entry + 16, file.filename.data(), std::min<size_t>(file.filename.size(), T64_FILENAME_LENGTH));
+
+        t64_data.insert(t64_data.end(), file.prg_data.begin() + 2, file.prg_data.end());
+    }
+
+    return true;
+}
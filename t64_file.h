@@ -0,0 +1,26 @@
+#ifndef T64_FILE_H
+#define T64_FILE_H
+
+#include <vector>
+#include <string>
+#include <inttypes.h>
+
+// T64 tape image (C64S)
+// Header (64 bytes), a directory with one entry (32 bytes) per file and the
+// data of the files (without start address) behind it.
+#define T64_HEADER_SIZE 64
+#define T64_ENTRY_SIZE 32
+#define T64_MIN_ENTRIES 30
+#define T64_NAME_LENGTH 24
+#define T64_FILENAME_LENGTH 16
+
+/// @brief  File in a T64 image
+struct T64_FILE
+{
+    std::string filename;           // Filename (max. 16 characters, PETSCII)
+    std::vector<uint8_t> prg_data;  // Content of the PRG file (with start address)
+};
+
+bool CreateT64Image(const std::string &tape_name, const std::vector<T64_FILE> &files, std::vector<uint8_t> &t64_data);
+
+#endif // T64_FILE_H
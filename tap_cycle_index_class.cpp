@@ -0,0 +1,173 @@
+#include "./tap_cycle_index_class.h"
+#include <string.h>
+#include <algorithm>
+
+TAPCycleIndexClass::TAPCycleIndexClass(uint32_t interval)
+{
+    pulse_interval = interval > 0 ? interval : 1;
+
+    data = nullptr;
+    size = 0;
+    tap_version = 0;
+    pulse_count = 0;
+    total_cycles = 0;
+}
+
+/// @brief  Create the index of a TAP file
+/// @param tap_data  Pointer to the TAP file data
+/// @param tap_size  Size of the TAP file data
+/// @param timing_profile  Timing profile for the detection of the sync leaders (TIMING_PROFILE)
+/// @return  True if the index was created, false if the data is not a TAP file
+bool TAPCycleIndexClass::Create(const uint8_t *tap_data, uint32_t tap_size, int timing_profile)
+{
+    interval_entries.clear();
+    block_entries.clear();
+    pulse_count = 0;
+    total_cycles = 0;
+
+    if(tap_size < TAP_DATA_START || memcmp(tap_data, "C64-TAPE-RAW", 12) != 0)
+    {
+        data = nullptr;
+        size = 0;
+        return false;
+    }
+
+    data = tap_data;
+    size = tap_size;
+    tap_version = data[12];
+
+    CallWithTimingProfile(timing_profile, [this](auto timing)
+    {
+        CreateEntries<decltype(timing)>();
+    });
+
+    return true;
+}
+
+/// @brief  Walk through all pulses and store the index entries
+template<class TIMING>
+void TAPCycleIndexClass::CreateEntries()
+{
+    uint32_t pos = TAP_DATA_START;
+    uint32_t short_pulse_count = 0;
+    TAP_INDEX_ENTRY leader_start = {0, 0, 0};
+
+    interval_entries.reserve((size - TAP_DATA_START) / pulse_interval + 1);
+
+    while(pos < size)
+    {
+        TAP_INDEX_ENTRY entry = {total_cycles, pos, pulse_count};
+
+        if(pulse_count % pulse_interval == 0)
+            interval_entries.push_back(entry);
+
+        // A v1 long pause must not be read behind the end of the data
+        if(data[pos] == 0 && tap_version == 1 && pos + 3 >= size)
+            break;
+
+        uint32_t pulse_length = GetTAPPulseLength(data, pos, tap_version);
+
+        if(TIMING::GetPulseType(pulse_length) == SHORT_PULSE)
+        {
+            if(short_pulse_count == 0)
+                leader_start = entry;
+            short_pulse_count++;
+            if(short_pulse_count == TAP_MIN_LEADER_PULSES)
+                block_entries.push_back(leader_start);
+        }
+        else
+        {
+            short_pulse_count = 0;
+        }
+
+        total_cycles += pulse_length;
+        pulse_count++;
+        pos++;
+    }
+}
+
+/// @brief  Get the length of the complete tape
+/// @return  Length in C64 cycles
+uint64_t TAPCycleIndexClass::GetTotalCycles()
+{
+    return total_cycles;
+}
+
+/// @brief  Get the number of pulses in the TAP file
+uint32_t TAPCycleIndexClass::GetPulseCount()
+{
+    return pulse_count;
+}
+
+/// @brief  Get the number of blocks (sync leaders) in the TAP file
+int TAPCycleIndexClass::GetBlockCount()
+{
+    return static_cast<int>(block_entries.size());
+}
+
+/// @brief  Get the start of a block
+/// @param block  Number of the block
+/// @param entry  Start of the sync leader of the block
+/// @return  True if the block exists, false otherwise
+bool TAPCycleIndexClass::GetBlockStart(int block, TAP_INDEX_ENTRY &entry)
+{
+    if(block < 0 || block >= static_cast<int>(block_entries.size()))
+        return false;
+
+    entry = block_entries[static_cast<size_t>(block)];
+    return true;
+}
+
+/// @brief  Find the block which contains a cycle position
+/// @param cycle  Cycles from the start of the tape
+/// @return  Number of the block, -1 if the position lies before the first block
+int TAPCycleIndexClass::FindBlock(uint64_t cycle)
+{
+    std::vector<TAP_INDEX_ENTRY>::iterator it = std::upper_bound(block_entries.begin(), block_entries.end(), cycle,
+        [](uint64_t value, const TAP_INDEX_ENTRY &entry) { return value < entry.cycle; });
+
+    return static_cast<int>(it - block_entries.begin()) - 1;
+}
+
+/// @brief  Find the pulse which is played at a cycle position
+/// @param cycle  Cycles from the start of the tape
+/// @return  Index entry of the pulse, the end of the tape if the position lies behind it
+TAP_INDEX_ENTRY TAPCycleIndexClass::FindCycle(uint64_t cycle)
+{
+    TAP_INDEX_ENTRY entry = {total_cycles, size, pulse_count};
+
+    if(interval_entries.empty() || cycle >= total_cycles)
+        return entry;
+
+    // Last index entry at or before the cycle position
+    std::vector<TAP_INDEX_ENTRY>::iterator it = std::upper_bound(interval_entries.begin(), interval_entries.end(), cycle,
+        [](uint64_t value, const TAP_INDEX_ENTRY &index_entry) { return value < index_entry.cycle; });
+    entry = *(it - 1);
+
+    // Walk to the pulse (at most pulse_interval pulses)
+    while(entry.pos < size)
+    {
+        uint32_t pos = entry.pos;
+        uint32_t pulse_length = GetTAPPulseLength(data, pos, tap_version);
+        if(entry.cycle + pulse_length > cycle)
+            break;
+
+        entry.cycle += pulse_length;
+        entry.pos = pos + 1;
+        entry.pulse++;
+    }
+
+    return entry;
+}
+
+/// @brief  Find the pulse which is played at a time position
+/// @param seconds  Time from the start of the tape
+/// @param cycles_per_second  Clock of the C64 (PAL: 985248, NTSC: 1022727)
+/// @return  Index entry of the pulse, the end of the tape if the position lies behind it
+TAP_INDEX_ENTRY TAPCycleIndexClass::FindTime(double seconds, uint32_t cycles_per_second)
+{
+    if(seconds < 0)
+        seconds = 0;
+
+    return FindCycle(static_cast<uint64_t>(seconds * cycles_per_second));
+}
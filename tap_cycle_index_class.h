@@ -0,0 +1,53 @@
+#ifndef TAP_CYCLE_INDEX_CLASS_H
+#define TAP_CYCLE_INDEX_CLASS_H
+
+#include <vector>
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+#include "timing_profile.h"
+
+// Default number of pulses between two index entries
+#define TAP_INDEX_PULSE_INTERVAL 1024
+
+struct TAP_INDEX_ENTRY
+{
+    uint64_t cycle;         // Cycles from the start of the tape up to the start of the pulse
+    uint32_t pos;           // Position of the pulse in the TAP file
+    uint32_t pulse;         // Number of the pulse
+};
+
+/// @brief  Index of the cumulative C64 cycle count of a TAP file
+/// @note   An entry is stored every pulse_interval pulses and at the start of
+///         every block (first pulse of a sync leader). A cycle position is found
+///         with a binary search and at most pulse_interval pulse steps.
+///         The TAP data is not copied and must stay valid while the index is used.
+class TAPCycleIndexClass
+{
+public:
+    TAPCycleIndexClass(uint32_t interval = TAP_INDEX_PULSE_INTERVAL);
+    bool Create(const uint8_t *tap_data, uint32_t tap_size, int timing_profile = TIMING_PAL);
+    uint64_t GetTotalCycles();
+    uint32_t GetPulseCount();
+    int GetBlockCount();
+    bool GetBlockStart(int block, TAP_INDEX_ENTRY &entry);
+    int FindBlock(uint64_t cycle);
+    TAP_INDEX_ENTRY FindCycle(uint64_t cycle);
+    TAP_INDEX_ENTRY FindTime(double seconds, uint32_t cycles_per_second = TAP_CYCLES_PER_SECOND);
+
+private:
+    template<class TIMING> void CreateEntries();
+
+    const uint8_t *data;
+    uint32_t size;
+    uint8_t tap_version;
+
+    uint32_t pulse_interval;
+    uint32_t pulse_count;
+    uint64_t total_cycles;
+
+    std::vector<TAP_INDEX_ENTRY> interval_entries;
+    std::vector<TAP_INDEX_ENTRY> block_entries;
+};
+
+#endif // TAP_CYCLE_INDEX_CLASS_H
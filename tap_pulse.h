@@ -0,0 +1,158 @@
+#ifndef TAP_PULSE_H
+#define TAP_PULSE_H
+
+#include <inttypes.h>
+#include <vector>
+
+// TAP Pulse Lengths (from VICE)
+// These are the PAL values, the timing profiles (timing_profile.h) are based on them
+// Short Pulse between 288 and 432 Cycles
+// Medium Pulse between 440 and 584 Cycles
+// Long Pulse between 592 and 800 Cycles
+// Cycles per second (PAL): 985248
+// Cycles per second (NTSC): 1022727
+#define SHORT_PULSE_MIN 288     // 0x24 (Databyte in TAP file)
+#define SHORT_PULSE_MAX 432     // 0x36 (Databyte in TAP file)
+#define MEDIUM_PULSE_MIN 440    // 0x37 (Databyte in TAP file)
+#define MEDIUM_PULSE_MAX 584    // 0x49 (Databyte in TAP file)
+#define LONG_PULSE_MIN 592      // 0x4A (Databyte in TAP file)
+#define LONG_PULSE_MAX 800      // 0x64 (Databyte in TAP file)
+
+// TAP Pulse Lengths for send to C64
+// Cycles per second (PAL): 985248
+// Cycles per second (NTSC): 1022727
+#define SHORT_PULSE_LENGTH 360
+#define MEDIUM_PULSE_LENGTH 524
+#define LONG_PULSE_LENGTH 687
+
+// Turbo Pulse Lengths (one pulse per bit)
+// Bit 0 and bit 1 are separated by the threshold, valid pulses between min and max
+#define TURBO_BIT0_PULSE_LENGTH 216         // 0x1B (Databyte in TAP file)
+#define TURBO_BIT1_PULSE_LENGTH 336         // 0x2A (Databyte in TAP file)
+#define TURBO_PULSE_THRESHOLD 276
+#define TURBO_PULSE_MIN 144
+#define TURBO_PULSE_MAX 432
+
+// Cycles per second (PAL)
+#define TAP_CYCLES_PER_SECOND 985248
+
+// Start of the pulse data in a TAP file
+#define TAP_DATA_START 0x14
+
+// Minimum number of short pulses which are detected as sync leader
+#define TAP_MIN_LEADER_PULSES 32
+
+enum PULSE_TYPE {SHORT_PULSE, MEDIUM_PULSE, LONG_PULSE, UNKNOWN_PULSE};
+
+/// @brief  Get the length of the next pulse from the TAP data
+/// @param data  Pointer to the TAP file data
+/// @param pos  Current position in the TAP file data, in TAP version 1 a long pause moves it to the last of its 4 bytes
+/// @param tap_version  Version of the TAP file
+/// @return  Length of the pulse in C64 cycles
+inline uint32_t GetTAPPulseLength(const uint8_t *data, uint32_t &pos, uint8_t tap_version)
+{
+    uint32_t pulse_length = data[pos];
+
+    if(pulse_length == 0x00)
+    {
+        if(tap_version == 0)
+        {
+            pulse_length = 256 * 8;
+        }
+
+        if(tap_version == 1)
+        {
+            pulse_length = static_cast<uint32_t>(data[pos+1] | data[pos+2] << 8 | data[pos+3] << 16);
+            pos += 3;
+        }
+    }
+    else
+    {
+        pulse_length *= 8;
+    }
+
+    return pulse_length;
+}
+
+/// @brief  Add a pulse to a TAP version 1 image
+/// @param tap_image  TAP image
+/// @param cycles  Length of the pulse in C64 cycles
+inline void AddTAPPulse(std::vector<uint8_t> &tap_image, uint64_t cycles)
+{
+    uint64_t tap_byte = (cycles + 4) / 8;
+
+    if(tap_byte >= 1 && tap_byte <= 255)
+    {
+        tap_image.push_back(static_cast<uint8_t>(tap_byte));
+        return;
+    }
+
+    if(tap_byte == 0)
+    {
+        tap_image.push_back(1);
+        return;
+    }
+
+    // Long pause, split into parts of max. 24 bit
+    while(cycles > 0)
+    {
+        uint32_t part = cycles > 0xFFFFFF ? 0xFFFFFF : static_cast<uint32_t>(cycles);
+        tap_image.push_back(0x00);
+        tap_image.push_back(static_cast<uint8_t>(part));
+        tap_image.push_back(static_cast<uint8_t>(part >> 8));
+        tap_image.push_back(static_cast<uint8_t>(part >> 16));
+        cycles -= part;
+    }
+}
+
+// Number of pulses of a kernal byte (ByteMarker + 8 bits + parity bit)
+#define TAP_PULSES_PER_BYTE 20
+
+/// @brief  Pulses (TAP data bytes) of all 256 kernal bytes
+struct TAP_BYTE_PULSE_TABLE
+{
+    uint8_t pulses[256][TAP_PULSES_PER_BYTE];
+};
+
+/// @brief  Create the pulses of all 256 kernal bytes at compile time
+/// @param short_pulse  TAP data byte of a short pulse
+/// @param medium_pulse  TAP data byte of a medium pulse
+/// @param long_pulse  TAP data byte of a long pulse
+/// @note   ByteMarker (Long + Medium), the bits LSB first (1 = Medium + Short,
+///         0 = Short + Medium) and the odd parity bit.
+constexpr TAP_BYTE_PULSE_TABLE CreateTAPBytePulseTable(uint8_t short_pulse, uint8_t medium_pulse, uint8_t long_pulse)
+{
+    TAP_BYTE_PULSE_TABLE table = {};
+
+    for(int byte = 0; byte < 256; byte++)
+    {
+        uint8_t *pulses = table.pulses[byte];
+        int n = 0;
+
+        pulses[n++] = long_pulse;
+        pulses[n++] = medium_pulse;
+
+        uint8_t parity_bit = 1;
+        for(int i = 0; i < 9; i++)
+        {
+            bool bit = false;
+            if(i < 8)
+            {
+                bit = (byte & (1 << i)) != 0;
+                if(bit)
+                    parity_bit ^= 1;
+            }
+            else
+            {
+                bit = (parity_bit == 1);
+            }
+
+            pulses[n++] = bit ? medium_pulse : short_pulse;
+            pulses[n++] = bit ? short_pulse : medium_pulse;
+        }
+    }
+
+    return table;
+}
+
+#endif // TAP_PULSE_H
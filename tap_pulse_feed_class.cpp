@@ -0,0 +1,116 @@
+#include "./tap_pulse_feed_class.h"
+#include <string.h>
+#include <fstream>
+
+TAPPulseFeedClass::TAPPulseFeedClass()
+{
+    data = nullptr;
+    end = 0;
+    pos = 0;
+    tap_version = 0;
+    cycles_to_next_edge = 0;
+}
+
+/// @brief  Open TAP data in memory
+/// @param tap_data  Pointer to the TAP file data
+/// @param tap_size  Size of the TAP file data
+/// @return  True if the data is a TAP file, false otherwise
+bool TAPPulseFeedClass::Open(const uint8_t *tap_data, uint32_t tap_size)
+{
+    data = nullptr;
+    end = 0;
+    pos = 0;
+    cycles_to_next_edge = 0;
+
+    if(tap_size < TAP_DATA_START || memcmp(tap_data, "C64-TAPE-RAW", 12) != 0)
+        return false;
+
+    data = tap_data;
+    end = tap_size;
+    tap_version = tap_data[12];
+    Rewind();
+
+    return true;
+}
+
+/// @brief  Load a TAP file into the internal buffer
+/// @param tap_file  Path to the TAP file
+/// @return  True if the file could be read and is a TAP file, false otherwise
+bool TAPPulseFeedClass::Load(const char *tap_file)
+{
+    std::ifstream tap_file_stream(tap_file, std::ios::binary);
+    if(!tap_file_stream.is_open())
+        return false;
+
+    tap_file_stream.seekg(0, std::ios::end);
+    std::streamoff file_size = tap_file_stream.tellg();
+    tap_file_stream.seekg(0, std::ios::beg);
+
+    tap_buffer.resize(static_cast<size_t>(file_size));
+    tap_file_stream.read(reinterpret_cast<char*>(tap_buffer.data()), file_size);
+    tap_file_stream.close();
+
+    return Open(tap_buffer.data(), static_cast<uint32_t>(tap_buffer.size()));
+}
+
+/// @brief  Set the feed back to the first pulse
+void TAPPulseFeedClass::Rewind()
+{
+    pos = TAP_DATA_START;
+    cycles_to_next_edge = 0;
+}
+
+/// @brief  Set the feed to a position in the TAP file
+/// @param new_pos  Position of a pulse in the TAP file (e.g. from TAPCycleIndexClass)
+/// @param cycles  Remaining cycles of the current pulse, 0 starts with the pulse at new_pos
+/// @return  True if the position lies in the pulse data, false otherwise
+bool TAPPulseFeedClass::SetPosition(uint32_t new_pos, uint32_t cycles)
+{
+    if(data == nullptr || new_pos < TAP_DATA_START || new_pos > end)
+        return false;
+
+    pos = new_pos;
+    cycles_to_next_edge = cycles;
+    return true;
+}
+
+/// @brief  Get the version of the TAP file
+uint8_t TAPPulseFeedClass::GetVersion()
+{
+    return tap_version;
+}
+
+/// @brief  Read the lengths of the next pulses into a buffer
+/// @param buffer  Buffer for the pulse lengths in C64 cycles
+/// @param count  Maximal number of pulses
+/// @return  Number of pulses in the buffer, less than count at the end of the tape
+uint32_t TAPPulseFeedClass::ReadPulses(uint32_t *buffer, uint32_t count)
+{
+    uint32_t i = 0;
+
+    // A started pulse is returned first
+    if(cycles_to_next_edge != 0 && count > 0)
+    {
+        buffer[i++] = cycles_to_next_edge;
+        cycles_to_next_edge = 0;
+    }
+
+    // v0 and short pulses of v1 need no check for a long pause
+    while(i < count && pos < end)
+    {
+        uint32_t pulse_length = static_cast<uint32_t>(data[pos]) << 3;
+        if(pulse_length == 0)
+        {
+            pulse_length = GetNextPulse();
+            if(pulse_length == 0)
+                break;
+        }
+        else
+        {
+            pos++;
+        }
+        buffer[i++] = pulse_length;
+    }
+
+    return i;
+}
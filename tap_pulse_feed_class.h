@@ -0,0 +1,118 @@
+#ifndef TAP_PULSE_FEED_CLASS_H
+#define TAP_PULSE_FEED_CLASS_H
+
+#include <vector>
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+
+/// @brief  Cycle exact pulse feed of a TAP file (v0 and v1) for emulators
+/// @note   The pulses are decoded with GetTAPPulseLength while they are read,
+///         there is no preprocessing. The hot functions (GetNextPulse, Clock,
+///         GetCyclesToNextEdge) are inline, so they can be called from the
+///         main loop of an emulator.
+///         Open does not copy the data, it must stay valid while the feed is used.
+///         Load reads the TAP file into an internal buffer.
+class TAPPulseFeedClass
+{
+public:
+    TAPPulseFeedClass();
+    bool Open(const uint8_t *tap_data, uint32_t tap_size);
+    bool Load(const char *tap_file);
+    void Rewind();
+    bool SetPosition(uint32_t pos, uint32_t cycles_to_next_edge = 0);
+    uint8_t GetVersion();
+    uint32_t ReadPulses(uint32_t *buffer, uint32_t count);
+
+    /// @brief  Check if all pulses are read
+    inline bool IsEnd() const
+    {
+        return pos >= end;
+    }
+
+    /// @brief  Get the position of the next pulse in the TAP file
+    inline uint32_t GetPosition() const
+    {
+        return pos;
+    }
+
+    /// @brief  Get the length of the next pulse
+    /// @return  Length of the pulse in C64 cycles, 0 only at the end of the tape
+    /// @note   A 0x00 byte of v0 (and of unknown versions) and a v1 pause of
+    ///         0 cycles are returned as 256*8 cycles, so a pulse is never 0.
+    inline uint32_t GetNextPulse()
+    {
+        if(pos >= end)
+            return 0;
+
+        uint32_t pulse_length = static_cast<uint32_t>(data[pos]) << 3;
+        if(pulse_length == 0)
+        {
+            if(tap_version == 1)
+            {
+                // v1 long pause must lie completely in the data
+                if(pos + 3 >= end)
+                {
+                    pos = end;
+                    return 0;
+                }
+                pulse_length = GetTAPPulseLength(data, pos, tap_version);
+            }
+
+            if(pulse_length == 0)
+                pulse_length = 256 * 8;
+        }
+        pos++;
+        return pulse_length;
+    }
+
+    /// @brief  Get the cycles until the next edge (the end of the current pulse)
+    /// @return  Cycles until the next edge, 0 at the end of the tape
+    inline uint32_t GetCyclesToNextEdge()
+    {
+        if(cycles_to_next_edge == 0)
+            cycles_to_next_edge = GetNextPulse();
+        return cycles_to_next_edge;
+    }
+
+    /// @brief  Advance the tape by a number of cycles
+    /// @param cycles  Elapsed C64 cycles
+    /// @return  Number of edges in this time
+    inline uint32_t Clock(uint32_t cycles)
+    {
+        uint32_t edge_count = 0;
+
+        while(cycles > 0)
+        {
+            if(cycles_to_next_edge == 0)
+            {
+                cycles_to_next_edge = GetNextPulse();
+                if(cycles_to_next_edge == 0)
+                    break;
+            }
+
+            if(cycles < cycles_to_next_edge)
+            {
+                cycles_to_next_edge -= cycles;
+                break;
+            }
+
+            cycles -= cycles_to_next_edge;
+            cycles_to_next_edge = 0;
+            edge_count++;
+        }
+
+        return edge_count;
+    }
+
+private:
+    std::vector<uint8_t> tap_buffer;
+
+    const uint8_t *data;
+    uint32_t end;
+    uint32_t pos;
+    uint8_t tap_version;
+    uint32_t cycles_to_next_edge;
+};
+
+#endif // TAP_PULSE_FEED_CLASS_H
@@ -0,0 +1,348 @@
+#include "./tape_program_class.h"
+#include <algorithm>
+
+TapeProgramClass::TapeProgramClass()
+{
+    timing_profile = TIMING_PAL;
+}
+
+void TapeProgramClass::Clear()
+{
+    segments.clear();
+    byte_list.clear();
+}
+
+/// @brief  Add pulses with the same length
+/// @param pulse_length  Length of the pulses in cycles
+/// @param count  Number of pulses
+/// @note   The pulses are added to the last segment if it has the same pulse length
+void TapeProgramClass::AddPulses(uint32_t pulse_length, uint32_t count)
+{
+    if(count == 0)
+        return;
+
+    if(!segments.empty() && segments.back().type == TAPE_SEGMENT_PULSES && segments.back().pulse_length == pulse_length)
+    {
+        segments.back().count += count;
+        return;
+    }
+
+    segments.push_back({TAPE_SEGMENT_PULSES, pulse_length, count, 0});
+}
+
+void TapeProgramClass::AddBytes(uint8_t type, const uint8_t *bytes, uint32_t count)
+{
+    if(count == 0)
+        return;
+
+    // The bytes are added to the last segment if it is of the same type (its bytes are always at the end of the list)
+    if(segments.empty() || segments.back().type != type)
+        segments.push_back({type, 0, 0, static_cast<uint32_t>(byte_list.size())});
+
+    segments.back().count += count;
+    byte_list.insert(byte_list.end(), bytes, bytes + count);
+}
+
+/// @brief  Add bytes in kernal format (marker, 8 bits LSB first, parity bit)
+void TapeProgramClass::AddKernalBytes(const uint8_t *bytes, uint32_t count)
+{
+    AddBytes(TAPE_SEGMENT_KERNAL_BYTES, bytes, count);
+}
+
+void TapeProgramClass::AddKernalByte(uint8_t byte)
+{
+    AddBytes(TAPE_SEGMENT_KERNAL_BYTES, &byte, 1);
+}
+
+/// @brief  Add bytes in turbo format (one pulse per bit, MSB first)
+void TapeProgramClass::AddTurboBytes(const uint8_t *bytes, uint32_t count)
+{
+    AddBytes(TAPE_SEGMENT_TURBO_BYTES, bytes, count);
+}
+
+void TapeProgramClass::AddTurboByte(uint8_t byte)
+{
+    AddBytes(TAPE_SEGMENT_TURBO_BYTES, &byte, 1);
+}
+
+/// @brief  Append all segments of another tape program
+void TapeProgramClass::Append(const TapeProgramClass &program)
+{
+    uint32_t offset = static_cast<uint32_t>(byte_list.size());
+
+    for(const TAPE_SEGMENT &segment : program.segments)
+    {
+        if(segment.type == TAPE_SEGMENT_PULSES)
+            AddPulses(segment.pulse_length, segment.count);
+        else
+            segments.push_back({segment.type, 0, segment.count, segment.byte_offset + offset});
+    }
+    byte_list.insert(byte_list.end(), program.byte_list.begin(), program.byte_list.end());
+}
+
+const std::vector<TAPE_SEGMENT> &TapeProgramClass::GetSegments() const
+{
+    return segments;
+}
+
+const uint8_t *TapeProgramClass::GetBytes() const
+{
+    return byte_list.data();
+}
+
+/// @brief  Number of pulses of the tape program
+uint64_t TapeProgramClass::GetPulseCount() const
+{
+    uint64_t pulse_count = 0;
+
+    for(const TAPE_SEGMENT &segment : segments)
+    {
+        if(segment.type == TAPE_SEGMENT_PULSES)
+            pulse_count += segment.count;
+        else if(segment.type == TAPE_SEGMENT_KERNAL_BYTES)
+            pulse_count += static_cast<uint64_t>(segment.count) * TAP_PULSES_PER_BYTE;
+        else
+            pulse_count += static_cast<uint64_t>(segment.count) * 8;
+    }
+
+    return pulse_count;
+}
+
+/// @brief  Size of the rendered TAP data (without TAP header)
+/// @param tap_version  TAP version, in version 1 a pulse longer than 255*8 or shorter than 8 cycles needs 4 bytes
+uint32_t TapeProgramClass::GetTAPDataSize(uint8_t tap_version) const
+{
+    uint64_t size = GetPulseCount();
+
+    for(const TAPE_SEGMENT &segment : segments)
+    {
+        // The same condition as RenderTAPData, which writes these pulses as 0x00 + 24 bit
+        uint32_t tap_byte = segment.pulse_length >> 3;
+        if(segment.type == TAPE_SEGMENT_PULSES && (tap_byte == 0 || tap_byte > 255) && tap_version == 1)
+            size += static_cast<uint64_t>(segment.count) * 3;
+    }
+
+    return static_cast<uint32_t>(size);
+}
+
+/// @brief  Length of the tape program in cycles
+/// @note   The kernal bytes with the pulse lengths of the timing profile, a turbo
+///         byte depends on its number of 1 bits.
+uint64_t TapeProgramClass::GetTotalCycles() const
+{
+    uint64_t cycles = 0;
+
+    for(const TAPE_SEGMENT &segment : segments)
+        cycles += GetSegmentCycles(segment, 0, segment.count);
+
+    return cycles;
+}
+
+/// @brief  Length of a part of a segment in cycles
+/// @param segment  Segment of this program
+/// @param first  First pulse or byte of the part
+/// @param count  Number of pulses or bytes
+uint64_t TapeProgramClass::GetSegmentCycles(const TAPE_SEGMENT &segment, uint32_t first, uint32_t count) const
+{
+    if(segment.type == TAPE_SEGMENT_PULSES)
+        return static_cast<uint64_t>(count) * segment.pulse_length;
+
+    if(segment.type == TAPE_SEGMENT_KERNAL_BYTES)
+    {
+        uint32_t kernal_byte_cycles = CallWithTimingProfile(timing_profile, [](auto timing) -> uint32_t
+        {
+            typedef decltype(timing) TIMING;
+            // ByteMarker (Long + Medium) and 9 bits (Short + Medium)
+            return TIMING::long_pulse_length + TIMING::medium_pulse_length + 9 * (TIMING::short_pulse_length + TIMING::medium_pulse_length);
+        });
+        return static_cast<uint64_t>(count) * kernal_byte_cycles;
+    }
+
+    uint64_t cycles = 0;
+    for(uint32_t i=0; i<count; i++)
+    {
+        uint8_t byte = byte_list[segment.byte_offset + first + i];
+        for(int j=0; j<8; j++)
+            cycles += (byte >> j) & 1 ? TURBO_BIT1_PULSE_LENGTH : TURBO_BIT0_PULSE_LENGTH;
+    }
+    return cycles;
+}
+
+/// @brief  Set the timing profile of the kernal bytes
+/// @param profile  Timing profile (TIMING_PROFILE)
+void TapeProgramClass::SetTimingProfile(int profile)
+{
+    timing_profile = profile;
+}
+
+/// @brief  Get the timing profile of the kernal bytes
+int TapeProgramClass::GetTimingProfile() const
+{
+    return timing_profile;
+}
+
+/// @brief  Output of RenderTAPData into one vector
+class TAPVectorOutput
+{
+public:
+    TAPVectorOutput(std::vector<uint8_t> &tap_data) : data(tap_data) {}
+
+    inline void Put(uint8_t byte)
+    {
+        data.push_back(byte);
+    }
+
+    inline void Put(const uint8_t *bytes, size_t count)
+    {
+        data.insert(data.end(), bytes, bytes + count);
+    }
+
+    inline void Fill(size_t count, uint8_t byte)
+    {
+        data.insert(data.end(), count, byte);
+    }
+
+private:
+    std::vector<uint8_t> &data;
+};
+
+/// @brief  Output of RenderTAPData into parts of at most part_size bytes
+/// @note   The buffer of a part is taken when the first byte is written into it,
+///         so no buffer is taken and left empty at the end.
+class TAPPartOutput
+{
+public:
+    TAPPartOutput(size_t max_part_size, const TAP_PART_GET_BUFFER &get_part_buffer, const TAP_PART_SUBMIT &submit_part)
+        : part_size(max_part_size), get_buffer(get_part_buffer), submit(submit_part), buffer(nullptr) {}
+
+    inline void Put(uint8_t byte)
+    {
+        Reserve(1);
+        buffer->push_back(byte);
+    }
+
+    inline void Put(const uint8_t *bytes, size_t count)
+    {
+        Reserve(count);
+        buffer->insert(buffer->end(), bytes, bytes + count);
+    }
+
+    inline void Fill(size_t count, uint8_t byte)
+    {
+        while(count > 0)
+        {
+            Reserve(1);
+            size_t part = std::min(count, part_size - buffer->size());
+            buffer->insert(buffer->end(), part, byte);
+            count -= part;
+        }
+    }
+
+    /// @brief  Give the last part to submit
+    void Flush()
+    {
+        if(buffer != nullptr)
+            submit(*buffer);
+        buffer = nullptr;
+    }
+
+private:
+    /// @brief  Make room for count bytes, a full part is given to submit
+    inline void Reserve(size_t count)
+    {
+        if(buffer != nullptr && buffer->size() + count > part_size)
+            Flush();
+
+        if(buffer == nullptr)
+        {
+            buffer = &get_buffer();
+            buffer->clear();
+            buffer->reserve(part_size);
+        }
+    }
+
+    const size_t part_size;
+    const TAP_PART_GET_BUFFER &get_buffer;
+    const TAP_PART_SUBMIT &submit;
+    std::vector<uint8_t> *buffer;
+};
+
+/// @brief  Render the tape program as TAP data (without TAP header)
+/// @param tap_data  The TAP data is appended
+/// @param tap_version  TAP version
+/// @note   In version 0 a pulse longer than 255*8 cycles is written as 0x00 (256*8 cycles)
+void TapeProgramClass::RenderTAP(std::vector<uint8_t> &tap_data, uint8_t tap_version) const
+{
+    tap_data.reserve(tap_data.size() + GetTAPDataSize(tap_version));
+    TAPVectorOutput output(tap_data);
+
+    CallWithTimingProfile(timing_profile, [&](auto timing)
+    {
+        RenderTAPData<decltype(timing)>(output, tap_version);
+    });
+}
+
+/// @brief  Render the tape program as TAP data (without TAP header) in parts, e.g. into the buffers of a writer thread
+/// @param tap_version  TAP version
+/// @param part_size  Max. size of a part in bytes (at least 20, the pulses of a kernal byte)
+/// @param get_buffer  Get an empty buffer for the next part, its content is replaced
+/// @param submit  Give a filled part back (the buffer of get_buffer with the size of the part)
+/// @note   Only the parts are in memory, the next part is rendered while the last one is written.
+void TapeProgramClass::RenderTAPParts(uint8_t tap_version, size_t part_size, const TAP_PART_GET_BUFFER &get_buffer, const TAP_PART_SUBMIT &submit) const
+{
+    TAPPartOutput output(part_size, get_buffer, submit);
+
+    CallWithTimingProfile(timing_profile, [&](auto timing)
+    {
+        RenderTAPData<decltype(timing)>(output, tap_version);
+    });
+
+    output.Flush();
+}
+
+/// @brief  Render the tape program as TAP data with the pulse table of a timing profile
+/// @param output  TAPVectorOutput or TAPPartOutput
+template<class TIMING, class OUTPUT>
+void TapeProgramClass::RenderTAPData(OUTPUT &output, uint8_t tap_version) const
+{
+    for(const TAPE_SEGMENT &segment : segments)
+    {
+        const uint8_t *bytes = byte_list.data() + segment.byte_offset;
+
+        switch(segment.type)
+        {
+        case TAPE_SEGMENT_PULSES:
+        {
+            uint32_t tap_byte = segment.pulse_length >> 3;
+            if(tap_byte == 0 || tap_byte > 255)
+            {
+                const uint8_t pause[4] = {0x00, static_cast<uint8_t>(segment.pulse_length), static_cast<uint8_t>(segment.pulse_length >> 8), static_cast<uint8_t>(segment.pulse_length >> 16)};
+                for(uint32_t i=0; i<segment.count; i++)
+                    output.Put(pause, tap_version == 1 ? 4 : 1);
+            }
+            else
+            {
+                output.Fill(segment.count, static_cast<uint8_t>(tap_byte));
+            }
+            break;
+        }
+
+        case TAPE_SEGMENT_KERNAL_BYTES:
+            // ByteMaker, the bits (LSB first) and the parity bit from the precalculated table
+            for(uint32_t i=0; i<segment.count; i++)
+            {
+                const uint8_t *pulses = TIMING::byte_pulse_table.pulses[bytes[i]];
+                output.Put(pulses, TAP_PULSES_PER_BYTE);
+            }
+            break;
+
+        case TAPE_SEGMENT_TURBO_BYTES:
+            for(uint32_t i=0; i<segment.count; i++)
+            {
+                for(int j=7; j>=0; j--)
+                    output.Put((bytes[i] >> j) & 1 ? TURBO_BIT1_PULSE_LENGTH >> 3 : TURBO_BIT0_PULSE_LENGTH >> 3);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef TAPE_PROGRAM_CLASS_H
+#define TAPE_PROGRAM_CLASS_H
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+#include "timing_profile.h"
+
+enum TAPE_SEGMENT_TYPE {TAPE_SEGMENT_PULSES, TAPE_SEGMENT_KERNAL_BYTES, TAPE_SEGMENT_TURBO_BYTES};
+
+// Functions of RenderTAPParts: get an empty buffer for the next part, give a filled part back
+typedef std::function<std::vector<uint8_t>&()> TAP_PART_GET_BUFFER;
+typedef std::function<void(std::vector<uint8_t> &buffer)> TAP_PART_SUBMIT;
+
+struct TAPE_SEGMENT
+{
+    uint8_t type;           // TAPE_SEGMENT_TYPE
+    uint32_t pulse_length;  // Length of the pulses in cycles (TAPE_SEGMENT_PULSES)
+    uint32_t count;         // Number of pulses or bytes
+    uint32_t byte_offset;   // Position of the first byte in the byte list (TAPE_SEGMENT_*_BYTES)
+};
+
+/// @brief  Tape program, the encoded pulses of a tape as a compact list of segments
+/// @note   A segment is a run of pulses with the same length (leader, pause, marker)
+///         or a run of bytes which are encoded as kernal bytes (20 pulses) or
+///         turbo bytes (8 pulses). The program is created once by the encoder and
+///         rendered by every output format (TAP, WAV, CSW). The pulse lengths
+///         of the kernal bytes are taken from the timing profile of the program.
+class TapeProgramClass
+{
+public:
+    TapeProgramClass();
+    void Clear();
+    void AddPulses(uint32_t pulse_length, uint32_t count = 1);
+    void AddKernalBytes(const uint8_t *bytes, uint32_t count);
+    void AddKernalByte(uint8_t byte);
+    void AddTurboBytes(const uint8_t *bytes, uint32_t count);
+    void AddTurboByte(uint8_t byte);
+    void Append(const TapeProgramClass &program);
+    void SetTimingProfile(int profile);
+    int GetTimingProfile() const;
+
+    const std::vector<TAPE_SEGMENT> &GetSegments() const;
+    const uint8_t *GetBytes() const;
+    uint64_t GetPulseCount() const;
+    uint32_t GetTAPDataSize(uint8_t tap_version) const;
+    uint64_t GetTotalCycles() const;
+    uint64_t GetSegmentCycles(const TAPE_SEGMENT &segment, uint32_t first, uint32_t count) const;
+    void RenderTAP(std::vector<uint8_t> &tap_data, uint8_t tap_version) const;
+    void RenderTAPParts(uint8_t tap_version, size_t part_size, const TAP_PART_GET_BUFFER &get_buffer, const TAP_PART_SUBMIT &submit) const;
+
+private:
+    void AddBytes(uint8_t type, const uint8_t *bytes, uint32_t count);
+    template<class TIMING, class OUTPUT> void RenderTAPData(OUTPUT &output, uint8_t tap_version) const;
+
+    std::vector<TAPE_SEGMENT> segments;
+    std::vector<uint8_t> byte_list;
+    int timing_profile;     // TIMING_PROFILE
+};
+
+#endif // TAPE_PROGRAM_CLASS_H
@@ -0,0 +1,151 @@
+#ifndef TIMING_PROFILE_H
+#define TIMING_PROFILE_H
+
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+
+// Timing profiles of the machines
+// The kernal writes its pulses with the CIA timer, therefore the pulse lengths
+// in cycles are the same on all machines, only the clock (and with it the
+// frequencies on the tape) differs.
+// Cycles per second (PAL): 985248
+// Cycles per second (NTSC): 1022727
+// Cycles per second (Drean, PAL-N): 1023440
+enum TIMING_PROFILE {TIMING_PAL, TIMING_NTSC, TIMING_DREAN, TIMING_USER};
+
+// Video standard in the TAP header (offset 0x0E)
+#define TAP_VIDEO_PAL 0
+#define TAP_VIDEO_NTSC 1
+#define TAP_VIDEO_PAL_N 3
+
+// User defined timing profile, set at compile time (cmake -DUSER_TIMING_CYCLES_PER_SECOND=... etc.)
+// Without a definition the PAL values are used
+#ifndef USER_TIMING_CYCLES_PER_SECOND
+#define USER_TIMING_CYCLES_PER_SECOND TAP_CYCLES_PER_SECOND
+#endif
+#ifndef USER_TIMING_SHORT_PULSE
+#define USER_TIMING_SHORT_PULSE SHORT_PULSE_LENGTH
+#endif
+#ifndef USER_TIMING_MEDIUM_PULSE
+#define USER_TIMING_MEDIUM_PULSE MEDIUM_PULSE_LENGTH
+#endif
+#ifndef USER_TIMING_LONG_PULSE
+#define USER_TIMING_LONG_PULSE LONG_PULSE_LENGTH
+#endif
+#ifndef USER_TIMING_VIDEO_STANDARD
+#define USER_TIMING_VIDEO_STANDARD TAP_VIDEO_PAL
+#endif
+
+/// @brief  Timing of a machine as compile time policy
+/// @note   Encoder, WAV synthesizer and decoder are instantiated with a profile,
+///         all values are constants in the generated code. The decoder windows
+///         are the VICE windows scaled to the pulse lengths, for the PAL lengths
+///         they are exactly the VICE values.
+template<uint32_t CYCLES_PER_SECOND, uint32_t SHORT_LENGTH, uint32_t MEDIUM_LENGTH, uint32_t LONG_LENGTH, uint8_t VIDEO_STANDARD>
+struct TimingProfile
+{
+    static_assert(SHORT_LENGTH < MEDIUM_LENGTH && MEDIUM_LENGTH < LONG_LENGTH, "Pulse lengths must be short < medium < long");
+    static_assert((SHORT_LENGTH >> 3) > 0 && (LONG_LENGTH >> 3) <= 0xFF, "Pulse lengths must fit in one TAP data byte");
+
+    static constexpr uint32_t cycles_per_second = CYCLES_PER_SECOND;
+    static constexpr uint8_t video_standard = VIDEO_STANDARD;
+
+    // Pulse lengths of the encoder (C64 cycles)
+    static constexpr uint32_t short_pulse_length = SHORT_LENGTH;
+    static constexpr uint32_t medium_pulse_length = MEDIUM_LENGTH;
+    static constexpr uint32_t long_pulse_length = LONG_LENGTH;
+
+    // Pulse windows of the decoder (C64 cycles)
+    static constexpr uint32_t short_pulse_min = SHORT_LENGTH * SHORT_PULSE_MIN / SHORT_PULSE_LENGTH;
+    static constexpr uint32_t short_pulse_max = SHORT_LENGTH * SHORT_PULSE_MAX / SHORT_PULSE_LENGTH;
+    static constexpr uint32_t medium_pulse_min = MEDIUM_LENGTH * MEDIUM_PULSE_MIN / MEDIUM_PULSE_LENGTH;
+    static constexpr uint32_t medium_pulse_max = MEDIUM_LENGTH * MEDIUM_PULSE_MAX / MEDIUM_PULSE_LENGTH;
+    static constexpr uint32_t long_pulse_min = LONG_LENGTH * LONG_PULSE_MIN / LONG_PULSE_LENGTH;
+    static constexpr uint32_t long_pulse_max = LONG_LENGTH * LONG_PULSE_MAX / LONG_PULSE_LENGTH;
+
+    static_assert(short_pulse_max < medium_pulse_min && medium_pulse_max < long_pulse_min, "Pulse windows overlap");
+
+    // Frequencies of the WAV synthesizer (one sine period per pulse)
+    static constexpr float short_pulse_frequency = static_cast<float>(CYCLES_PER_SECOND) / static_cast<float>(SHORT_LENGTH);
+    static constexpr float medium_pulse_frequency = static_cast<float>(CYCLES_PER_SECOND) / static_cast<float>(MEDIUM_LENGTH);
+    static constexpr float long_pulse_frequency = static_cast<float>(CYCLES_PER_SECOND) / static_cast<float>(LONG_LENGTH);
+
+    // Pulses (TAP data bytes) of all 256 kernal bytes
+    static constexpr TAP_BYTE_PULSE_TABLE byte_pulse_table = CreateTAPBytePulseTable(SHORT_LENGTH >> 3, MEDIUM_LENGTH >> 3, LONG_LENGTH >> 3);
+
+    /// @brief  Get the type of a pulse
+    /// @param pulse_length  Length of the pulse in C64 cycles
+    /// @return  Type of the pulse (Short, Medium, Long, Unknown)
+    static constexpr uint8_t GetPulseType(uint32_t pulse_length)
+    {
+        if(pulse_length >= short_pulse_min && pulse_length <= short_pulse_max)
+            return SHORT_PULSE;
+        else if(pulse_length >= medium_pulse_min && pulse_length <= medium_pulse_max)
+            return MEDIUM_PULSE;
+        else if(pulse_length >= long_pulse_min && pulse_length <= long_pulse_max)
+            return LONG_PULSE;
+        else
+            return UNKNOWN_PULSE;
+    }
+};
+
+template<uint32_t CYCLES_PER_SECOND, uint32_t SHORT_LENGTH, uint32_t MEDIUM_LENGTH, uint32_t LONG_LENGTH, uint8_t VIDEO_STANDARD>
+constexpr TAP_BYTE_PULSE_TABLE TimingProfile<CYCLES_PER_SECOND, SHORT_LENGTH, MEDIUM_LENGTH, LONG_LENGTH, VIDEO_STANDARD>::byte_pulse_table;
+
+typedef TimingProfile<TAP_CYCLES_PER_SECOND, SHORT_PULSE_LENGTH, MEDIUM_PULSE_LENGTH, LONG_PULSE_LENGTH, TAP_VIDEO_PAL> PAL_TIMING;
+typedef TimingProfile<1022727, SHORT_PULSE_LENGTH, MEDIUM_PULSE_LENGTH, LONG_PULSE_LENGTH, TAP_VIDEO_NTSC> NTSC_TIMING;
+typedef TimingProfile<1023440, SHORT_PULSE_LENGTH, MEDIUM_PULSE_LENGTH, LONG_PULSE_LENGTH, TAP_VIDEO_PAL_N> DREAN_TIMING;
+typedef TimingProfile<USER_TIMING_CYCLES_PER_SECOND, USER_TIMING_SHORT_PULSE, USER_TIMING_MEDIUM_PULSE, USER_TIMING_LONG_PULSE, USER_TIMING_VIDEO_STANDARD> USER_TIMING;
+
+/// @brief  Call a function with the profile type selected at runtime
+/// @param timing_profile  Timing profile (TIMING_PROFILE)
+/// @param function  Function object with the profile as parameter, e.g. [&](auto timing) {...}
+/// @return  Return value of the function
+/// @note   The function is instantiated for every profile, the switch is done once per call.
+template<typename FUNCTION>
+inline auto CallWithTimingProfile(int timing_profile, FUNCTION function) -> decltype(function(PAL_TIMING()))
+{
+    switch(timing_profile)
+    {
+    case TIMING_NTSC:
+        return function(NTSC_TIMING());
+    case TIMING_DREAN:
+        return function(DREAN_TIMING());
+    case TIMING_USER:
+        return function(USER_TIMING());
+    default:
+        return function(PAL_TIMING());
+    }
+}
+
+/// @brief  Get the name of a timing profile
+inline const char *GetTimingProfileName(int timing_profile)
+{
+    switch(timing_profile)
+    {
+    case TIMING_NTSC:
+        return "NTSC";
+    case TIMING_DREAN:
+        return "Drean";
+    case TIMING_USER:
+        return "User";
+    default:
+        return "PAL";
+    }
+}
+
+/// @brief  Get the clock of a timing profile
+/// @return  Cycles per second
+inline uint32_t GetTimingCyclesPerSecond(int timing_profile)
+{
+    return CallWithTimingProfile(timing_profile, [](auto timing) -> uint32_t { return decltype(timing)::cycles_per_second; });
+}
+
+/// @brief  Get the video standard of a timing profile for the TAP header
+inline uint8_t GetTimingVideoStandard(int timing_profile)
+{
+    return CallWithTimingProfile(timing_profile, [](auto timing) -> uint8_t { return decltype(timing)::video_standard; });
+}
+
+#endif // TIMING_PROFILE_H
@@ -0,0 +1,454 @@
+#include "./wav_file.h"
+#include <string.h>
+#include <math.h>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#define WAV_CHUNK_SECONDS 1                     // Length of a chunk of the parallel conversion
+#define WAV_ZERO_SEARCH_DIVIDER 1000            // Max. distance of the zero crossing before the low threshold (1 ms)
+
+struct WAV_INFO
+{
+    uint16_t format_tag;        // WAV_FORMAT_TAG_PCM or WAV_FORMAT_TAG_FLOAT
+    uint16_t bits_per_sample;
+    uint16_t block_align;       // Bytes per sample of all channels
+    uint32_t sample_rate;
+    const uint8_t *data;        // First sample
+    uint64_t sample_count;      // Samples per channel
+};
+
+struct WAV_CHUNK
+{
+    uint64_t start;             // First sample of the chunk
+    uint64_t end;               // Behind the last sample of the chunk
+    std::vector<double> edges;  // Falling edges (sample position) behind the first threshold crossing
+    bool has_first_edge;        // The first threshold crossing is low, it is an edge if the level before the chunk was high
+    double first_edge;
+    int64_t first_crossing;     // First sample above or below the thresholds (-1 without threshold crossing)
+    int last_level;             // Level at the end of the chunk (WAV_LEVEL_UNKNOWN without threshold crossing)
+    int64_t last_high;          // Last sample above the high threshold (if last_level is high)
+    bool has_wave_end;          // End of the last wave (falling zero crossing behind last_high), an edge if silence follows
+    double wave_end;
+};
+
+static uint16_t ReadLE16(const uint8_t *data)
+{
+    return static_cast<uint16_t>(data[0] | data[1] << 8);
+}
+
+static uint32_t ReadLE32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24);
+}
+
+/// @brief  Check if the given data is a WAV file
+/// @param data  Pointer to the file data
+/// @param size  Size of the file data
+/// @return  True if the data starts with a RIFF WAVE header
+bool IsWAVFile(const uint8_t *data, size_t size)
+{
+    return size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0;
+}
+
+/// @brief  Find the format and the samples of a WAV file
+/// @return  True if the sample format is supported
+/// @note   A data chunk which is longer than the file (aborted recording) is
+///         read up to the end of the file.
+static bool ParseWAVFile(const uint8_t *wav_data, size_t wav_size, WAV_INFO &wav)
+{
+    bool has_format = false;
+    size_t pos = 12;
+
+    while(pos + 8 <= wav_size)
+    {
+        const uint8_t *chunk = wav_data + pos;
+        size_t chunk_size = ReadLE32(chunk + 4);
+        pos += 8;
+
+        if(memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && pos + 16 <= wav_size)
+        {
+            wav.format_tag = ReadLE16(chunk + 8);
+            wav.sample_rate = ReadLE32(chunk + 12);
+            wav.block_align = ReadLE16(chunk + 20);
+            wav.bits_per_sample = ReadLE16(chunk + 22);
+
+            // WAVE_FORMAT_EXTENSIBLE, the format is in the first 2 bytes of the sub format GUID
+            if(wav.format_tag == WAV_FORMAT_TAG_EXTENSIBLE && chunk_size >= 40 && pos + 40 <= wav_size)
+                wav.format_tag = ReadLE16(chunk + 32);
+
+            has_format = true;
+        }
+        else if(memcmp(chunk, "data", 4) == 0)
+        {
+            if(!has_format)
+                break;
+
+            if(!IsPCMFormatSupported(wav.format_tag, wav.bits_per_sample) || wav.block_align < wav.bits_per_sample / 8 || wav.sample_rate == 0)
+            {
+                printf("WAV format %d with %d bit is not supported.\n", wav.format_tag, wav.bits_per_sample);
+                return false;
+            }
+
+            wav.data = wav_data + pos;
+            wav.sample_count = std::min(chunk_size, wav_size - pos) / wav.block_align;
+            return true;
+        }
+
+        // Chunks are aligned to 2 bytes
+        pos += chunk_size + (chunk_size & 1);
+    }
+
+    printf("WAV file without format or data.\n");
+    return false;
+}
+
+/// @brief  Check if a sample format is supported by ConvertPCMSamples
+/// @param format_tag  WAV_FORMAT_TAG_PCM or WAV_FORMAT_TAG_FLOAT
+/// @param bits_per_sample  Bits of one sample
+bool IsPCMFormatSupported(uint16_t format_tag, uint16_t bits_per_sample)
+{
+    if(format_tag == WAV_FORMAT_TAG_PCM)
+        return bits_per_sample == 8 || bits_per_sample == 16 || bits_per_sample == 24 || bits_per_sample == 32;
+    if(format_tag == WAV_FORMAT_TAG_FLOAT)
+        return bits_per_sample == 32 || bits_per_sample == 64;
+    return false;
+}
+
+/// @brief  Convert PCM samples (little endian) to float (-1.0 - 1.0)
+/// @param src  First sample
+/// @param n  Number of samples
+/// @param stride  Bytes from sample to sample (all channels), only the first channel is read
+/// @param format_tag  WAV_FORMAT_TAG_PCM or WAV_FORMAT_TAG_FLOAT
+/// @param bits_per_sample  Bits of one sample
+/// @param dst  Buffer for n samples
+/// @note   The format is selected once per call, every format is a simple loop.
+void ConvertPCMSamples(const uint8_t *src, size_t n, size_t stride, uint16_t format_tag, uint16_t bits_per_sample, float *dst)
+{
+    if(format_tag == WAV_FORMAT_TAG_FLOAT)
+    {
+        if(bits_per_sample == 32)
+        {
+            for(size_t i = 0; i < n; i++)
+                memcpy(&dst[i], src + i * stride, sizeof(float));
+        }
+        else
+        {
+            for(size_t i = 0; i < n; i++)
+            {
+                double value;
+                memcpy(&value, src + i * stride, sizeof(double));
+                dst[i] = static_cast<float>(value);
+            }
+        }
+        return;
+    }
+
+    switch(bits_per_sample)
+    {
+    case 8:
+        // 8 bit unsigned, 128 = 0
+        for(size_t i = 0; i < n; i++)
+            dst[i] = static_cast<float>(src[i * stride] - 128) * (1.0f / 128.0f);
+        break;
+    case 16:
+        for(size_t i = 0; i < n; i++)
+            dst[i] = static_cast<float>(static_cast<int16_t>(ReadLE16(src + i * stride))) * (1.0f / 32768.0f);
+        break;
+    case 24:
+        // The 24 bit are shifted to the upper bytes of a 32 bit value (sign)
+        for(size_t i = 0; i < n; i++)
+        {
+            const uint8_t *sample = src + i * stride;
+            uint32_t value = static_cast<uint32_t>(sample[0] << 8 | sample[1] << 16 | sample[2] << 24);
+            dst[i] = static_cast<float>(static_cast<int32_t>(value)) * (1.0f / 2147483648.0f);
+        }
+        break;
+    default:
+        for(size_t i = 0; i < n; i++)
+            dst[i] = static_cast<float>(static_cast<int32_t>(ReadLE32(src + i * stride))) * (1.0f / 2147483648.0f);
+        break;
+    }
+}
+
+/// @brief  Read samples of the first channel as float (-1.0 - 1.0)
+/// @param wav  WAV file
+/// @param first  First sample, can be negative
+/// @param count  Number of samples
+/// @param samples  Buffer for count samples, samples outside of the file are 0.0
+static void ReadSamples(const WAV_INFO &wav, int64_t first, size_t count, float *samples)
+{
+    std::fill_n(samples, count, 0.0f);
+
+    int64_t begin = std::max<int64_t>(first, 0);
+    int64_t end = std::min<int64_t>(first + static_cast<int64_t>(count), static_cast<int64_t>(wav.sample_count));
+    if(begin >= end)
+        return;
+
+    ConvertPCMSamples(wav.data + static_cast<size_t>(begin) * wav.block_align, static_cast<size_t>(end - begin), wav.block_align, wav.format_tag, wav.bits_per_sample, samples + (begin - first));
+}
+
+/// @brief  Find the falling zero crossing before a sample
+/// @param signal  Filtered samples
+/// @param pos  Sample below the low threshold
+/// @param max_distance  Max. number of samples to search back
+/// @return  Position of the zero crossing (interpolated between the samples), pos if none was found
+static double FindZeroCrossing(const std::vector<float> &signal, size_t pos, size_t max_distance)
+{
+    for(size_t i = pos; i > 0 && pos - i < max_distance; i--)
+    {
+        if(signal[i - 1] >= 0.0f)
+            return static_cast<double>(i - 1) + signal[i - 1] / (signal[i - 1] - signal[i]);
+    }
+    return static_cast<double>(pos);
+}
+
+/// @brief  Find the end of a wave (the signal falls to zero) behind a sample
+/// @param signal  Filtered samples
+/// @param pos  Sample above the high threshold
+/// @param wave_end  Position of the zero crossing
+/// @return  True if the zero crossing was found before the end of the samples
+/// @note   The silence behind the wave is not a continuation of the wave, so
+///         the zero crossing is extrapolated from the falling slope of the
+///         last two samples (at most up to the first sample of the silence).
+static bool FindWaveEnd(const std::vector<float> &signal, size_t pos, double &wave_end)
+{
+    for(size_t i = pos + 1; i < signal.size(); i++)
+    {
+        if(signal[i] <= 0.0f)
+        {
+            float slope = signal[i - 2] - signal[i - 1];
+            if(slope > 0.0f)
+                wave_end = static_cast<double>(i - 1) + std::min(1.0f, signal[i - 1] / slope);
+            else
+                wave_end = static_cast<double>(i - 1) + signal[i - 1] / (signal[i - 1] - signal[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief  Find the falling edges of a chunk
+/// @param wav  WAV file
+/// @param chunk  Chunk, start and end are set, the edges are found
+/// @note   The samples of the chunk are read with the filter windows and the
+///         zero search area before it (overlap with the neighbor chunks), so
+///         every chunk is independent of the others. The filters (low pass,
+///         DC removal) are simple loops over the buffer. The hysteresis starts
+///         with an unknown level, the first threshold crossing and a silence
+///         at the start of the chunk are resolved when the chunks are joined
+///         in order.
+static void FindChunkEdges(const WAV_INFO &wav, WAV_CHUNK &chunk)
+{
+    const size_t half_window = std::max<size_t>(1, wav.sample_rate / WAV_DC_FILTER_DIVIDER / 2);
+    const size_t zero_search = wav.sample_rate / WAV_ZERO_SEARCH_DIVIDER + 2;
+    const size_t silence = wav.sample_rate / WAV_SILENCE_DIVIDER;
+    const size_t chunk_end = zero_search + static_cast<size_t>(chunk.end - chunk.start);
+    const size_t signal_count = chunk_end + zero_search;
+    const size_t count = signal_count + 2 * half_window + 2;
+    const int64_t first = static_cast<int64_t>(chunk.start) - static_cast<int64_t>(zero_search + half_window + 1);
+
+    // The loops work on pointers, so they are simple enough for the auto vectorizer
+    std::vector<float> samples(count);
+    std::vector<float> filtered(count);
+    std::vector<double> sum(count + 1);
+    std::vector<float> signal(signal_count);
+    float *in = samples.data();
+    float *lp = filtered.data();
+    double *acc = sum.data();
+    float *out = signal.data();
+
+    ReadSamples(wav, first, count, in);
+
+    // Low pass [1 2 1] / 4 against the hiss above the pulse frequencies
+    lp[0] = in[0];
+    lp[count - 1] = in[count - 1];
+    if(wav.sample_rate >= WAV_LOW_PASS_MIN_SAMPLE_RATE)
+    {
+        for(size_t i = 1; i < count - 1; i++)
+            lp[i] = 0.25f * in[i - 1] + 0.5f * in[i] + 0.25f * in[i + 1];
+    }
+    else
+    {
+        memcpy(lp, in, count * sizeof(float));
+    }
+
+    // DC removal, centered moving average (prefix sums in double)
+    acc[0] = 0.0;
+    for(size_t i = 0; i < count; i++)
+        acc[i + 1] = acc[i] + lp[i];
+
+    // signal[0] is the sample chunk.start - zero_search, the zero search area is also behind the chunk
+    const double window_scale = 1.0 / static_cast<double>(2 * half_window + 1);
+    const float *center = lp + half_window + 1;
+    const double *window_end = acc + 2 * half_window + 2;
+    const double *window_start = acc + 1;
+    for(size_t i = 0; i < signal_count; i++)
+        out[i] = center[i] - static_cast<float>((window_end[i] - window_start[i]) * window_scale);
+
+    // Thresholds from the peak level of the chunk (automatic gain)
+    float peak = 0.0f;
+    for(size_t i = zero_search; i < chunk_end; i++)
+    {
+        float value = out[i] < 0.0f ? -out[i] : out[i];
+        peak = value > peak ? value : peak;
+    }
+    const float threshold = std::max(WAV_MIN_LEVEL, peak * WAV_HYSTERESIS_LEVEL);
+
+    // Hysteresis, a falling edge is the zero crossing before the change from high to low.
+    // A silence behind a wave ends the pulse at the end of the wave, the silence is a pause.
+    const double position_offset = static_cast<double>(chunk.start) - static_cast<double>(zero_search);
+    const int64_t sample_offset = static_cast<int64_t>(chunk.start) - static_cast<int64_t>(zero_search);
+    int level = WAV_LEVEL_UNKNOWN;
+    size_t last_high = 0;
+    chunk.has_first_edge = false;
+    chunk.first_edge = 0.0;
+    chunk.first_crossing = -1;
+
+    for(size_t i = zero_search; i < chunk_end; i++)
+    {
+        const float value = out[i];
+        if(value > threshold || value < -threshold)
+        {
+            double wave_end;
+            if(level == WAV_LEVEL_HIGH && i - last_high > silence && FindWaveEnd(signal, last_high, wave_end))
+                chunk.edges.push_back(wave_end + position_offset);
+            if(chunk.first_crossing < 0)
+                chunk.first_crossing = static_cast<int64_t>(i) + sample_offset;
+        }
+
+        if(value > threshold)
+        {
+            level = WAV_LEVEL_HIGH;
+            last_high = i;
+        }
+        else if(value < -threshold && level != WAV_LEVEL_LOW)
+        {
+            double edge = FindZeroCrossing(signal, i, zero_search) + position_offset;
+            if(level == WAV_LEVEL_HIGH)
+            {
+                chunk.edges.push_back(edge);
+            }
+            else
+            {
+                chunk.has_first_edge = true;
+                chunk.first_edge = edge;
+            }
+            level = WAV_LEVEL_LOW;
+        }
+    }
+
+    chunk.last_level = level;
+    chunk.last_high = static_cast<int64_t>(last_high) + sample_offset;
+    chunk.has_wave_end = level == WAV_LEVEL_HIGH && FindWaveEnd(signal, last_high, chunk.wave_end);
+    chunk.wave_end += position_offset;
+}
+
+/// @brief  Convert a WAV file (a capture of a tape) to a TAP version 1 image
+/// @param wav_data  Pointer to the WAV file data
+/// @param wav_size  Size of the WAV file data
+/// @param tap_image  Complete TAP file (header and pulses)
+/// @param cycles_per_second  Clock of the machine (timing profile)
+/// @return  True if the WAV file could be converted
+/// @note   The recording is split into chunks of one second, which are
+///         filtered and searched for edges in parallel on all cores. The
+///         edges are joined in order with the level at the end of the previous
+///         chunk, so the result is the same as with one pass. The sample
+///         positions of the edges are converted to cycles (no drift), the
+///         silence before the first edge is not stored and silences (also at
+///         the end of the recording) are v1 pauses.
+bool ConvertWAVToTAP(const uint8_t *wav_data, size_t wav_size, std::vector<uint8_t> &tap_image, uint32_t cycles_per_second)
+{
+    if(!IsWAVFile(wav_data, wav_size))
+        return false;
+
+    WAV_INFO wav;
+    if(!ParseWAVFile(wav_data, wav_size, wav))
+        return false;
+
+    uint64_t chunk_size = static_cast<uint64_t>(wav.sample_rate) * WAV_CHUNK_SECONDS;
+    std::vector<WAV_CHUNK> chunks(static_cast<size_t>((wav.sample_count + chunk_size - 1) / chunk_size));
+    for(size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i].start = i * chunk_size;
+        chunks[i].end = std::min(chunks[i].start + chunk_size, wav.sample_count);
+    }
+
+    std::atomic<size_t> next_chunk(0);
+    size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), chunks.size()));
+    std::vector<std::thread> threads;
+
+    for(size_t i = 0; i < thread_count; i++)
+    {
+        threads.push_back(std::thread([&wav, &chunks, &next_chunk]()
+        {
+            size_t chunk;
+            while((chunk = next_chunk++) < chunks.size())
+                FindChunkEdges(wav, chunks[chunk]);
+        }));
+    }
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    // TAP header (version 1), the data size is set at the end
+    size_t edge_count = 0;
+    for(size_t i = 0; i < chunks.size(); i++)
+        edge_count += chunks[i].edges.size() + 1;
+
+    tap_image.assign("C64-TAPE-RAW", "C64-TAPE-RAW" + 12);
+    tap_image.reserve(TAP_DATA_START + edge_count);
+    tap_image.push_back(1);
+    tap_image.insert(tap_image.end(), 7, 0x00);
+
+    // Sample positions are converted to cycles with the accumulated position, so there is no drift
+    const double cycles_per_sample = static_cast<double>(cycles_per_second) / wav.sample_rate;
+    bool first_edge = true;
+    uint64_t cycle_pos = 0;
+
+    auto AddEdge = [&](double edge)
+    {
+        // The filters can move an edge at the start of the recording before the first sample
+        uint64_t new_cycle_pos = static_cast<uint64_t>(std::max(edge, 0.0) * cycles_per_sample + 0.5);
+        if(!first_edge && new_cycle_pos > cycle_pos)
+            AddTAPPulse(tap_image, new_cycle_pos - cycle_pos);
+        first_edge = false;
+        cycle_pos = std::max(cycle_pos, new_cycle_pos);
+    };
+
+    // Before the recording the level is high, so the first pulse starts at its falling edge
+    const int64_t silence = wav.sample_rate / WAV_SILENCE_DIVIDER;
+    int level = WAV_LEVEL_HIGH;
+    const WAV_CHUNK *last_wave = nullptr;       // Chunk with the last threshold crossing
+
+    for(size_t i = 0; i < chunks.size(); i++)
+    {
+        WAV_CHUNK &chunk = chunks[i];
+        if(chunk.first_crossing >= 0)
+        {
+            if(level == WAV_LEVEL_HIGH && last_wave != nullptr && last_wave->has_wave_end && chunk.first_crossing - last_wave->last_high > silence)
+                AddEdge(last_wave->wave_end);
+            if(chunk.has_first_edge && level == WAV_LEVEL_HIGH)
+                AddEdge(chunk.first_edge);
+        }
+        for(size_t j = 0; j < chunk.edges.size(); j++)
+            AddEdge(chunk.edges[j]);
+
+        if(chunk.last_level != WAV_LEVEL_UNKNOWN)
+        {
+            level = chunk.last_level;
+            last_wave = &chunk;
+        }
+        std::vector<double>().swap(chunk.edges);
+    }
+
+    // End of the last wave at the end of the recording
+    if(level == WAV_LEVEL_HIGH && last_wave != nullptr && last_wave->has_wave_end)
+        AddEdge(last_wave->wave_end);
+
+    uint32_t tap_data_size = static_cast<uint32_t>(tap_image.size() - TAP_DATA_START);
+    for(int i=0; i<4; i++)
+        tap_image[16 + i] = static_cast<uint8_t>(tap_data_size >> (i * 8));
+
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <vector>
+#include <inttypes.h>
+#include <cstddef>
+
+#include "tap_pulse.h"
+
+// WAV (RIFF) capture of a tape
+// Supported are PCM with 8, 16, 24 or 32 bit and IEEE float with 32 or 64 bit,
+// of a multi channel file only the first channel is read.
+// One TAP pulse is the time from falling edge to falling edge.
+#define WAV_FORMAT_TAG_PCM 0x0001
+#define WAV_FORMAT_TAG_FLOAT 0x0003
+#define WAV_FORMAT_TAG_EXTENSIBLE 0xFFFE
+
+// Digitizer (WAV files and live capture)
+#define WAV_DC_FILTER_DIVIDER 50                // Window of the DC removal (1/50 second)
+#define WAV_LOW_PASS_MIN_SAMPLE_RATE 32000      // The low pass is used only if the short pulses have enough samples
+#define WAV_HYSTERESIS_LEVEL 0.2f               // Thresholds of the hysteresis (part of the peak level)
+#define WAV_MIN_LEVEL 0.02f                     // Min. threshold, noise in the silence gives no pulses
+#define WAV_SILENCE_DIVIDER 400                 // Min. silence behind a wave (1/400 second, longer than a pulse of 0xFF)
+
+enum WAV_LEVEL {WAV_LEVEL_UNKNOWN, WAV_LEVEL_LOW, WAV_LEVEL_HIGH};
+
+bool IsPCMFormatSupported(uint16_t format_tag, uint16_t bits_per_sample);
+void ConvertPCMSamples(const uint8_t *src, size_t n, size_t stride, uint16_t format_tag, uint16_t bits_per_sample, float *dst);
+bool IsWAVFile(const uint8_t *data, size_t size);
+bool ConvertWAVToTAP(const uint8_t *wav_data, size_t wav_size, std::vector<uint8_t> &tap_image, uint32_t cycles_per_second = TAP_CYCLES_PER_SECOND);
+
+#endif // WAV_FILE_H
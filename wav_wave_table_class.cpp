@@ -0,0 +1,315 @@
+#include "./wav_wave_table_class.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+WAVWaveTableClass::WAVWaveTableClass()
+{
+    sample_rate = WAV_DEFAULT_SAMPLE_RATE;
+    cycles_per_second = TAP_CYCLES_PER_SECOND;
+    sample_format = WAV_FORMAT_FLOAT;
+    sample_size = sizeof(float);
+    waveform = WAV_WAVE_SINE;
+    amplitude = 1.0f;
+    phase = 0;
+    kernal_pulses[0] = kernal_pulses[1] = kernal_pulses[2] = nullptr;
+    memset(square_low, 0, sizeof(square_low));
+    memset(square_high, 0, sizeof(square_high));
+    memset(silence, 0, sizeof(silence));
+    memset(tap_byte_pulses, 0, sizeof(tap_byte_pulses));
+}
+
+/// @brief  Prepare the waveforms for a sample rate and the pulse lengths of a timing profile
+/// @param new_sample_rate  Sample rate in Hz
+/// @param new_cycles_per_second  Clock of the timing profile
+/// @param short_length  Length of the short pulse in cycles
+/// @param medium_length  Length of the medium pulse in cycles
+/// @param long_length  Length of the long pulse in cycles
+/// @param new_sample_format  Sample format (WAV_SAMPLE_FORMAT)
+/// @param new_waveform  Waveform of the pulses (WAV_WAVEFORM)
+/// @param new_amplitude  Amplitude (0.0 - 1.0)
+void WAVWaveTableClass::Create(uint32_t new_sample_rate, uint32_t new_cycles_per_second, uint32_t short_length, uint32_t medium_length, uint32_t long_length, int new_sample_format, int new_waveform, float new_amplitude)
+{
+    sample_rate = new_sample_rate;
+    cycles_per_second = new_cycles_per_second;
+    sample_format = new_sample_format;
+    waveform = new_waveform;
+    amplitude = new_amplitude;
+    phase = 0;
+
+    switch(sample_format)
+    {
+    case WAV_FORMAT_PCM16:
+        sample_size = 2;
+        break;
+    case WAV_FORMAT_PCM8:
+        sample_size = 1;
+        break;
+    default:
+        sample_size = sizeof(float);
+        break;
+    }
+
+    ConvertSample(-amplitude, square_low);
+    ConvertSample(amplitude, square_high);
+    ConvertSample(0.0f, silence);
+
+    pulse_list.clear();
+    memset(tap_byte_pulses, 0, sizeof(tap_byte_pulses));
+    kernal_pulses[0] = &GetPulseWaves(short_length);
+    kernal_pulses[1] = &GetPulseWaves(medium_length);
+    kernal_pulses[2] = &GetPulseWaves(long_length);
+
+    // Kernal byte: ByteMarker (Long + Medium), 8 bits (LSB first) and the odd parity bit
+    // Bit 0 = Short + Medium, Bit 1 = Medium + Short
+    for(int byte = 0; byte < 256; byte++)
+    {
+        uint8_t *pulses = kernal_byte_pulses[byte];
+        int pulse_count = 0;
+
+        pulses[pulse_count++] = 2;
+        pulses[pulse_count++] = 1;
+
+        uint8_t parity_bit = 1;
+        for(int i = 0; i < 9; i++)
+        {
+            bool bit;
+            if(i < 8)
+            {
+                bit = (byte >> i) & 1;
+                parity_bit ^= bit ? 1 : 0;
+            }
+            else
+                bit = parity_bit == 1;
+
+            pulses[pulse_count++] = bit ? 1 : 0;
+            pulses[pulse_count++] = bit ? 0 : 1;
+        }
+    }
+}
+
+uint32_t WAVWaveTableClass::GetSampleRate() const
+{
+    return sample_rate;
+}
+
+/// @brief  Get the sample format (WAV_SAMPLE_FORMAT)
+int WAVWaveTableClass::GetSampleFormat() const
+{
+    return sample_format;
+}
+
+/// @brief  Get the size of one sample in bytes
+uint32_t WAVWaveTableClass::GetSampleSize() const
+{
+    return sample_size;
+}
+
+/// @brief  Start a new tape (first pulse at sample 0)
+void WAVWaveTableClass::ResetPhase()
+{
+    phase = 0;
+}
+
+/// @brief  Number of samples of a part of the tape
+/// @param cycles  Cycles from the start of the tape
+/// @return  Number of samples which are written for these cycles (size of the sample buffer)
+uint64_t WAVWaveTableClass::GetSampleCount(uint64_t cycles) const
+{
+    return (cycles * sample_rate + cycles_per_second - 1) / cycles_per_second;
+}
+
+/// @brief  Set the phase accumulator to a position of the tape, as if all pulses before were written
+/// @param cycles  Cycles from the start of the tape
+/// @return  Index of the next sample, a part of the tape can be rendered without the pulses before
+uint64_t WAVWaveTableClass::SetTapePosition(uint64_t cycles)
+{
+    uint64_t samples = GetSampleCount(cycles);
+    phase = samples * cycles_per_second - cycles * sample_rate;
+    return samples;
+}
+
+/// @brief  Write pulses with the same length into the sample buffer
+/// @param pulse_length  Length of the pulses in cycles
+/// @param count  Number of pulses
+/// @param wav_data  Sample buffer, the samples are written from the start
+/// @return  Number of written samples
+uint32_t WAVWaveTableClass::WritePulses(uint32_t pulse_length, uint32_t count, uint8_t *wav_data)
+{
+    WAV_PULSE_WAVES &pulse_waves = GetPulseWaves(pulse_length);
+    uint32_t num_samples = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+        num_samples += WritePulse(pulse_waves, wav_data + num_samples * sample_size);
+
+    return num_samples;
+}
+
+/// @brief  Write kernal bytes into the sample buffer
+/// @param bytes  Bytes
+/// @param count  Number of bytes
+/// @param wav_data  Sample buffer, the samples are written from the start
+/// @return  Number of written samples
+uint32_t WAVWaveTableClass::WriteKernalBytes(const uint8_t *bytes, uint32_t count, uint8_t *wav_data)
+{
+    uint32_t num_samples = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t *pulses = kernal_byte_pulses[bytes[i]];
+        for(int j = 0; j < TAP_PULSES_PER_BYTE; j++)
+            num_samples += WritePulse(*kernal_pulses[pulses[j]], wav_data + num_samples * sample_size);
+    }
+
+    return num_samples;
+}
+
+/// @brief  Maximum number of samples of a pulse (longer variant)
+/// @param pulse_length  Length of the pulse in cycles
+uint32_t WAVWaveTableClass::GetMaxPulseSamples(uint32_t pulse_length) const
+{
+    return static_cast<uint32_t>(static_cast<uint64_t>(pulse_length) * sample_rate / cycles_per_second) + 1;
+}
+
+/// @brief  Skip cycles without a waveform (pause) and advance the phase accumulator
+/// @param cycles  Length of the pause in cycles
+/// @return  Number of samples of the pause, they are written with WriteSilence
+uint64_t WAVWaveTableClass::SkipCycles(uint64_t cycles)
+{
+    uint64_t length = cycles * sample_rate;
+    if(length <= phase)
+    {
+        phase -= length;
+        return 0;
+    }
+
+    uint64_t samples = (length - phase + cycles_per_second - 1) / cycles_per_second;
+    phase = phase + samples * cycles_per_second - length;
+    return samples;
+}
+
+/// @brief  Fill the sample buffer with silence (0.0 in the sample format)
+/// @param wav_data  Sample buffer
+/// @param samples  Number of samples
+void WAVWaveTableClass::WriteSilence(uint8_t *wav_data, uint32_t samples)
+{
+    FillSamples(wav_data, samples, silence);
+}
+
+/// @brief  Get the waveforms of a pulse length
+WAV_PULSE_WAVES &WAVWaveTableClass::GetPulseWaves(uint32_t pulse_length)
+{
+    // Pulses of the TAP data bytes are found without search
+    uint32_t tap_byte = pulse_length >> 3;
+    bool is_tap_byte = (pulse_length & 7) == 0 && tap_byte < 256;
+    if(is_tap_byte && tap_byte_pulses[tap_byte] != nullptr)
+        return *tap_byte_pulses[tap_byte];
+
+    std::map<uint32_t, WAV_PULSE_WAVES>::iterator it = pulse_list.find(pulse_length);
+    if(it != pulse_list.end())
+        return it->second;
+
+    WAV_PULSE_WAVES &pulse_waves = pulse_list[pulse_length];
+    pulse_waves.length = static_cast<uint64_t>(pulse_length) * sample_rate;
+    pulse_waves.min_samples = static_cast<uint32_t>(pulse_waves.length / cycles_per_second);
+
+    if(is_tap_byte)
+        tap_byte_pulses[tap_byte] = &pulse_waves;
+
+    return pulse_waves;
+}
+
+/// @brief  Write one pulse into the sample buffer and advance the phase accumulator
+/// @return  Number of written samples
+uint32_t WAVWaveTableClass::WritePulse(WAV_PULSE_WAVES &pulse_waves, uint8_t *wav_data)
+{
+    // All samples from phase up to the end of the pulse
+    if(pulse_waves.length <= phase)
+    {
+        phase -= pulse_waves.length;
+        return 0;
+    }
+
+    uint32_t samples = static_cast<uint32_t>((pulse_waves.length - phase + cycles_per_second - 1) / cycles_per_second);
+
+    if(waveform == WAV_WAVE_SQUARE)
+    {
+        // Low up to the middle of the pulse, then high
+        uint64_t half_length = pulse_waves.length / 2;
+        uint32_t low_samples = half_length > phase ? static_cast<uint32_t>((half_length - phase + cycles_per_second - 1) / cycles_per_second) : 0;
+        low_samples = std::min(low_samples, samples);
+
+        FillSamples(wav_data, low_samples, square_low);
+        FillSamples(wav_data + low_samples * sample_size, samples - low_samples, square_high);
+    }
+    else
+    {
+        uint32_t phase_step = static_cast<uint32_t>(phase * WAV_PHASE_STEPS / cycles_per_second);
+        std::vector<uint8_t> &wave = pulse_waves.waves[phase_step][samples - pulse_waves.min_samples];
+
+        if(wave.empty())
+        {
+            // One sine period, inverted, sampled from the middle of the phase step
+            const double start = (phase_step + 0.5) / WAV_PHASE_STEPS;
+            const double period = static_cast<double>(pulse_waves.length) / cycles_per_second;
+            wave.resize(static_cast<size_t>(samples) * sample_size);
+            for(uint32_t sample = 0; sample < samples; sample++)
+                ConvertSample(amplitude * static_cast<float>(sin(2.0 * M_PI * (sample + start) / period)) * -1.0f, wave.data() + sample * sample_size);
+        }
+
+        memcpy(wav_data, wave.data(), wave.size());
+    }
+
+    phase = phase + static_cast<uint64_t>(samples) * cycles_per_second - pulse_waves.length;
+
+    return samples;
+}
+
+/// @brief  Fill the sample buffer with one sample value
+void WAVWaveTableClass::FillSamples(uint8_t *wav_data, uint32_t samples, const uint8_t *sample_value)
+{
+    switch(sample_size)
+    {
+    case 1:
+        memset(wav_data, sample_value[0], samples);
+        break;
+    case 2:
+        {
+            int16_t value;
+            memcpy(&value, sample_value, sizeof(value));
+            std::fill_n(reinterpret_cast<int16_t*>(wav_data), samples, value);
+        }
+        break;
+    default:
+        {
+            float value;
+            memcpy(&value, sample_value, sizeof(value));
+            std::fill_n(reinterpret_cast<float*>(wav_data), samples, value);
+        }
+        break;
+    }
+}
+
+/// @brief  Convert a sample (-1.0 - 1.0) into the sample format
+/// @param value  Sample value
+/// @param sample  Sample in the sample format (little endian like the host)
+void WAVWaveTableClass::ConvertSample(float value, uint8_t *sample)
+{
+    switch(sample_format)
+    {
+    case WAV_FORMAT_PCM16:
+        {
+            // 16 bit signed
+            int16_t pcm_value = static_cast<int16_t>(lrintf(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f));
+            memcpy(sample, &pcm_value, sizeof(pcm_value));
+        }
+        break;
+    case WAV_FORMAT_PCM8:
+        // 8 bit unsigned, 128 = 0
+        sample[0] = static_cast<uint8_t>(128 + lrintf(std::max(-1.0f, std::min(1.0f, value)) * 127.0f));
+        break;
+    default:
+        memcpy(sample, &value, sizeof(value));
+        break;
+    }
+}
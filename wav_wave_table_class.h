@@ -0,0 +1,89 @@
+#ifndef WAV_WAVE_TABLE_CLASS_H
+#define WAV_WAVE_TABLE_CLASS_H
+
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+#include "tap_pulse.h"
+
+// Default sample rate of the WAV files
+#define WAV_DEFAULT_SAMPLE_RATE 44100
+#define WAV_MIN_SAMPLE_RATE 8000
+#define WAV_MAX_SAMPLE_RATE 192000
+
+// Min. sample rate of square waves, below a pulse can be one sample (up to ~90 cycles) too long
+// and leaves its decoder window (e.g. a short pulse of 4.03 samples at 11025 Hz written with 5 samples)
+#define WAV_SQUARE_MIN_SAMPLE_RATE 22050
+
+// Size of the sample buffer for streamed conversions
+#define WAV_STREAM_BUFFER_SAMPLES (256 * 1024)
+
+// Number of precalculated phases of a pulse waveform (fraction of a sample at the pulse start)
+#define WAV_PHASE_STEPS 16
+
+// Sample format of the WAV file (mono)
+enum WAV_SAMPLE_FORMAT {WAV_FORMAT_FLOAT, WAV_FORMAT_PCM16, WAV_FORMAT_PCM8};
+
+// Waveform of a pulse
+enum WAV_WAVEFORM {WAV_WAVE_SINE, WAV_WAVE_SQUARE};
+
+struct WAV_PULSE_WAVES
+{
+    uint64_t length;                                    // Length of the pulse in 1/cycles_per_second samples
+    uint32_t min_samples;                               // Samples of the shorter variant, the longer variant has one sample more
+    std::vector<uint8_t> waves[WAV_PHASE_STEPS][2];     // Waveforms [phase][shorter, longer variant] in the sample format, calculated at the first use
+};
+
+/// @brief  Precalculated waveforms of the WAV synthesizer
+/// @note   Every pulse is one inverted sine period or square wave (low half,
+///         high half). A pulse is rarely a whole number of samples long, the
+///         phase accumulator carries the fraction of a sample (in
+///         1/cycles_per_second samples) from pulse to pulse. A pulse is written
+///         with the shorter or the longer sample count, so the zero crossings
+///         and the length of the whole tape are exact also at low sample rates.
+///         The sine waveforms are calculated once per pulse length, phase and
+///         variant in the sample format of the WAV file, the synthesis is a
+///         block copy into the sample buffer per pulse. A square wave is filled
+///         with the low and high sample value without a table.
+class WAVWaveTableClass
+{
+public:
+    WAVWaveTableClass();
+    void Create(uint32_t new_sample_rate, uint32_t new_cycles_per_second, uint32_t short_length, uint32_t medium_length, uint32_t long_length, int new_sample_format = WAV_FORMAT_FLOAT, int new_waveform = WAV_WAVE_SINE, float new_amplitude = 1.0f);
+    uint32_t GetSampleRate() const;
+    int GetSampleFormat() const;
+    uint32_t GetSampleSize() const;
+    void ResetPhase();
+    uint64_t GetSampleCount(uint64_t cycles) const;
+    uint64_t SetTapePosition(uint64_t cycles);
+    uint32_t WritePulses(uint32_t pulse_length, uint32_t count, uint8_t *wav_data);
+    uint32_t WriteKernalBytes(const uint8_t *bytes, uint32_t count, uint8_t *wav_data);
+    uint32_t GetMaxPulseSamples(uint32_t pulse_length) const;
+    uint64_t SkipCycles(uint64_t cycles);
+    void WriteSilence(uint8_t *wav_data, uint32_t samples);
+
+private:
+    WAV_PULSE_WAVES &GetPulseWaves(uint32_t pulse_length);
+    uint32_t WritePulse(WAV_PULSE_WAVES &pulse_waves, uint8_t *wav_data);
+    void FillSamples(uint8_t *wav_data, uint32_t samples, const uint8_t *sample_value);
+    void ConvertSample(float value, uint8_t *sample);
+
+    uint32_t sample_rate;
+    uint32_t cycles_per_second;
+    int sample_format;                                  // WAV_SAMPLE_FORMAT
+    uint32_t sample_size;                               // Bytes per sample
+    int waveform;                                       // WAV_WAVEFORM
+    float amplitude;
+    uint64_t phase;                                     // Distance from the pulse start to the next sample (0 - cycles_per_second-1)
+
+    std::map<uint32_t, WAV_PULSE_WAVES> pulse_list;     // Waveforms of all used pulse lengths, key is the length in cycles
+    WAV_PULSE_WAVES *kernal_pulses[3];                  // Short, medium and long pulse
+    WAV_PULSE_WAVES *tap_byte_pulses[256];              // Pulses of the TAP data bytes (length = byte * 8), without search in pulse_list
+    uint8_t kernal_byte_pulses[256][TAP_PULSES_PER_BYTE];   // Pulses of all kernal bytes (index in kernal_pulses)
+    uint8_t square_low[4];                              // Samples of the square wave in the sample format
+    uint8_t square_high[4];
+    uint8_t silence[4];                                 // Sample value 0.0 in the sample format
+};
+
+#endif // WAV_WAVE_TABLE_CLASS_H